@@ -0,0 +1,154 @@
+#include "aiplayer.h"
+#include "fleet.h"
+
+void Knowledge::clear()
+{
+    misses = hits = sunk = 0;
+    remaining[0] = 0;
+    for(int length=1; length<=4; length++)
+        remaining[length] = 5 - length; //4 однопалубных ... 1 четырехпалубный
+}
+
+void Knowledge::apply(int cell, const ShotResult& result)
+{
+    switch(result.kind)
+    {
+    case shotMiss:
+        misses |= bits::cell(cell);
+        break;
+    case shotHit:
+    {
+        Bits b = bits::cell(cell);
+        hits |= b;
+        //по диагонали от палубы кораблей нет: корабли прямые и не касаются друг друга
+        misses |= bits::east(bits::north(b)) | bits::west(bits::north(b))
+                | bits::east(bits::south(b)) | bits::west(bits::south(b));
+    }
+        break;
+    case shotKill:
+    {
+        Bits ship = 0;
+        for(int i=0; i<result.killedCount; i++)
+            ship |= bits::cell(result.killed[i]);
+        hits &= ~ship;
+        sunk |= ship;
+        //вокруг потопленного корабля других кораблей быть не может
+        misses |= bits::around(ship) & ~ship & ~sunk;
+        if(result.killedCount <= 4 && remaining[result.killedCount] > 0)
+            remaining[result.killedCount]--;
+    }
+        break;
+    case shotRepeat:
+        break;
+    }
+}
+
+void Density::clear()
+{
+    for(int i=0; i<planes; i++)
+        plane[i] = 0;
+}
+
+void Density::add(Bits mask)
+{
+    Bits carry = mask;
+    for(int i=0; i<planes && carry; i++)
+    {
+        Bits t = plane[i] & carry;
+        plane[i] ^= carry;
+        carry = t;
+    }
+}
+
+Bits Density::maxCells(Bits candidates) const
+{
+    //от старшего бита к младшему оставляем клетки, у которых этот бит есть (если такие найдутся)
+    for(int i=planes-1; i>=0; i--)
+    {
+        Bits t = candidates & plane[i];
+        if(t)
+            candidates = t;
+    }
+    return candidates;
+}
+
+int Density::at(int cell) const
+{
+    int value = 0;
+    for(int i=0; i<planes; i++)
+        value |= bits::test(plane[i], cell) << i;
+    return value;
+}
+
+AiPlayer::AiPlayer(uint64_t seed): _rng(seed)
+{
+}
+
+void AiPlayer::density(const Knowledge& k, Density& d)
+{
+    using namespace bits;
+    d.clear();
+    Bits free = all & ~k.misses & ~k.sunk; //сюда корабль встать может
+    bool target = k.hits != 0; //есть раненый корабль - добиваем
+    for(int length=1; length<=4; length++)
+    {
+        if(k.remaining[length] == 0)
+            continue;
+        //носы допустимых размещений: length свободных клеток подряд вправо / вниз
+        Bits right = free, down = free;
+        Bits h = free, v = free;
+        //носы размещений, накрывающих хотя бы одно попадание
+        Bits hHit = k.hits, vHit = k.hits;
+        Bits rHits = k.hits, dHits = k.hits;
+        for(int i=1; i<length; i++)
+        {
+            right = west(right);
+            down = north(down);
+            h &= right;
+            v &= down;
+            rHits = west(rHits); //попадание на i клеток правее носа
+            dHits = north(dHits); //попадание на i клеток ниже носа
+            hHit |= rHits;
+            vHit |= dHits;
+        }
+        if(target)
+        {
+            h &= hHit;
+            v &= vHit;
+        }
+        if(length == 1)
+            v = 0; //однопалубный стоит одинаково в обе стороны
+        //каждое размещение добавляет по единице всем своим клеткам, с весом числа таких кораблей
+        for(int n=0; n<k.remaining[length]; n++)
+        {
+            Bits hs = h, vs = v;
+            for(int i=0; i<length; i++)
+            {
+                d.add(hs);
+                d.add(vs);
+                hs = east(hs);
+                vs = south(vs);
+            }
+        }
+    }
+}
+
+Bits AiPlayer::arrange()
+{
+    return randomFleet(_rng);
+}
+
+int AiPlayer::chooseShot(const Knowledge& k)
+{
+    Density d;
+    density(k, d);
+    Bits candidates = bits::all & ~k.shot();
+    if(!candidates)
+        return -1;
+    Bits best = d.maxCells(candidates);
+    //среди равных выбираем случайную клетку
+    int n = _rng.below(bits::count(best));
+    for(int i=0; i<n; i++)
+        best &= best - 1;
+    return bits::lowest(best);
+}
@@ -0,0 +1,44 @@
+#ifndef AIPLAYER_H
+#define AIPLAYER_H
+#include <stdint.h>
+#include "rng.h"
+#include "bitboard.h"
+
+//то, что стрелок знает о поле соперника
+struct Knowledge
+{
+    Bits misses; //промахи
+    Bits hits; //попадания в еще не потопленные корабли
+    Bits sunk; //палубы потопленных кораблей
+    int remaining[5]; //сколько кораблей каждой длины на плаву
+    void clear();
+    Bits shot() const { return misses | hits | sunk; }
+    void apply(int cell, const ShotResult& result); //учесть результат своего выстрела
+};
+
+//счетчик на каждую клетку в битовых плоскостях: plane[i] - i-й бит счетчика всех 100 клеток
+struct Density
+{
+    static const int planes = 7; //до 127 размещений на клетку
+    Bits plane[planes];
+    void clear();
+    void add(Bits mask); //+1 всем клеткам маски, перенос сразу по всем клеткам
+    Bits maxCells(Bits candidates) const; //клетки с наибольшим счетчиком среди candidates
+    int at(int cell) const;
+};
+
+//компьютерный соперник: охота/добивание по карте плотности размещений
+class AiPlayer
+{
+public:
+    explicit AiPlayer(uint64_t seed = 1);
+    Bits arrange(); //случайная расстановка своего флота
+    int chooseShot(const Knowledge& k); //клетка для следующего выстрела
+    static void density(const Knowledge& k, Density& d); //сколько допустимых размещений кораблей накрывает клетку
+    Rng& rng() { return _rng; } //состояние компьютера - только его генератор
+
+private:
+    Rng _rng;
+};
+
+#endif // AIPLAYER_H
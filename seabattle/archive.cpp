@@ -0,0 +1,385 @@
+#include "archive.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+namespace {
+
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t matches;
+    uint64_t indexOffset; //индекс блоков в конце файла
+    uint32_t blocks;
+    uint32_t pad;
+};
+
+enum Column { colId, colTime, colSeed, colWinner, colAi, colFirst, colCount0, colCount1,
+              colShipsLow0, colShipsHigh0, colShipsLow1, colShipsHigh1, colShots0, colShots1, columnCount };
+
+struct BlockHeader
+{
+    uint32_t count;
+    uint32_t shotWords[2];
+    uint32_t pad;
+    uint64_t column[columnCount]; //смещения столбцов от начала блока
+};
+
+const int alignment = 64;
+
+}
+
+void positionalPopcount(const uint64_t* words, size_t n, uint64_t counts[64])
+{
+    //4 независимые полосы без ветвлений - компилятор раскладывает их по векторным регистрам
+    const int lanes = 4, planes = 8;
+    size_t i = 0;
+    while(n - i >= lanes)
+    {
+        uint64_t plane[planes][lanes];
+        memset(plane, 0, sizeof(plane));
+        size_t stop = i + 255 * lanes; //8 плоскостей вмещают до 255
+        if(stop > n)
+            stop = n - (n - i) % lanes;
+        for(; i < stop; i += lanes)
+        {
+            uint64_t carry[lanes];
+            for(int l=0; l<lanes; l++)
+                carry[l] = words[i + l];
+            for(int k=0; k<planes; k++)
+            {
+                for(int l=0; l<lanes; l++)
+                {
+                    uint64_t t = plane[k][l] & carry[l];
+                    plane[k][l] ^= carry[l];
+                    carry[l] = t;
+                }
+            }
+        }
+        for(int k=0; k<planes; k++)
+            for(int l=0; l<lanes; l++)
+                for(int b=0; b<64; b++)
+                    counts[b] += ((plane[k][l] >> b) & 1) << k;
+    }
+    for(; i<n; i++)
+        for(int b=0; b<64; b++)
+            counts[b] += (words[i] >> b) & 1;
+}
+
+//слова масок каждой клетки: таблица вместо сдвига и выбора слова по номеру клетки
+struct CellWords
+{
+    uint64_t low[100], high[100];
+    CellWords()
+    {
+        for(int c=0; c<100; c++)
+        {
+            low[c] = c < 64 ? (uint64_t)1 << c : 0;
+            high[c] = c < 64 ? 0 : (uint64_t)1 << (c - 64);
+        }
+    }
+};
+static const CellWords cellWords;
+
+void countShots(const BlockView& v, int side, const uint8_t* take, ShotCounts& counts, ShotScratch& scratch)
+{
+    int n = v.count;
+    //весь столбец разностей - сразу в байты: у каждого из 9 значений слова свой постоянный сдвиг, цикл векторизуется
+    uint32_t words = v.shotWords[side];
+    const uint64_t* packed = v.shots[side];
+    scratch.deltas.resize(9 * (size_t)words);
+    uint8_t* deltas = scratch.deltas.data();
+    for(uint32_t w=0; w<words; w++)
+    {
+        uint64_t word = packed[w];
+        for(int k=0; k<9; k++)
+            deltas[9*w + k] = (word >> (7*k)) & 0x7f;
+    }
+    scratch.masks.resize(4 * (size_t)n);
+    uint64_t* shotLow = scratch.masks.data();
+    uint64_t* shotHigh = shotLow + n;
+    uint64_t* hitLow = shotHigh + n;
+    uint64_t* hitHigh = hitLow + n;
+    const uint64_t* enemyLow = v.shipsLow[1-side]; //стреляем по полю соперника
+    const uint64_t* enemyHigh = v.shipsHigh[1-side];
+    const uint8_t* shotCount = v.shotCount[side];
+    const uint8_t* d = deltas;
+    int m = 0;
+    for(int i=0; i<n; i++)
+    {
+        int count = shotCount[i];
+        if(!take[i] || !count)
+        {
+            d += count;
+            continue;
+        }
+        uint64_t low = 0, high = 0;
+        unsigned sum = 0;
+        for(int j=0; j<count; j++)
+        {
+            sum += d[j]; //между выстрелами - одно сложение, остаток от деления в цепочку не входит
+            unsigned cell = sum % 100;
+            low |= cellWords.low[cell];
+            high |= cellWords.high[cell];
+        }
+        if(__builtin_popcountll(low) + __builtin_popcountll(high) == count)
+        {
+            shotLow[m] = low;
+            shotHigh[m] = high;
+            hitLow[m] = low & enemyLow[i];
+            hitHigh[m] = high & enemyHigh[i];
+            m++;
+        } else {
+            //в партии есть повтор, а маска его теряет: эту партию считаем по одному выстрелу
+            uint64_t enemy[2] = { enemyLow[i], enemyHigh[i] };
+            sum = 0;
+            for(int j=0; j<count; j++)
+            {
+                sum += d[j];
+                unsigned cell = sum % 100;
+                counts.shots[cell >> 6][cell & 63]++;
+                counts.hits[cell >> 6][cell & 63] += (enemy[cell >> 6] >> (cell & 63)) & 1;
+            }
+        }
+        d += count;
+    }
+    positionalPopcount(shotLow, m, counts.shots[0]);
+    positionalPopcount(shotHigh, m, counts.shots[1]);
+    positionalPopcount(hitLow, m, counts.hits[0]);
+    positionalPopcount(hitHigh, m, counts.hits[1]);
+}
+
+ArchiveWriter::ArchiveWriter()
+{
+    _file = 0;
+    _offset = 0;
+    _matches = 0;
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    close();
+}
+
+bool ArchiveWriter::open(const std::string& path)
+{
+    close();
+    _file = fopen(path.c_str(), "wb");
+    if(!_file)
+    {
+        perror("archive: open");
+        return false;
+    }
+    _offset = 0;
+    _matches = 0;
+    _index.clear();
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    write(&header, sizeof(header)); //настоящий заголовок - при закрытии
+    align();
+    return true;
+}
+
+void ArchiveWriter::write(const void* data, size_t size)
+{
+    fwrite(data, 1, size, _file);
+    _offset += size;
+}
+
+void ArchiveWriter::align()
+{
+    static const char zero[alignment] = { 0 };
+    if(_offset % alignment)
+        write(zero, alignment - _offset % alignment);
+}
+
+void ArchiveWriter::add(const ArchivedMatch& match)
+{
+    _block.push_back(match);
+    _matches++;
+    if((int)_block.size() == blockMatches)
+        flushBlock();
+}
+
+void ArchiveWriter::flushBlock()
+{
+    if(_block.empty())
+        return;
+    int n = _block.size();
+    BlockIndex index;
+    memset(&index, 0, sizeof(index));
+    index.offset = _offset;
+    index.count = n;
+    index.minTime = ~(uint64_t)0;
+    index.minId = ~0u;
+    index.minMoves = 0xffff;
+
+    //столбцы собираем целиком в памяти, затем пишем подряд
+    std::vector<uint32_t> id(n);
+    std::vector<uint64_t> time(n), seed(n), shipsLow[2], shipsHigh[2], shots[2];
+    std::vector<int8_t> winner(n), ai(n);
+    std::vector<uint8_t> first(n), count[2];
+    for(int s=0; s<2; s++)
+    {
+        shipsLow[s].resize(n);
+        shipsHigh[s].resize(n);
+        count[s].resize(n);
+    }
+    int packed[2] = { 0, 0 }; //значений в последнем слове
+    for(int i=0; i<n; i++)
+    {
+        const ArchivedMatch& m = _block[i];
+        id[i] = m.id;
+        time[i] = m.time;
+        seed[i] = m.seed;
+        winner[i] = m.winner;
+        ai[i] = m.aiSide;
+        first[i] = m.first;
+        int moves = 0;
+        for(int s=0; s<2; s++)
+        {
+            shipsLow[s][i] = bits::low(m.ships[s]);
+            shipsHigh[s][i] = bits::high(m.ships[s]);
+            count[s][i] = m.shots[s].size();
+            moves += m.shots[s].size();
+            int prev = 0;
+            for(size_t j=0; j<m.shots[s].size(); j++)
+            {
+                int cell = m.shots[s][j];
+                int delta = (cell - prev + 100) % 100; //разность с прошлым выстрелом той же стороны
+                prev = cell;
+                if(packed[s] == 0)
+                    shots[s].push_back(0);
+                shots[s].back() |= (uint64_t)delta << (7 * packed[s]);
+                packed[s] = (packed[s] + 1) % 9;
+            }
+        }
+        if(m.aiSide >= 0)
+            index.aiMatches++;
+        if(m.time < index.minTime) index.minTime = m.time;
+        if(m.time > index.maxTime) index.maxTime = m.time;
+        if(m.id < index.minId) index.minId = m.id;
+        if(m.id > index.maxId) index.maxId = m.id;
+        if(moves < index.minMoves) index.minMoves = moves;
+        if(moves > index.maxMoves) index.maxMoves = moves;
+    }
+
+    BlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.count = n;
+    header.shotWords[0] = shots[0].size();
+    header.shotWords[1] = shots[1].size();
+    const void* data[columnCount] = { id.data(), time.data(), seed.data(), winner.data(), ai.data(), first.data(),
+                                      count[0].data(), count[1].data(), shipsLow[0].data(), shipsHigh[0].data(),
+                                      shipsLow[1].data(), shipsHigh[1].data(), shots[0].data(), shots[1].data() };
+    size_t size[columnCount] = { n*sizeof(uint32_t), n*sizeof(uint64_t), n*sizeof(uint64_t), (size_t)n, (size_t)n,
+                                 (size_t)n, (size_t)n, (size_t)n, n*sizeof(uint64_t), n*sizeof(uint64_t),
+                                 n*sizeof(uint64_t), n*sizeof(uint64_t), shots[0].size()*sizeof(uint64_t),
+                                 shots[1].size()*sizeof(uint64_t) };
+    uint64_t at = (sizeof(header) + alignment - 1) / alignment * alignment;
+    for(int c=0; c<columnCount; c++)
+    {
+        header.column[c] = at;
+        at += (size[c] + alignment - 1) / alignment * alignment;
+    }
+    write(&header, sizeof(header));
+    align();
+    for(int c=0; c<columnCount; c++)
+    {
+        write(data[c], size[c]);
+        align();
+    }
+    _index.push_back(index);
+    _block.clear();
+}
+
+bool ArchiveWriter::close()
+{
+    if(!_file)
+        return false;
+    flushBlock();
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = Archive::magic;
+    header.version = 1;
+    header.matches = _matches;
+    header.indexOffset = _offset;
+    header.blocks = _index.size();
+    if(!_index.empty())
+        write(&_index[0], _index.size() * sizeof(BlockIndex));
+    fseek(_file, 0, SEEK_SET);
+    fwrite(&header, 1, sizeof(header), _file);
+    bool ok = !ferror(_file);
+    fclose(_file);
+    _file = 0;
+    return ok;
+}
+
+Archive::Archive()
+{
+    _base = 0;
+    _size = 0;
+    _blocks = 0;
+    _matches = 0;
+    _index = 0;
+}
+
+Archive::~Archive()
+{
+    if(_base)
+        munmap((void*)_base, _size);
+}
+
+bool Archive::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(FileHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void* base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(base == MAP_FAILED)
+        return false;
+    _base = (const uint8_t*)base;
+    _size = st.st_size;
+    madvise(base, _size, MADV_SEQUENTIAL); //столбцы читаются подряд, пусть ядро читает вперед
+    const FileHeader* header = (const FileHeader*)_base;
+    if(header->magic != magic || header->version != 1 ||
+       header->indexOffset + header->blocks * sizeof(BlockIndex) > _size)
+        return false;
+    _blocks = header->blocks;
+    _matches = header->matches;
+    _index = (const BlockIndex*)(_base + header->indexOffset);
+    return true;
+}
+
+BlockView Archive::block(int block) const
+{
+    const uint8_t* p = _base + _index[block].offset;
+    const BlockHeader* header = (const BlockHeader*)p;
+    BlockView v;
+    v.count = header->count;
+    v.id = (const uint32_t*)(p + header->column[colId]);
+    v.time = (const uint64_t*)(p + header->column[colTime]);
+    v.seed = (const uint64_t*)(p + header->column[colSeed]);
+    v.winner = (const int8_t*)(p + header->column[colWinner]);
+    v.aiSide = (const int8_t*)(p + header->column[colAi]);
+    v.first = p + header->column[colFirst];
+    for(int s=0; s<2; s++)
+    {
+        v.shotCount[s] = p + header->column[colCount0 + s];
+        v.shipsLow[s] = (const uint64_t*)(p + header->column[colShipsLow0 + 2*s]);
+        v.shipsHigh[s] = (const uint64_t*)(p + header->column[colShipsHigh0 + 2*s]);
+        v.shots[s] = (const uint64_t*)(p + header->column[colShots0 + s]);
+        v.shotWords[s] = header->shotWords[s];
+    }
+    return v;
+}
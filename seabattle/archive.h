@@ -0,0 +1,156 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include "bitboard.h"
+
+//архив партий по столбцам для аналитики.
+//Файл: заголовок, блоки по blockMatches партий, в конце - индекс блоков с min/max для отсева.
+//В блоке каждый столбец лежит отдельно и выровнен на 64 байта: расстановки - по 64-битным словам,
+//выстрелы каждой стороны - разности с предыдущим выстрелом той же стороны (по модулю 100),
+//упакованные по 7 бит, 9 значений в слове
+struct ArchivedMatch
+{
+    uint32_t id;
+    uint64_t seed;
+    uint64_t time; //создание партии, мс
+    int winner; //-1 - прервана
+    int aiSide; //-1 - без компьютера
+    int first; //кто ходил первым
+    Bits ships[2];
+    std::vector<uint8_t> shots[2]; //клетки выстрелов каждой стороны по порядку
+};
+
+//строка индекса: где лежит блок и диапазоны значений в нем
+struct BlockIndex
+{
+    uint64_t offset;
+    uint32_t count;
+    uint32_t aiMatches;
+    uint64_t minTime, maxTime;
+    uint32_t minId, maxId;
+    uint16_t minMoves, maxMoves;
+    uint32_t pad;
+};
+
+//столбцы одного блока прямо в отображенном файле
+struct BlockView
+{
+    uint32_t count;
+    const uint32_t* id;
+    const uint64_t* time;
+    const uint64_t* seed;
+    const int8_t* winner;
+    const int8_t* aiSide;
+    const uint8_t* first;
+    const uint8_t* shotCount[2]; //выстрелов у стороны в каждой партии
+    const uint64_t* shipsLow[2]; //клетки 0..63
+    const uint64_t* shipsHigh[2]; //клетки 64..99
+    const uint64_t* shots[2]; //упакованные разности
+    uint32_t shotWords[2];
+};
+
+class ArchiveWriter
+{
+public:
+    ArchiveWriter();
+    ~ArchiveWriter();
+    bool open(const std::string& path);
+    void add(const ArchivedMatch& match);
+    bool close();
+    uint64_t matches() const { return _matches; }
+
+    static const int blockMatches = 4096;
+
+private:
+    FILE* _file;
+    uint64_t _offset;
+    uint64_t _matches;
+    std::vector<ArchivedMatch> _block;
+    std::vector<BlockIndex> _index;
+    void flushBlock();
+    void write(const void* data, size_t size);
+    void align();
+};
+
+class Archive
+{
+public:
+    Archive();
+    ~Archive();
+    bool open(const std::string& path);
+    int blockCount() const { return _blocks; }
+    uint64_t matchCount() const { return _matches; }
+    uint64_t size() const { return _size; }
+    const BlockIndex& index(int block) const { return _index[block]; }
+    BlockView block(int block) const;
+
+    static const uint32_t magic = 0x31414253; //"SBA1"
+
+private:
+    const uint8_t* _base;
+    uint64_t _size;
+    int _blocks;
+    uint64_t _matches;
+    const BlockIndex* _index;
+};
+
+//упаковка разностей выстрелов: 7 бит на значение, 9 значений в 64-битном слове
+class ShotUnpacker
+{
+public:
+    ShotUnpacker(const uint64_t* words, uint64_t position) //с position-го значения потока
+        : _words(words + position / 9), _word(0), _left(0)
+    {
+        int skip = position % 9;
+        if(skip)
+        {
+            _word = *_words++ >> (7 * skip);
+            _left = 9 - skip;
+        }
+    }
+    int next()
+    {
+        if(!_left)
+        {
+            _word = *_words++;
+            _left = 9;
+        }
+        int v = _word & 0x7f;
+        _word >>= 7;
+        _left--;
+        return v;
+    }
+
+private:
+    const uint64_t* _words;
+    uint64_t _word;
+    int _left;
+};
+
+//поразрядный подсчет: сколько слов имеют единицу в каждом из 64 битов.
+//Слова складываются в битовых плоскостях (как Density), в обычные счетчики сбрасываются раз в 255 слов
+void positionalPopcount(const uint64_t* words, size_t n, uint64_t counts[64]);
+
+//счетчики запроса hits: выстрелы и попадания по клеткам, клетка c - бит c%64 слова c/64
+struct ShotCounts
+{
+    uint64_t shots[2][64];
+    uint64_t hits[2][64];
+};
+
+//память countShots, переиспользуется от блока к блоку
+struct ShotScratch
+{
+    std::vector<uint8_t> deltas; //разности выстрелов блока, распакованные по байту
+    std::vector<uint64_t> masks; //маски выстрелов и попаданий отобранных партий
+};
+
+//выстрелы стороны side по полю соперника в отобранных партиях блока (take[i] != 0).
+//Партия сворачивается в маски выстрелов и попаданий, маски считает positionalPopcount.
+//Партии с повторным выстрелом в ту же клетку считаются по одному выстрелу
+void countShots(const BlockView& v, int side, const uint8_t* take, ShotCounts& counts, ShotScratch& scratch);
+
+#endif // ARCHIVE_H
@@ -0,0 +1,544 @@
+//микробенчмарки горячих путей: разбор выстрела на сервере и проверка расстановки
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <chrono>
+#include <new>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "bitboard.h"
+#include "fleet.h"
+#include "aiplayer.h"
+#include "solver.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "timerwheel.h"
+#include "matchmaker.h"
+#include "pool.h"
+#include "ringbuffer.h"
+#include "outqueue.h"
+#include "match.h"
+#include "snapshot.h"
+
+//счетчик выделений памяти: считаем все вызовы operator new в процессе
+static unsigned long long allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+//промахи кэша через perf_event_open, если ядро и права позволяют
+class CacheMisses
+{
+public:
+    CacheMisses()
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        _fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~CacheMisses()
+    {
+        if(_fd != -1)
+            close(_fd);
+    }
+    bool available() const { return _fd != -1; }
+    void start()
+    {
+        if(_fd == -1)
+            return;
+        ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    long long stop()
+    {
+        if(_fd == -1)
+            return -1;
+        ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long value = 0;
+        if(read(_fd, &value, sizeof(value)) != sizeof(value))
+            return -1;
+        return value;
+    }
+
+private:
+    int _fd;
+};
+
+static CacheMisses* misses;
+static volatile long long sink; //чтобы компилятор не выбросил результат
+
+//прогоняем body, пока не наберется minTime; body возвращает число выполненных операций
+template<class F> static void run(const char* name, F body)
+{
+    typedef std::chrono::steady_clock Clock;
+    body(); //прогрев
+    long long ops = 0;
+    unsigned long long allocs = allocations;
+    misses->start();
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    while(elapsed < 0.3)
+    {
+        ops += body();
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    long long cache = misses->stop();
+    allocs = allocations - allocs;
+    printf("%-24s %12.2f %12.3f ", name, elapsed * 1e9 / ops, (double)allocs / ops);
+    if(cache >= 0)
+        printf("%12.4f\n", (double)cache / ops);
+    else
+        printf("%12s\n", "n/a");
+}
+
+//прежнее представление: клетка - char, потопление - обход до 3 клеток в 4 стороны
+struct CharBoard
+{
+    char field[100];
+    char nowDamage[100];
+
+    int checkDamageShips(int x, int y) const
+    {
+        if(x<=9 && x>=0 && y<=9 && y>=0 && field[x+y*10])
+            return nowDamage[x+y*10] == 1 ? 2 : 1;
+        return 0;
+    }
+    bool checkDamageCell(int a, int b, int x, int y, int& iKill, int nowKilled[]) const
+    {
+        for(int i=1; i<=3; i++)
+        {
+            int dmg = checkDamageShips(x+i*a, y+i*b);
+            if(dmg == 2)
+            {
+                nowKilled[iKill++] = x+i*a+(y+i*b)*10;
+            } else {
+                if(dmg == 1)
+                    return false;
+                break;
+            }
+        }
+        return true;
+    }
+    int shoot(int cell, int nowKilled[4])
+    {
+        if(nowDamage[cell])
+            return shotRepeat;
+        nowDamage[cell] = 1;
+        if(!field[cell])
+            return shotMiss;
+        int x = cell%10, y = cell/10, iKill = 1;
+        nowKilled[0] = cell;
+        for(int i=1; i<4; i++)
+            nowKilled[i] = -1;
+        bool kill = checkDamageCell(1, 0, x, y, iKill, nowKilled) &&
+                    checkDamageCell(-1, 0, x, y, iKill, nowKilled) &&
+                    checkDamageCell(0, 1, x, y, iKill, nowKilled) &&
+                    checkDamageCell(0, -1, x, y, iKill, nowKilled);
+        return kill ? shotKill : shotHit;
+    }
+};
+
+//корабль расстановки в том виде, в каком его видит клиент
+struct PlacedShip
+{
+    int length, x, y;
+    bool vertical;
+};
+
+static void decompose(Bits fleet, PlacedShip out[fleetSize])
+{
+    int n = 0;
+    Bits rest = fleet;
+    while(rest)
+    {
+        int nose = bits::lowest(rest); //младший бит - верхняя левая палуба корабля
+        Bits ship = bits::shipAt(fleet, nose);
+        out[n].length = bits::count(ship);
+        out[n].x = nose % 10;
+        out[n].y = nose / 10;
+        out[n].vertical = out[n].length > 1 && bits::test(ship, nose + 10);
+        rest &= ~ship;
+        n++;
+    }
+}
+
+int main()
+{
+    const int boards = 4096; //4096 полей * 48 байт не помещаются в L1, как и много партий на сервере
+    Rng rng(20170517);
+    std::vector<Bits> fleets(boards);
+    std::vector<unsigned char> order(boards * 100);
+    std::vector<PlacedShip> placed(boards * fleetSize);
+    for(int i=0; i<boards; i++)
+    {
+        fleets[i] = randomFleet(rng);
+        unsigned char* o = &order[i*100];
+        for(int c=0; c<100; c++)
+            o[c] = c;
+        std::shuffle(o, o + 100, rng);
+        decompose(fleets[i], &placed[i*fleetSize]);
+    }
+    std::vector<Board> bitBoards(boards);
+    std::vector<CharBoard> charBoards(boards);
+    for(int i=0; i<boards; i++)
+    {
+        bitBoards[i].ships = fleets[i];
+        fleetToField(fleets[i], charBoards[i].field);
+    }
+
+    CacheMisses counter;
+    misses = &counter;
+    printf("%-24s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "misses/op");
+
+    //полная партия по каждому полю: 100 выстрелов в случайном порядке
+    run("shoot/bitboard", [&]() -> long long {
+        long long acc = 0;
+        for(int i=0; i<boards; i++)
+        {
+            Board& b = bitBoards[i];
+            b.hits = b.misses = 0;
+            const unsigned char* o = &order[i*100];
+            for(int c=0; c<100; c++)
+                acc += b.shoot(o[c]).kind;
+        }
+        sink = acc;
+        return boards * 100LL;
+    });
+    run("shoot/char-array", [&]() -> long long {
+        long long acc = 0;
+        int killed[4];
+        for(int i=0; i<boards; i++)
+        {
+            CharBoard& b = charBoards[i];
+            memset(b.nowDamage, 0, sizeof(b.nowDamage));
+            const unsigned char* o = &order[i*100];
+            for(int c=0; c<100; c++)
+                acc += b.shoot(o[c], killed);
+        }
+        sink = acc;
+        return boards * 100LL;
+    });
+    //только попадания: здесь и ищется потопленный корабль
+    run("sunk-check/bitboard", [&]() -> long long {
+        long long acc = 0, ops = 0;
+        for(int i=0; i<boards; i++)
+        {
+            Board& b = bitBoards[i];
+            b.hits = b.misses = 0;
+            Bits rest = b.ships;
+            while(rest)
+            {
+                acc += b.shoot(bits::lowest(rest)).kind;
+                rest &= rest - 1;
+                ops++;
+            }
+        }
+        sink = acc;
+        return ops;
+    });
+    run("sunk-check/char-array", [&]() -> long long {
+        long long acc = 0, ops = 0;
+        int killed[4];
+        for(int i=0; i<boards; i++)
+        {
+            CharBoard& b = charBoards[i];
+            memset(b.nowDamage, 0, sizeof(b.nowDamage));
+            for(int c=0; c<100; c++)
+            {
+                if(b.field[c])
+                {
+                    acc += b.shoot(c, killed);
+                    ops++;
+                }
+            }
+        }
+        sink = acc;
+        return ops;
+    });
+    //проверка расстановки на клиенте: 10 кораблей на поле
+    run("place-fleet/client", [&]() -> long long {
+        long long acc = 0;
+        int around[100], field[100];
+        for(int i=0; i<boards; i++)
+        {
+            memset(around, 0, sizeof(around));
+            memset(field, 0, sizeof(field));
+            const PlacedShip* p = &placed[i*fleetSize];
+            for(int s=0; s<fleetSize; s++)
+                acc += placeShip(p[s].length, p[s].vertical, p[s].x, p[s].y, around, field);
+        }
+        sink = acc;
+        return boards;
+    });
+    //проверка расстановки на сервере при получении comArrange
+    run("validate-fleet", [&]() -> long long {
+        long long acc = 0;
+        for(int i=0; i<boards; i++)
+            acc += validateFleet(fleets[i]);
+        sink = acc;
+        return boards;
+    });
+    run("random-fleet", [&]() -> long long {
+        long long acc = 0;
+        for(int i=0; i<256; i++)
+            acc += bits::low(randomFleet(rng));
+        sink = acc;
+        return 256;
+    });
+    //ход компьютера: карта плотности и выбор клетки, партии до последнего корабля
+    AiPlayer ai(7);
+    run("ai-choose-shot", [&]() -> long long {
+        long long acc = 0, ops = 0;
+        for(int i=0; i<boards; i+=16)
+        {
+            Board& b = bitBoards[i];
+            b.hits = b.misses = 0;
+            Knowledge k;
+            k.clear();
+            while(!b.allSunk())
+            {
+                int cell = ai.chooseShot(k);
+                k.apply(cell, b.shoot(cell));
+                acc += cell;
+                ops++;
+            }
+        }
+        sink = acc;
+        return ops;
+    });
+    //выборка Монте-Карло на всех ядрах: время на одну расстановку, обратное samples/s пула
+    WorkPool pool;
+    Solver solver(&pool, 7);
+    Knowledge opening;
+    opening.clear();
+    run("solver/sample", [&]() -> long long {
+        SolverResult r = solver.solve(opening, 20000);
+        sink = r.cell;
+        return r.samples;
+    });
+    //конец партии: остались однопалубные, расстановки пересчитываются точно
+    Knowledge endgame;
+    endgame.clear();
+    {
+        Board& b = bitBoards[0];
+        b.hits = b.misses = 0;
+        const unsigned char* o = &order[0];
+        for(int c=0; c<100 && (endgame.remaining[4] || endgame.remaining[3] || endgame.remaining[2]); c++)
+            endgame.apply(o[c], b.shoot(o[c]));
+    }
+    run("solver/exact", [&]() -> long long {
+        SolverResult r = solver.solve(endgame, 20000);
+        sink = r.cell;
+        return r.samples;
+    });
+    printf("solver: %d threads\n", pool.size());
+
+    //инструментирование одного хода на сервере: замер кадра, байты туда и обратно, счетчик ходов
+    run("metrics/move", [&]() -> long long {
+        uint64_t started = Metrics::ticks();
+        for(int i=0; i<1000; i++)
+        {
+            Metrics::add(ctrBytesIn, 5);
+            Metrics::add(ctrMoves);
+            Metrics::add(ctrBytesOut, 10);
+            started = Metrics::recordFrame(comDot, started);
+        }
+        return 1000;
+    });
+
+    //сроки на сервере: 200000 взведенных таймеров, перевзвод и отмена в случайном порядке
+    {
+        struct NoOp: TimerHandler { void onTimer(Timer*) {} } noop;
+        TimerWheel wheel;
+        std::vector<Timer> timers(200000);
+        for(size_t i=0; i<timers.size(); i++)
+            wheel.arm(&timers[i], &noop, rng.below(600000));
+        run("timer-wheel/rearm", [&]() -> long long {
+            for(int i=0; i<1000; i++)
+            {
+                Timer& t = timers[rng.below(timers.size())];
+                if(i & 1)
+                    t.cancel();
+                else
+                    wheel.arm(&t, &noop, 30000);
+            }
+            return 1000;
+        });
+        uint64_t now = wheel.now();
+        run("timer-wheel/advance", [&]() -> long long {
+            now += 10;
+            wheel.advance(now); //один тик при 200000 взведенных
+            return 1;
+        });
+        printf("timer wheel: %d armed\n", wheel.count());
+    }
+
+    //подбор соперников: 50000 подключенных игроков встают в очередь по четырем корзинам,
+    //каждый второй в своей корзине находит ждущего; часть уходит из очереди и оставляет устаревшие билеты
+    {
+        Matchmaker matchmaker;
+        std::vector<Waiter> waiters(50000);
+        run("matchmaker/join", [&]() -> long long {
+            for(int i=0; i<1000; i++)
+            {
+                Waiter* waiter = &waiters[rng.below(waiters.size())];
+                MatchTicket partner;
+                if(rng.below(8) == 0)
+                    matchmaker.cancel(waiter);
+                else
+                    matchmaker.join(waiter, rng.below(Matchmaker::bucketCount), partner);
+            }
+            return 1000;
+        });
+    }
+
+    //подключение и отключение: объект соединения с буферами приема и отправки,
+    //ответ в очередь отправки и закрытие - через new/delete и через пул
+    {
+        struct Session: PoolSlot
+        {
+            RingBuffer in;
+            OutQueue out;
+            char scratch[maxFramePayload];
+        };
+        char reply = 0;
+        run("session/heap", [&]() -> long long {
+            Session* session = new Session;
+            session->out.commit(encodeFrame(session->out.reserve(frameHeaderSize + 1), comStartGame, &reply, 1));
+            sink += session->out.size();
+            delete session;
+            return 1;
+        });
+        Pool<Session> pool;
+        std::vector<Session*> live;
+        for(int i=0; i<1000; i++)
+            live.push_back(pool.acquire()); //пул уже прогрет, как на сервере после первой волны подключений
+        for(size_t i=0; i<live.size(); i++)
+            pool.release(live[i]);
+        run("session/pool", [&]() -> long long {
+            Session* session = pool.acquire();
+            session->out.commit(encodeFrame(session->out.reserve(frameHeaderSize + 1), comStartGame, &reply, 1));
+            sink += session->out.size();
+            session->in.clear();
+            session->out.clear();
+            pool.release(session);
+            return 1;
+        });
+    }
+
+    //снимок партий для перезапуска после падения: запись частями по 2048 ячеек, как на сервере,
+    //и загрузка в пустой реестр. Каждая четвертая партия - с компьютером, в каждой по 40 выстрелов
+    printf("\n%-24s %12s %12s %12s %12s\n", "snapshot", "bytes", "write ms", "slice ms", "load ms");
+    for(int count=1000; count<=100000; count*=10)
+    {
+        typedef std::chrono::steady_clock Clock;
+        TimerWheel wheel;
+        MatchRegistry* registry = new MatchRegistry;
+        for(int i=0; i<count; i++)
+        {
+            PoolHandle handle = { (uint32_t)i, 1 };
+            Match* match = registry->restore(handle);
+            match->reset(i + 1, rng());
+            for(int side=0; side<2; side++)
+            {
+                match->boards[side].ships = fleets[(i * 2 + side) % boards];
+                match->ready[side] = true;
+                match->secrets[side] = rng();
+            }
+            if(i % 4 == 0)
+            {
+                match->aiSide = 1;
+                match->ai = new AiPlayer(match->rng());
+            }
+            match->started = true;
+            const unsigned char* o = &order[(i % boards) * 100];
+            for(int c=0; c<40 && !match->finished; c++)
+            {
+                int side = match->turn;
+                ShotResult shot = match->fire(o[c]);
+                if(side == match->aiSide)
+                    match->aiView.apply(o[c], shot);
+            }
+        }
+        registry->restored();
+        std::string path = "seabattle-bench.snap";
+        Clock::time_point start = Clock::now();
+        double sliceMs = 0; //самая долгая часть: столько цикл сервера не обслуживает сокеты
+        SnapshotWriter writer;
+        writer.begin(path);
+        for(uint32_t slot=0; slot<registry->slotCount(); )
+        {
+            Clock::time_point sliceStart = Clock::now();
+            StateWriter part;
+            for(uint32_t end = std::min(slot + 2048, registry->slotCount()); slot < end; slot++)
+            {
+                Match* match = registry->at(slot);
+                if(!match)
+                    continue;
+                PoolHandle handle = registry->handle(match);
+                part.put32(handle.index);
+                part.put32(handle.generation);
+                match->save(part, wheel);
+            }
+            writer.append(part);
+            sliceMs = std::max(sliceMs, std::chrono::duration<double, std::milli>(Clock::now() - sliceStart).count());
+        }
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        header.workers = 1;
+        header.matches = count;
+        bool written = writer.commit(header);
+        double writeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        delete registry;
+
+        //загрузка: файл только что записан и лежит в кэше страниц, как после падения процесса, а не машины
+        start = Clock::now();
+        SnapshotFile file;
+        MatchRegistry* restored = new MatchRegistry;
+        int loaded = 0;
+        if(written && file.open(path))
+        {
+            StateReader in = file.matches();
+            for(uint32_t i=0; i<file.header().matches; i++)
+            {
+                PoolHandle handle;
+                handle.index = in.get32();
+                handle.generation = in.get32();
+                Match* match = in.ok() ? restored->restore(handle) : 0;
+                uint32_t players[2];
+                int timers[3];
+                if(!match || !match->load(in, players, timers))
+                    break;
+                loaded++;
+            }
+            restored->restored();
+        }
+        double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        printf("%-24s %12llu %12.2f %12.2f %12.2f\n", (std::to_string(count) + " matches").c_str(),
+               (unsigned long long)file.size(), writeMs, sliceMs, loadMs);
+        if(loaded != count)
+            printf("snapshot: loaded %d of %d matches\n", loaded, count);
+        delete restored;
+        unlink(path.c_str());
+    }
+    return 0;
+}
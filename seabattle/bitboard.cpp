@@ -0,0 +1,47 @@
+#include "bitboard.h"
+
+void Board::setField(const char field[100])
+{
+    clear();
+    for(int i=0; i<100; i++)
+    {
+        if(field[i])
+            ships |= bits::cell(i);
+    }
+}
+
+ShotResult Board::hitAt(int c) const
+{
+    ShotResult result;
+    result.killedCount = 0;
+    Bits ship = bits::shipAt(ships, c);
+    if(ship & ~hits) //есть непотопленные палубы
+    {
+        result.kind = shotHit;
+        return result;
+    }
+    result.kind = shotKill;
+    result.killed[result.killedCount++] = c;
+    ship &= ~bits::cell(c);
+    while(ship && result.killedCount < 4)
+    {
+        int k = bits::lowest(ship);
+        result.killed[result.killedCount++] = k;
+        ship &= ship - 1;
+    }
+    return result;
+}
+
+Bits Board::sunk() const
+{
+    Bits result = 0;
+    Bits left = ships & hits; //подбитые палубы, по ним находим корабли
+    while(left)
+    {
+        Bits ship = bits::shipAt(ships, bits::lowest(left));
+        if(!(ship & ~hits))
+            result |= ship;
+        left &= ~ship;
+    }
+    return result;
+}
@@ -0,0 +1,127 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+#include <stdint.h>
+
+//поле 10x10 в 128-битном числе: бит номер x+y*10 соответствует клетке (x, y)
+typedef unsigned __int128 Bits;
+
+namespace bits {
+
+inline Bits cell(int c) { return (Bits)1 << c; }
+inline bool test(Bits b, int c) { return (b >> c) & 1; }
+inline uint64_t low(Bits b) { return (uint64_t)b; }
+inline uint64_t high(Bits b) { return (uint64_t)(b >> 64); }
+
+//слово поля с клеткой c и ее бит в нем: одна клетка проверяется без 128-битного сдвига.
+//Bits лежит в памяти двумя словами, младшее первым
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "bits::word expects the low word first");
+typedef uint64_t __attribute__((may_alias)) Word;
+inline Word& word(Bits& b, int c) { return reinterpret_cast<Word*>(&b)[c >> 6]; }
+inline Word word(const Bits& b, int c) { return reinterpret_cast<const Word*>(&b)[c >> 6]; }
+inline uint64_t wordBit(int c) { return (uint64_t)1 << (c & 63); }
+
+constexpr Bits make(uint64_t lo, uint64_t hi) { return ((Bits)hi << 64) | lo; }
+
+const Bits all = make(~0ULL, 0xfffffffffULL); //все 100 клеток поля
+const Bits notLeft = make(0xeffbfeffbfeffbfeULL, 0xffbfeffbfULL); //все клетки, кроме столбца x=0
+const Bits notRight = make(0xf7fdff7fdff7fdffULL, 0x7fdff7fdfULL); //все клетки, кроме столбца x=9
+
+inline int count(Bits b) //popcount
+{
+    return __builtin_popcountll(low(b)) + __builtin_popcountll(high(b));
+}
+
+inline int lowest(Bits b) //ctz, b != 0
+{
+    uint64_t lo = low(b);
+    return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(high(b));
+}
+
+//сдвиги на одну клетку без переноса через край поля
+inline Bits east(Bits b) { return (b << 1) & notLeft; }
+inline Bits west(Bits b) { return (b >> 1) & notRight; }
+inline Bits south(Bits b) { return (b << 10) & all; }
+inline Bits north(Bits b) { return b >> 10; }
+inline Bits neighbours(Bits b) { return east(b) | west(b) | south(b) | north(b); }
+//клетки вместе с соседями по сторонам и углам
+inline Bits around(Bits b)
+{
+    Bits row = b | east(b) | west(b);
+    return row | north(row) | south(row);
+}
+
+//корабль длины length с носом в (x, y); 0, если не влезает в поле
+inline Bits ship(int x, int y, int length, bool vertical)
+{
+    if(x < 0 || y < 0 || (vertical ? (x > 9 || y + length > 10) : (y > 9 || x + length > 10)))
+        return 0;
+    Bits b = 0;
+    for(int i=0; i<length; i++)
+        b |= cell(vertical ? x+(y+i)*10 : x+i+y*10);
+    return b;
+}
+
+//корабль, которому принадлежит клетка: растим область по палубам (корабли не длиннее 4 клеток)
+inline Bits shipAt(Bits ships, int c)
+{
+    Bits ship = cell(c);
+    for(int i=0; i<3; i++)
+    {
+        Bits grown = ship | (neighbours(ship) & ships);
+        if(grown == ship)
+            break; //корабль найден целиком раньше
+        ship = grown;
+    }
+    return ship;
+}
+
+}
+
+enum ShotKind { shotMiss, shotHit, shotKill, shotRepeat };
+
+//результат выстрела; для потопленного корабля - его клетки, первая - клетка выстрела
+struct ShotResult
+{
+    ShotKind kind;
+    int killedCount;
+    int killed[4];
+};
+
+//состояние поля одного игрока: 48 байт
+struct Board
+{
+    Bits ships; //палубы
+    Bits hits; //попадания соперника
+    Bits misses; //промахи соперника
+
+    void clear() { ships = hits = misses = 0; }
+    void setField(const char field[100]); //расстановка из comArrange
+    bool isShot(int c) const { return bits::test(hits | misses, c); }
+    bool allSunk() const { return (ships & ~hits) == 0; }
+    Bits sunk() const; //палубы потопленных кораблей
+    //выстрел в клетку c. Повтор и промах (большинство выстрелов) разбираются на месте, без вызова
+    ShotResult shoot(int c)
+    {
+        ShotResult result;
+        result.killedCount = 0;
+        uint64_t bit = bits::wordBit(c);
+        if((bits::word(hits, c) | bits::word(misses, c)) & bit)
+        {
+            result.kind = shotRepeat;
+            return result;
+        }
+        if(!(bits::word(ships, c) & bit))
+        {
+            bits::word(misses, c) |= bit;
+            result.kind = shotMiss;
+            return result;
+        }
+        bits::word(hits, c) |= bit;
+        return hitAt(c);
+    }
+    ShotResult hitAt(int c) const; //попадание в c уже отмечено: ранен или потоплен
+};
+
+static_assert(sizeof(Board) == 48, "Board must stay 48 bytes");
+
+#endif // BITBOARD_H
@@ -0,0 +1,142 @@
+#include "bot.h"
+#include "fleet.h"
+#include <QTimer>
+
+Bot::Bot(unsigned seed, LoadStats* stats, int paceMs, QObject* parent): QObject(parent), _client(this), _rng(seed)
+{
+    _stats = stats;
+    _pace = paceMs;
+    _port = 0;
+    _tried = 0;
+    _waitResult = false;
+    _vsAi = false;
+    _bucket = 0;
+    connect(&_client,SIGNAL(connected()),this,SLOT(onConnected()));
+    connect(&_client,SIGNAL(connectFailed(QString)),this,SLOT(onConnectFailed(QString)));
+    connect(&_client,SIGNAL(gameStarted(bool)),this,SLOT(onGameStarted(bool)));
+    connect(&_client,SIGNAL(missed(int,bool)),this,SLOT(onMissed(int,bool)));
+    connect(&_client,SIGNAL(damaged(int,bool)),this,SLOT(onDamaged(int,bool)));
+    connect(&_client,SIGNAL(killed(QVector<int>,bool)),this,SLOT(onKilled(QVector<int>,bool)));
+    connect(&_client,SIGNAL(shotRejected(int)),this,SLOT(onShotRejected(int)));
+    connect(&_client,SIGNAL(gameOver(bool)),this,SLOT(onGameOver(bool)));
+    connect(&_client,SIGNAL(arrangeRejected(int)),this,SLOT(onArrangeRejected(int)));
+}
+
+void Bot::start(const QString& host, int port)
+{
+    _host = host;
+    _port = port;
+    reconnect();
+}
+
+void Bot::reconnect()
+{
+    QByteArray host = _host.toLatin1();
+    _client.connectTo(host.data(), _port);
+}
+
+void Bot::onConnected()
+{
+    arrange();
+}
+
+void Bot::onConnectFailed(QString error)
+{
+    Q_UNUSED(error);
+    _stats->errors++;
+    _waitResult = false;
+    QTimer::singleShot(1000, this, SLOT(reconnect())); //сервер перегружен или недоступен - пробуем позже
+}
+
+void Bot::arrange()
+{
+    char field[100];
+    fleetToField(randomFleet(_rng), field);
+    _tried = 0;
+    _waitResult = false;
+    _sentAt = Clock::now();
+    _client.sendArrange(field, _vsAi, _bucket);
+}
+
+void Bot::onGameStarted(bool myMove)
+{
+    _stats->arrange.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _sentAt).count());
+    if(myMove)
+        next();
+}
+
+void Bot::shotDone(bool mine)
+{
+    if(mine)
+    {
+        _stats->dot.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _sentAt).count());
+        _stats->moves++;
+        _waitResult = false;
+    }
+    next();
+}
+
+void Bot::onMissed(int cell, bool mine)
+{
+    Q_UNUSED(cell);
+    shotDone(mine);
+}
+
+void Bot::onDamaged(int cell, bool mine)
+{
+    Q_UNUSED(cell);
+    shotDone(mine);
+}
+
+void Bot::onKilled(QVector<int> cells, bool mine)
+{
+    Q_UNUSED(cells);
+    shotDone(mine);
+}
+
+void Bot::onShotRejected(int cell)
+{
+    Q_UNUSED(cell);
+    _stats->errors++;
+    _waitResult = false;
+    next();
+}
+
+void Bot::onArrangeRejected(int error)
+{
+    Q_UNUSED(error);
+    _stats->errors++; //случайная расстановка всегда правильная, это ошибка сервера
+}
+
+void Bot::onGameOver(bool won)
+{
+    if(won)
+        _stats->matches++; //каждую партию считаем один раз - у победителя
+    arrange(); //сразу в следующую партию
+}
+
+void Bot::next()
+{
+    if(!_client.isMyMove() || _waitResult)
+        return;
+    _waitResult = true;
+    if(_pace > 0)
+    {
+        QTimer::singleShot(_pace, this, SLOT(shoot()));
+    } else {
+        shoot();
+    }
+}
+
+void Bot::shoot()
+{
+    if(bits::count(_tried) >= 100)
+        return;
+    int cell;
+    do {
+        cell = _rng.below(100);
+    } while(bits::test(_tried, cell));
+    _tried |= bits::cell(cell);
+    _sentAt = Clock::now();
+    _client.sendDot(cell);
+}
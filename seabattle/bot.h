@@ -0,0 +1,63 @@
+#ifndef BOT_H
+#define BOT_H
+#include <QObject>
+#include <QString>
+#include "rng.h"
+#include <chrono>
+#include "client.h"
+#include "bitboard.h"
+#include "histogram.h"
+
+//общая статистика нагрузочного теста
+struct LoadStats
+{
+    LoadStats() : moves(0), matches(0), errors(0) {}
+    Histogram arrange; //comArrange -> comStartGame, нс
+    Histogram dot; //comDot -> результат выстрела, нс
+    quint64 moves;
+    quint64 matches;
+    quint64 errors;
+};
+
+//игрок без интерфейса: случайная расстановка и выстрелы в случайные клетки
+class Bot: public QObject
+{
+    Q_OBJECT
+public:
+    Bot(unsigned seed, LoadStats* stats, int paceMs, QObject* parent = 0);
+    void start(const QString& host, int port);
+    void setVsAi(bool vsAi) { _vsAi = vsAi; } //соперник - компьютер на сервере
+    void setBucket(int bucket) { _bucket = bucket; } //корзина подбора соперника
+
+private slots:
+    void onConnected();
+    void onConnectFailed(QString error);
+    void onGameStarted(bool myMove);
+    void onMissed(int cell, bool mine);
+    void onDamaged(int cell, bool mine);
+    void onKilled(QVector<int> cells, bool mine);
+    void onShotRejected(int cell);
+    void onArrangeRejected(int error);
+    void onGameOver(bool won);
+    void reconnect();
+    void shoot();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    Client _client;
+    LoadStats* _stats;
+    Rng _rng;
+    int _pace; //пауза перед выстрелом, мс
+    QString _host;
+    int _port;
+    Bits _tried; //клетки, по которым уже стреляли
+    bool _waitResult;
+    bool _vsAi;
+    int _bucket;
+    Clock::time_point _sentAt;
+    void arrange();
+    void shotDone(bool mine);
+    void next(); //если наш ход - стреляем
+};
+
+#endif // BOT_H
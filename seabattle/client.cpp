@@ -1,19 +1,33 @@
 #include "client.h"
-extern MainWindow* _mainWindow;
-Client::Client(MainWindow *parent) : QObject(parent)
+#include <netinet/tcp.h>
+#include <errno.h>
+#include <string.h>
+Client::Client(QObject *parent) : QObject(parent)
 {
-    byteAv = 0; //количество доступных байтов
-    _parent = parent;
+    myMove = false;
     win = 0;
     lose = 0;
-    buf[0]=-1; //для подготовки к приему данных
     blockSendDot = false;
+    isConnecting = false;
+    _hasToken = false;
+    _resuming = false;
+    sock = -1;
+    _readNotifier = 0;
+    _writeNotifier = 0;
+    _timer.setSingleShot(true);
+    QObject::connect(&_timer,SIGNAL(timeout()),this,SLOT(onConnectTimeout()));
 }
-bool Client::connectTo(char* hostinfo,int port){
-    sock = socket(AF_INET, SOCK_STREAM, 0); // создание TCP-сокета
+Client::~Client()
+{
+    closeSock();
+}
+bool Client::connectTo(char* hostinfo,int port, int timeoutMs){
+    closeSock(); //прошлое соединение больше не нужно
+    sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0); // создание неблокирующего TCP-сокета
     if(sock < 0)
     {
         perror("socket");
+        fail("socket");
         return false;
     }
     addr.sin_family = AF_INET;
@@ -21,145 +35,317 @@ bool Client::connectTo(char* hostinfo,int port){
     // Указываем параметры сервера; // или любой другой порт...
     addr.sin_addr.s_addr = inet_addr(hostinfo);
     _port = port;
-    _hostinfo = hostinfo;
-    if(::connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) // установка соединения с сервером
+    if(addr.sin_addr.s_addr == INADDR_NONE)
+    {
+        fail("bad address");
+        return false;
+    }
+    int yes = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int)); //выстрел уходит сразу
+    win = 0;
+    lose = 0;
+    myMove = false;
+    blockSendDot = false;
+    _resuming = false;
+    _in.clear();
+    _out.clear();
+    _readNotifier = new QSocketNotifier(sock, QSocketNotifier::Read, this);
+    _readNotifier->setEnabled(false);
+    QObject::connect(_readNotifier,SIGNAL(activated(int)),this,SLOT(checkSock()));
+    _writeNotifier = new QSocketNotifier(sock, QSocketNotifier::Write, this);
+    QObject::connect(_writeNotifier,SIGNAL(activated(int)),this,SLOT(onWritable()));
+    // установка соединения с сервером не блокирует окно: итог придет через _writeNotifier
+    if(::connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
     {
         perror("Подключение");
+        fail(strerror(errno));
         return false;
     }
-    int flags = 1;  //для того, чтобы не было зависаний
-    ioctl(sock,FIONBIO,&flags); // типа для того, чтобы не блокировался I/O
-    QObject::connect(&_timer,SIGNAL(timeout()),this,SLOT(checkSock()));
-    _timer.start(100); //проверка по таймеру каждые 100 мс
+    isConnecting = true;
+    emit connectProgress("connecting");
+    _timer.start(timeoutMs);
     return true;
-    close(sock);
 }
 
-void Client::writeData(char* data) //запись данных на сокет
+void Client::onConnectTimeout()
+{
+    if(isConnecting)
+    {
+        fail("timeout");
+    }
+}
+
+void Client::onWritable()
 {
-    int bytesWrite = sizeof(data);
-    send(sock, data, bytesWrite,0); //в порядке поступления байтов
+    if(isConnecting)
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+        if(err != 0)
+        {
+            fail(strerror(err));
+            return;
+        }
+        isConnecting = false;
+        _timer.stop();
+        _readNotifier->setEnabled(true);
+        if(_resuming)
+        {
+            emit connectProgress("resuming");
+            writeFrame(comResume, _token, resumeTokenSize); //ответ - comSnapshot
+        } else {
+            emit connectProgress("connected");
+            emit connected();
+        }
+    }
+    int r = _out.flush(sock);
+    if(r < 0)
+    {
+        fail("disconnected");
+        return;
+    }
+    _writeNotifier->setEnabled(r == 0); //ждем места в буфере, только если что-то не ушло
 }
 
-void Client::readData(char* data, int byteCount) //считывание данных с сокета
+void Client::writeFrame(int command, const char* payload, int length) //запись кадра на сокет
 {
-    int bytesRead = 0;
-    bytesRead = recv(sock, data, byteCount,0); // принимаем сообщение с сокета
-    if(bytesRead <= 0)
+    if(sock == -1 || isConnecting)
+        return;
+    int size = encodeFrame(_out.reserve(frameHeaderSize + length), command, payload, length);
+    _out.commit(size);
+    int r = _out.flush(sock);
+    if(r < 0)
+    {
+        fail("disconnected");
+        return;
+    }
+    if(r == 0)
     {
-        return; //проверка на получение данных
+        _writeNotifier->setEnabled(true); //остаток отправим, когда ядро освободит буфер
     }
 }
 
-void Client::checkSock() //проверка доступных байтов
+void Client::closeSock()
 {
-    if(byteAv || ioctl(sock,FIONREAD,&byteAv)<0) //если данные не получены
+    _timer.stop();
+    isConnecting = false;
+    //уведомители могут быть источником текущего сигнала, удаляем их после возврата в цикл
+    if(_readNotifier)
     {
-        if(buf[0]==-1)
+        _readNotifier->setEnabled(false);
+        _readNotifier->deleteLater();
+        _readNotifier = 0;
+    }
+    if(_writeNotifier)
+    {
+        _writeNotifier->setEnabled(false);
+        _writeNotifier->deleteLater();
+        _writeNotifier = 0;
+    }
+    if(sock != -1)
+    {
+        close(sock);
+        sock = -1;
+    }
+}
+
+void Client::fail(QString error)
+{
+    closeSock();
+    emit connectProgress(error);
+    emit connectFailed(error);
+}
+
+void Client::checkSock() //прием и разбор кадров
+{
+    int bytesRead = _in.fill(sock); //одним readv забираем все, что пришло
+    if(bytesRead == 0 || (bytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+        fail("disconnected"); //сервер закрыл соединение
+        return;
+    }
+    if(bytesRead < 0)
+    {
+        return;
+    }
+    Frame frame;
+    int r;
+    while((r = decodeFrame(_in, frame, _scratch)) != 0)
+    {
+        if(r < 0)
         {
-            readData(buf,1); //считываем первый байт
-            ioctl(sock,FIONREAD,&byteAv); //обновляем данные о доступных байтов
+            fail("protocol error"); //дальше поток не разобрать: закрываем, как и сервер
+            return;
         }
-        int size; //определяем размер оставшихся байт в блоке
-        size = (buf[0]==comKill)?4:1; //и записываем
-                                //для координат палуб
-        if(byteAv < size)
+        const char* data = frame.payload;
+        if(frame.length < ((frame.command==comKill)?4:1))
         {
-            ioctl(sock,FIONREAD,&byteAv);
-            return;
-        } //если данные получены
-        readData(&buf[1],size); //то читаем все оставшиеся данные в блоке
+            continue; //кадр короче положенного
+        }
         blockSendDot = false;
-        switch(buf[0]){
+        bool mine = myMove; //результат моего выстрела или выстрела соперника
+        switch(frame.command){
         case comVoid: //промах
-            if(_parent->isMyMove)
-            {
-                _mainWindow->changeCellType(buf[1],5);
-                _mainWindow->setStatus("enemyMove");
-            } else {
-                _mainWindow->changeCellType2(buf[1],5);
-                _mainWindow->setStatus("yourMove");
-            }
-            _parent->isMyMove = !_parent->isMyMove;  //передаем ход другому игроку
+            myMove = !myMove;  //передаем ход другому игроку
+            emit missed(data[0], mine);
+            emit statusChanged(myMove?"yourMove":"enemyMove");
             break;
         case comDamage:
-            if(_parent->isMyMove)
-            {
-              _mainWindow->changeCellType(buf[1],6);
-            } else {
-              _mainWindow->changeCellType2(buf[1],6);
-            }
+            emit damaged(data[0], mine);
             break;
         case comKill:
-            if(_parent->isMyMove)
+        {
+            QVector<int> cells;
+            for(int i=0; i<4; i++)
             {
-                win++;
-                for(int i=0; i<4; i++)
+                if(data[i]!=-1)
                 {
-                    if(buf[i+1]!=-1)
-                    {
-                        _mainWindow->changeCellType(buf[i+1],7);
-                    }
+                    cells.append(data[i]);
                 }
+            }
+            if(mine)
+            {
+                win++;
             } else {
                 lose++;
-                for(int i=0; i<4; i++)
-                {
-                    if(buf[i+1]!=-1)
-                    {
-                        _mainWindow->changeCellType2(buf[i+1],7);
-                    }
-                }
             }
-            if(win==10)
+            bool over = (win==10 || lose==10);
+            if(over)
             {
-                _mainWindow->setStatus("youWin");
-                _parent->isMyMove=false;
+                myMove = false; //стрелять больше некуда
+                _hasToken = false;
             }
-            if(lose==10)
+            emit killed(cells, mine);
+            if(over)
             {
-                _mainWindow->setStatus("youLose");
+                emit statusChanged((win==10)?"youWin":"youLose");
+                emit gameOver(win==10);
             }
+        }
             break;
         case comStartGame:
-            _parent->game();
-            if(buf[1])
+            win = 0;
+            lose = 0;
+            myMove = data[0];
+            _hasToken = frame.length >= 1 + resumeTokenSize; //старый сервер билета не присылает
+            if(_hasToken)
             {
-                _parent->isMyMove = true;
-                _mainWindow->setStatus("yourMove");
-            } else {
-                _mainWindow->setStatus("enemyMove");
+                memcpy(_token, data + 1, resumeTokenSize);
             }
+            emit gameStarted(myMove);
+            emit statusChanged(myMove?"yourMove":"enemyMove");
             break;
         case comError:
+            emit shotRejected(data[0]);
+            break;
+        case comArrangeError:
+            emit arrangeRejected(data[0]);
+            break;
+        case comGameOver: //вышло время хода или соперник отключился
+            myMove = false;
+            _hasToken = false;
+            emit statusChanged(data[0]?"youWin":"youLose");
+            emit gameOver(data[0]);
+            break;
+        case comSnapshot:
+        {
+            _resuming = false;
+            Snapshot snapshot;
+            if(!decodeSnapshot(data, frame.length, snapshot))
+            {
+                _hasToken = false;
+                fail("match is over"); //место не дождалось или партия уже окончена
+                return;
+            }
+            win = snapshot.wins;
+            lose = snapshot.losses;
+            myMove = snapshot.myMove;
+            replayBoard(snapshot.enemyHits, snapshot.enemyMisses, snapshot.enemySunk, true);
+            Board board = { snapshot.myShips, snapshot.myHits, snapshot.myMisses };
+            replayBoard(snapshot.myHits, snapshot.myMisses, board.sunk(), false);
+            emit resumed(myMove);
+            emit statusChanged(myMove?"yourMove":"enemyMove");
+        }
+            break;
+        case comOpponent: //соперник отключился (место ждет его) или вернулся
+            if(data[0] && frame.length >= 3)
+            {
+                int seconds = ((unsigned char)data[1] << 8) | (unsigned char)data[2];
+                emit statusChanged("opponentAway " + QString::number(seconds) + "s");
+            }
+            else if(data[0])
+            {
+                emit statusChanged("opponentAway");
+            }
+            else
+            {
+                emit statusChanged(myMove?"yourMove":"enemyMove");
+            }
             break;
         default:
             break;
         }
-        ioctl(sock,FIONREAD,&byteAv);
-        buf[0]=-1;
     }
 }
 
-void Client::sendArrange(QVector<int>& field) // отправить расположение
+void Client::replayBoard(Bits hits, Bits misses, Bits sunk, bool mine)
 {
-    char data[101];
-    data[0] = comArrange;
-    for(int i = 1; i<=100; i++)
+    for(Bits b = misses; b; b &= b - 1)
+    {
+        emit missed(bits::lowest(b), mine);
+    }
+    for(Bits b = hits & ~sunk; b; b &= b - 1)
+    {
+        emit damaged(bits::lowest(b), mine);
+    }
+    while(sunk)
     {
-        data[i] = field[i-1];
+        Bits ship = bits::shipAt(sunk, bits::lowest(sunk));
+        QVector<int> cells;
+        for(Bits b = ship; b; b &= b - 1)
+        {
+            cells.append(bits::lowest(b));
+        }
+        emit killed(cells, mine);
+        sunk &= ~ship;
     }
-    send(sock,data, 101,0);
+}
+
+bool Client::resumeTo(char* hostinfo, int port, int timeoutMs)
+{
+    if(!_hasToken || !connectTo(hostinfo, port, timeoutMs))
+    {
+        return false;
+    }
+    _resuming = true;
+    return true;
+}
+
+void Client::sendArrange(QVector<int>& field, bool vsAi) // отправить расположение
+{
+    char cells[100];
+    for(int i = 0; i<100; i++)
+    {
+        cells[i] = field[i];
+    }
+    sendArrange(cells, vsAi);
+}
+
+void Client::sendArrange(const char field[100], bool vsAi, int bucket)
+{
+    char data[102];
+    memcpy(data, field, 100);
+    data[100] = vsAi?arrangeVsAi:arrangeHuman;
+    data[101] = bucket;
+    writeFrame(comArrange, data, bucket ? 102 : 101); //корзина 0 - прежний кадр в 101 байт
 }
 
 void Client::sendDot(char cell) //отправить выстрел
 {
     if(!blockSendDot)
     {
-        char data[2];
-        data[0] = comDot;
-        data[1] = cell;
-        send(sock,data, 2,0);
+        writeFrame(comDot, &cell, 1);
         blockSendDot = true; //для того, чтобы нельзя было стрелять дважды в одну клетку
     }
 }
@@ -11,46 +11,70 @@
 #include <termios.h>
 #include <QObject>
 #include <QTimer>
+#include <QSocketNotifier>
+#include <QVector>
+#include <QString>
 #include <sys/ioctl.h>
 #include <string>
-#include "mypoint.h"
-#include "mainwindow.h"
+#include "protocol.h"
+#include "outqueue.h"
 
-enum com { comDot, //выстрел
-           comArrange, //расположение
-           comKill, //убит
-           comDamage, //попадание
-           comVoid, //промах
-           comError, //нельзя стрелять
-           comStartGame
-        };
-class MainWindow;
+//сетевая часть игрока без интерфейса: о ходе игры сообщает сигналами
 class Client: public QObject
 {
     Q_OBJECT
 public:
-    Client(MainWindow *parent = 0);
-    bool connectTo(char* hostinfo, int port); //подключение
-    void writeData(char* data); //запись данных на сокет
-    void readData(char* data, int byteCount); //считывание данных с сокета
-    void sendArrange(QVector<int> &field); //отправить расположение
+    Client(QObject *parent = 0);
+    ~Client();
+    bool connectTo(char* hostinfo, int port, int timeoutMs = 5000); //начать подключение, итог - сигналом
+    void sendArrange(QVector<int> &field, bool vsAi = false); //отправить расположение; vsAi - играть с компьютером
+    void sendArrange(const char field[100], bool vsAi = false, int bucket = 0); //bucket - корзина подбора соперника
     void sendDot(char cell); //отправить выстрел
+    bool isMyMove() const { return myMove; }
+    bool canResume() const { return _hasToken; } //идет партия, в которую можно вернуться после обрыва
+    bool resumeTo(char* hostinfo, int port, int timeoutMs = 5000); //переподключиться и вернуться в партию, итог - сигналом resumed
+
+signals:
+    void connectProgress(QString status); //ход подключения
+    void connected(); //соединение установлено
+    void connectFailed(QString error); //подключиться не удалось или соединение разорвано
+    void gameStarted(bool myMove); //обе расстановки приняты
+    void missed(int cell, bool mine); //промах; mine - стрелял этот игрок
+    void damaged(int cell, bool mine); //попадание
+    void killed(QVector<int> cells, bool mine); //корабль потоплен
+    void shotRejected(int cell); //сервер не принял выстрел
+    void arrangeRejected(int error); //сервер не принял расстановку, код FleetError
+    void gameOver(bool won);
+    void resumed(bool myMove); //вернулись в партию: перед этим поля заново переданы сигналами выстрелов
+    void statusChanged(QString status); //yourMove, enemyMove, youWin, youLose, opponentAway
 
 private:
-    char buf[4];
-    QTimer _timer;
+    RingBuffer _in; //принятые, но еще не разобранные байты
+    char _scratch[maxFramePayload];
+    OutQueue _out; //кадры, которые ядро еще не приняло
+    QTimer _timer; //таймаут подключения
+    QSocketNotifier* _readNotifier;
+    QSocketNotifier* _writeNotifier;
     int _port;
     int sock;                 // дескриптор сокета
     struct sockaddr_in addr; // структура с адресом
-    char* _hostinfo;
-    int byteAv; //количество доступных байтов
-    MainWindow* _parent;
+    bool myMove;
     int win;
     int lose;
     bool blockSendDot;
+    bool isConnecting;
+    char _token[resumeTokenSize]; //билет возврата из comStartGame
+    bool _hasToken;
+    bool _resuming; //после подключения отправить comResume вместо ожидания расстановки
+    void writeFrame(int command, const char* payload, int length); //запись кадра на сокет
+    void closeSock();
+    void fail(QString error);
+    void replayBoard(Bits hits, Bits misses, Bits sunk, bool mine); //сигналы выстрелов по полю из comSnapshot
 
 private slots:
-    void checkSock(); //проверка доступных байтов
+    void checkSock(); //прием и разбор кадров
+    void onWritable(); //подключение завершилось или освободился буфер отправки
+    void onConnectTimeout();
 };
 
 #endif // CLIENT_H
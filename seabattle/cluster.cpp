@@ -0,0 +1,220 @@
+#include "cluster.h"
+#include <QThread>
+#include <QSemaphore>
+#include <QCoreApplication>
+#include <random>
+
+//поток со своим сервером: сервер создается и живет внутри run, чтобы его сокеты и таймеры принадлежали этому потоку
+class Cluster::Worker: public QThread
+{
+public:
+    //state - состояние потока от старого процесса, 0 - начать с пустого
+    Worker(const ServerConfig& config, Matchmaker* matchmaker, ServerDirectory* directory, StateReader* state) :
+        _config(config), _matchmaker(matchmaker), _directory(directory), _state(state), _server(0), _ok(false) {}
+    bool waitStarted() { _started.acquire(); return _ok; }
+    Server* server() const { return _server; } //после waitStarted и до остановки потока
+
+protected:
+    void run()
+    {
+        Server server;
+        server.setMatchmaker(_matchmaker);
+        server.setDirectory(_directory);
+        _ok = server.doStartServer(_config) && (!_state || server.importState(*_state));
+        _server = _ok ? &server : 0;
+        _started.release();
+        if(_ok)
+            exec();
+        _server = 0;
+    }
+
+private:
+    ServerConfig _config;
+    Matchmaker* _matchmaker;
+    ServerDirectory* _directory;
+    StateReader* _state;
+    Server* _server;
+    bool _ok;
+    QSemaphore _started;
+};
+
+Cluster::Cluster()
+{
+}
+
+Cluster::~Cluster()
+{
+    for(int i=0; i<_workers.size(); i++)
+    {
+        _workers[i]->quit();
+        _workers[i]->wait();
+        delete _workers[i];
+    }
+}
+
+bool Cluster::start(const ServerConfig& config)
+{
+    ServerConfig shared = config;
+    int takeover = -1; //сокет для подтверждения старому процессу
+    if(!config.takeoverPath.isEmpty())
+    {
+        takeover = requestState(config.takeoverPath.toStdString(), _state, _stateFds);
+        if(takeover < 0 || !splitState(shared))
+        {
+            qCritical() << "cannot take over from" << config.takeoverPath;
+            if(takeover >= 0)
+                close(takeover);
+            return false;
+        }
+    }
+    if(!shared.seed)
+    {
+        std::random_device device;
+        shared.seed = ((quint64)device() << 32) | device(); //одно зерно на все потоки, в логе у каждого свое смещение
+    }
+    _directory.resize(shared.workers);
+    for(int i=1; i<shared.workers; i++)
+    {
+        ServerConfig own = shared;
+        own.worker = i;
+        own.metricsAddress.clear(); //страница метрик одна, на потоке 0: она и так собирает все потоки
+        StateReader* state = takeover >= 0 ? &_sections[i] : 0;
+        if(state)
+        {
+            own.listener = state->getFd();
+            own.metricsListener = state->getFd();
+        }
+        Worker* worker = new Worker(own, &_matchmaker, &_directory, state);
+        _workers.append(worker);
+        worker->start();
+        if(!worker->waitStarted())
+        {
+            if(takeover >= 0)
+                close(takeover); //без подтверждения старый процесс продолжит работу
+            return false;
+        }
+    }
+    _main.setMatchmaker(&_matchmaker);
+    _main.setDirectory(&_directory);
+    if(shared.workers > 1)
+        _main.setTraceControl(this);
+    StateReader* state = takeover >= 0 ? &_sections[0] : 0;
+    if(state)
+    {
+        shared.listener = state->getFd();
+        shared.metricsListener = state->getFd();
+    }
+    bool ok = _main.doStartServer(shared) && (!state || _main.importState(*state));
+    if(takeover >= 0)
+    {
+        if(ok && !sendAck(takeover))
+            ok = false; //старый процесс уже не ждет: он продолжит работу, а этот не должен
+        close(takeover);
+        _state.clear(); //дескрипторы разобраны серверами
+        _stateFds.clear();
+        _sections.clear();
+    }
+    //путь освобождается старым процессом после подтверждения, так что сокет преемника - только теперь
+    if(ok && !shared.handoverPath.isEmpty() && !_endpoint.open(shared.handoverPath.toStdString(), _main.reactor(), this))
+        ok = false;
+    return ok;
+}
+
+bool Cluster::splitState(ServerConfig& config)
+{
+    StateReader top(_state.data(), _state.size(), _stateFds.data(), _stateFds.size());
+    int workers = top.get32();
+    config.seed = top.get64();
+    if(workers != config.workers)
+        qWarning() << "workers:" << workers << "as in the old process"; //билеты возврата и номера партий привязаны к потокам
+    config.workers = workers;
+    size_t fdOffset = 0;
+    for(int i=0; i<workers && top.ok(); i++)
+    {
+        uint32_t size = top.get32();
+        uint32_t fdCount = top.get32();
+        const char* data = top.skip(size);
+        if(!data || fdOffset + fdCount > _stateFds.size())
+            return false;
+        _sections.push_back(StateReader(data, size, _stateFds.data() + fdOffset, fdCount));
+        fdOffset += fdCount;
+    }
+    return top.ok() && workers > 0 && (int)_sections.size() == workers;
+}
+
+void Cluster::control(int type, std::vector<StateWriter>* sections)
+{
+    //потоки работают параллельно, ждем всех
+    QVector<ControlMail*> mails;
+    for(int i=0; i<_workers.size(); i++)
+    {
+        ControlMail* mail = new ControlMail(type, sections ? &(*sections)[i + 1] : 0);
+        mails.append(mail);
+        _workers[i]->server()->mailbox()->post(mail);
+    }
+    for(int i=0; i<mails.size(); i++)
+    {
+        mails[i]->done.acquire();
+        delete mails[i];
+    }
+}
+
+void Cluster::handOver(int sock)
+{
+    //сначала останавливаются все потоки: пока хоть один работает, он может отправить игрока уже записанному соседу
+    uint64_t started = TimerWheel::clockMs();
+    _main.freeze();
+    control(mailFreeze);
+    std::vector<StateWriter> sections(_workers.size() + 1);
+    _main.mailbox()->onReadable(); //переезды, отправленные потоку 0 до заморозки соседей
+    _main.exportState(sections[0]);
+    control(mailExport, &sections);
+    StateWriter state;
+    state.put32(sections.size());
+    state.put64(_main.config().seed);
+    for(size_t i=0; i<sections.size(); i++)
+    {
+        state.put32(sections[i].data().size());
+        state.put32(sections[i].fds().size());
+        state.append(sections[i]); //номера дескрипторов в части - от ее начала
+    }
+    if(sendState(sock, state) && waitAck(sock))
+    {
+        qDebug() << "handed over" << state.data().size() << "bytes and" << state.fds().size() << "sockets in"
+                 << TimerWheel::clockMs() - started << "ms";
+        _endpoint.release(); //путь уже слушает новый процесс
+        _main.handedOver();
+        QCoreApplication::quit();
+        return;
+    }
+    _main.thaw();
+    control(mailThaw);
+}
+
+bool Cluster::traceMatch(int id, bool on)
+{
+    if(id <= 0)
+        return false;
+    int worker = (id - 1) % (_workers.size() + 1); //номера партий чередуются по потокам
+    if(worker == 0)
+        return _main.traceMatch(id, on); //страница метрик на этом же потоке
+    _workers[worker - 1]->server()->mailbox()->post(new TraceMail(TraceMail::match, id, on));
+    return true;
+}
+
+bool Cluster::traceConnection(int sock, bool on)
+{
+    if(_main.traceConnection(sock, on))
+        return true;
+    //чей сокет, знает только владелец: спрашиваем всех
+    for(int i=0; i<_workers.size(); i++)
+        _workers[i]->server()->mailbox()->post(new TraceMail(TraceMail::connection, sock, on));
+    return !_workers.isEmpty();
+}
+
+void Cluster::traceOff()
+{
+    _main.traceOff();
+    for(int i=0; i<_workers.size(); i++)
+        _workers[i]->server()->mailbox()->post(new TraceMail(TraceMail::off, 0, false));
+}
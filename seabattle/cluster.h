@@ -0,0 +1,42 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+#include <QVector>
+#include <vector>
+#include "server.h"
+#include "matchmaker.h"
+#include "trace.h"
+#include "handover.h"
+
+//рабочие потоки выделенного сервера. Поток 0 - вызывающий, с его циклом Qt; остальные - QThread
+//со своим циклом. Общие у потоков только очередь подбора, список потоков и метрики, все остальное - письмами.
+//При takeoverPath кластер забирает работу у старого процесса, при handoverPath - ждет нового и отдает ему свою
+class Cluster: public TraceControl, public HandoverSource
+{
+public:
+    Cluster();
+    ~Cluster();
+    bool start(const ServerConfig& config); //false - какой-то поток не запустился или старый процесс не отдал работу
+    //трасса включается на потоке, которому принадлежит партия или соединение.
+    //Чужим потокам уходит письмо, поэтому для них ответ - "принято", а не "найдено"
+    bool traceMatch(int id, bool on);
+    bool traceConnection(int sock, bool on);
+    void traceOff();
+    void handOver(int sock); //подключился новый процесс: заморозить потоки, отдать состояние, завершиться
+
+private:
+    class Worker;
+    Matchmaker _matchmaker;
+    ServerDirectory _directory; //объявлен до потоков: потоки стирают себя из него при остановке
+    Server _main; //поток 0
+    QVector<Worker*> _workers; //потоки 1..n-1
+    HandoverEndpoint _endpoint;
+    std::vector<char> _state; //полученное от старого процесса, читается при запуске потоков
+    std::vector<int> _stateFds;
+    std::vector<StateReader> _sections; //части _state по потокам
+    bool splitState(ServerConfig& config); //число потоков и зерно - как у старого процесса
+    void control(int type, std::vector<StateWriter>* sections = 0); //письмо потокам 1..n-1 и ожидание всех
+    Cluster(const Cluster&);
+    Cluster& operator=(const Cluster&);
+};
+
+#endif // CLUSTER_H
@@ -0,0 +1,143 @@
+#include "fleet.h"
+
+static void setAroundShip(int xCell,int yCell,int aroundShip[100])
+{
+    if(yCell<=9 && yCell>=0 && xCell<=9 && xCell>=0)
+        aroundShip[xCell+yCell*10]= 1;
+}
+
+Bits randomFleet(Rng& rng)
+{
+    for(;;)
+    {
+        Bits ships = 0;
+        Bits blocked = 0; //занятые клетки вместе с ореолом
+        int placed = 0;
+        for(; placed<fleetSize; placed++)
+        {
+            int length = fleetShips[placed];
+            int tries = 0;
+            for(; tries<200; tries++)
+            {
+                bool vertical = rng.below(2);
+                int x = rng.below(vertical ? 10 : 11-length);
+                int y = rng.below(vertical ? 11-length : 10);
+                Bits ship = bits::ship(x, y, length, vertical);
+                if(!(ship & blocked))
+                {
+                    ships |= ship;
+                    blocked |= bits::around(ship);
+                    break;
+                }
+            }
+            if(tries == 200)
+                break; //флот не поместился, начинаем заново
+        }
+        if(placed == fleetSize)
+            return ships;
+    }
+}
+
+void fleetToField(Bits ships, char field[100])
+{
+    for(int i=0; i<100; i++)
+    {
+        field[i] = bits::test(ships, i);
+    }
+}
+
+FleetError validateField(const char field[100])
+{
+    Bits ships = 0;
+    for(int i=0; i<100; i++)
+    {
+        if(field[i] & ~1)
+            return fleetBadCell;
+        if(field[i])
+            ships |= bits::cell(i);
+    }
+    return validateFleet(ships);
+}
+
+FleetError validateFleet(Bits ships)
+{
+    using namespace bits;
+    if(count(ships) != 20) //4 + 2*3 + 3*2 + 4*1
+        return fleetBadComposition;
+    Bits row = east(ships) | west(ships); //есть палуба слева или справа
+    Bits column = north(ships) | south(ships); //есть палуба сверху или снизу
+    Bits horizontal = ships & row;
+    Bits vertical = ships & column;
+    //палуба с соседями и по горизонтали, и по вертикали - угол, компонента не прямая
+    if(horizontal & vertical)
+        return fleetBadShape;
+    //соседи по диагонали без общего угла - разные корабли касаются углами
+    if((north(row) | south(row)) & ships)
+        return fleetTouching;
+    //теперь каждая компонента связности - прямой отрезок, считаем их по длинам:
+    //atLeast[k] - число отрезков длиной не меньше k
+    int atLeast[6];
+    Bits h = horizontal & ~east(horizontal); //левые концы горизонтальных отрезков
+    Bits v = vertical & ~south(vertical); //верхние концы вертикальных
+    atLeast[1] = count(ships & ~horizontal & ~vertical) + count(h) + count(v);
+    Bits hRun = horizontal, vRun = vertical;
+    for(int k=2; k<=5; k++)
+    {
+        hRun = west(hRun); //палуба на k-1 клеток правее
+        vRun = north(vRun); //палуба на k-1 клеток ниже
+        h &= hRun;
+        v &= vRun;
+        atLeast[k] = count(h) + count(v);
+    }
+    if(atLeast[5])
+        return fleetBadShape; //корабль длиннее 4 клеток
+    if(atLeast[4] != 1 || atLeast[3] - atLeast[4] != 2 || atLeast[2] - atLeast[3] != 3 || atLeast[1] - atLeast[2] != 4)
+        return fleetBadComposition;
+    return fleetOk;
+}
+
+bool placeShip(int typeShip, bool vert, int xCell, int yCell, int aroundShip[100], int field[100])
+{
+    if (!((xCell >= 0 && xCell <= 9) && (yCell >= 0 && yCell <= 9)))
+        return false;
+    if(vert)
+    {
+        //вертикально клетки над кораблем
+        setAroundShip(xCell-1,yCell-1,aroundShip); //сверху справа
+        setAroundShip(xCell+1,yCell-1,aroundShip); //сверху слева
+        setAroundShip(xCell,yCell-1,aroundShip); //сверху по центру
+        //вертикально клетки под кораблем
+        setAroundShip(xCell-1, yCell+typeShip, aroundShip); //аналогично снизу
+        setAroundShip(xCell+1, yCell+typeShip, aroundShip);
+        setAroundShip(xCell, yCell+typeShip, aroundShip);
+    } else {
+        //горизонтально слева
+        setAroundShip(xCell-1,yCell-1,aroundShip); //сверху слева
+        setAroundShip(xCell-1,yCell+1,aroundShip); //снизу слева
+        setAroundShip(xCell-1,yCell,aroundShip); //слева от корабля
+        //горизонтально справа
+        setAroundShip(xCell+typeShip, yCell-1, aroundShip); //аналогично справа
+        setAroundShip(xCell+typeShip, yCell+1, aroundShip);
+        setAroundShip(xCell+typeShip, yCell, aroundShip);
+    }
+    for(int j = 0;j<typeShip;j++)
+    {
+        if(vert) //корабль вертикально
+        {
+            if(yCell+j > 9 || aroundShip[xCell+(yCell+j)*10]!=0)
+                return false;
+            setAroundShip(xCell-1,yCell+j,aroundShip); //слева
+            setAroundShip(xCell+1,yCell+j,aroundShip); //справа
+            setAroundShip(xCell,yCell+j,aroundShip); //центр
+            field[xCell+(yCell+j)*10]= 1; //палуба
+        } else { //горизонтально
+            if(xCell+j > 9 || aroundShip[(xCell+j)+yCell*10]!=0)
+                return false;
+            setAroundShip(xCell+j,yCell,aroundShip); //центр
+            setAroundShip(xCell+j,yCell-1,aroundShip); //сверху
+            setAroundShip(xCell+j,yCell+1,aroundShip); //снизу
+            field[(xCell+j)+yCell*10]= 1;
+        }
+    }
+    return true;
+}
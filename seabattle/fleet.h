@@ -0,0 +1,29 @@
+#ifndef FLEET_H
+#define FLEET_H
+#include "rng.h"
+#include "bitboard.h"
+
+//состав флота: 1 четырехпалубный, 2 трехпалубных, 3 двухпалубных, 4 однопалубных
+const int fleetSize = 10;
+const int fleetShips[fleetSize] = {4, 3, 3, 2, 2, 2, 1, 1, 1, 1};
+
+//случайная правильная расстановка: корабли не касаются даже углами
+Bits randomFleet(Rng& rng);
+void fleetToField(Bits ships, char field[100]); //в формат comArrange
+
+//итог проверки расстановки на сервере
+enum FleetError { fleetOk,
+                  fleetBadCell, //в клетке не 0 и не 1
+                  fleetBadShape, //корабль не прямая линия или длиннее 4 клеток
+                  fleetTouching, //корабли касаются сторонами или углами
+                  fleetBadComposition //не 1x4, 2x3, 3x2, 4x1
+                };
+
+FleetError validateField(const char field[100]); //расстановка из comArrange
+FleetError validateFleet(Bits ships);
+
+//расстановка корабля на клиенте: проверяет, что он влезает и не касается уже поставленных,
+//отмечает его ореол в aroundShip и палубы в field
+bool placeShip(int typeShip, bool vertical, int xCell, int yCell, int aroundShip[100], int field[100]);
+
+#endif // FLEET_H
@@ -0,0 +1,33 @@
+#include "game.h"
+
+void Game::clear()
+{
+    for(int i=0; i<2; i++)
+    {
+        boards[i].clear();
+        kills[i] = 0;
+    }
+    turn = 0;
+    finished = false;
+}
+
+ShotResult Game::fire(int cell)
+{
+    ShotResult shot = boards[1-turn].shoot(cell);
+    switch(shot.kind)
+    {
+    case shotMiss:
+        turn = 1-turn; //ход переходит к сопернику
+        break;
+    case shotKill:
+        kills[turn]++;
+        if(boards[1-turn].allSunk())
+        {
+            finished = true; //все корабли потоплены, партия окончена
+        }
+        break;
+    default:
+        break; //попадание или повтор: ход остается у стрелявшего
+    }
+    return shot;
+}
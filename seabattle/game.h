@@ -0,0 +1,18 @@
+#ifndef GAME_H
+#define GAME_H
+#include "bitboard.h"
+
+//правила одной партии без сети: поля обоих игроков, очередь хода и счет.
+//Общие для сервера и симулятора, чтобы оба решали исход выстрела одинаково
+struct Game
+{
+    Board boards[2]; //корабли каждого игрока и выстрелы по ним
+    int kills[2]; //сколько кораблей потопил игрок
+    int turn; //чей сейчас ход
+    bool finished; //у одного из игроков потоплены все корабли
+    void clear();
+    ShotResult fire(int cell); //выстрел игрока turn: промах передает ход, последний потопленный корабль завершает партию
+    int winner() const { return finished ? turn : -1; } //победитель ходил последним
+};
+
+#endif // GAME_H
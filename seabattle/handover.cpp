@@ -0,0 +1,284 @@
+#include "handover.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <algorithm>
+
+static const uint32_t handoverMagic = 0x31484253; //"SBH1"
+static const uint32_t handoverVersion = 1; //меняется вместе с форматом состояния
+static const uint32_t ackMagic = 0x4b4f4253; //"SBOK"
+static const int maxFdsPerMessage = 253; //SCM_MAX_FD
+static const int chunkSize = 64*1024; //данные одного сообщения SOCK_SEQPACKET
+static const int timeoutSeconds = 30; //на передачу и запуск преемника
+
+struct HandoverHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size; //байт состояния
+    uint32_t fdCount;
+    uint32_t pad;
+};
+
+void StateWriter::append(const StateWriter& other)
+{
+    _data.insert(_data.end(), other._data.begin(), other._data.end());
+    _fds.insert(_fds.end(), other._fds.begin(), other._fds.end());
+}
+
+static void setTimeouts(int sock)
+{
+    struct timeval timeout = { timeoutSeconds, 0 };
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+static bool sendAll(int sock, const void* data, size_t size)
+{
+    ssize_t n;
+    do {
+        n = send(sock, data, size, MSG_NOSIGNAL);
+    } while(n < 0 && errno == EINTR);
+    return n == (ssize_t)size; //SOCK_SEQPACKET: сообщение уходит целиком или никак
+}
+
+static bool receiveAll(int sock, void* data, size_t size)
+{
+    ssize_t n;
+    do {
+        n = recv(sock, data, size, 0);
+    } while(n < 0 && errno == EINTR);
+    return n == (ssize_t)size;
+}
+
+bool sendState(int sock, const StateWriter& state)
+{
+    const std::vector<char>& data = state.data();
+    const std::vector<int>& fds = state.fds();
+    HandoverHeader header = { handoverMagic, handoverVersion, data.size(), (uint32_t)fds.size(), 0 };
+    if(!sendAll(sock, &header, sizeof(header)))
+    {
+        perror("handover: send");
+        return false;
+    }
+    size_t sent = 0, sentFds = 0;
+    char control[CMSG_SPACE(maxFdsPerMessage * sizeof(int))];
+    while(sent < data.size() || sentFds < fds.size())
+    {
+        int n = std::min((size_t)chunkSize, data.size() - sent);
+        int fdCount = std::min((size_t)maxFdsPerMessage, fds.size() - sentFds);
+        //с дескрипторами должен идти хотя бы один байт: первый байт сообщения служебный
+        char tag = 0;
+        struct iovec iov[2];
+        iov[0].iov_base = &tag;
+        iov[0].iov_len = 1;
+        iov[1].iov_base = (void*)(data.data() + sent);
+        iov[1].iov_len = n;
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        if(fdCount > 0)
+        {
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(fdCount * sizeof(int));
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
+            memcpy(CMSG_DATA(cmsg), fds.data() + sentFds, fdCount * sizeof(int));
+        }
+        ssize_t w;
+        do {
+            w = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        } while(w < 0 && errno == EINTR);
+        if(w != n + 1)
+        {
+            perror("handover: sendmsg");
+            return false;
+        }
+        sent += n;
+        sentFds += fdCount;
+    }
+    return true;
+}
+
+static bool receiveState(int sock, std::vector<char>& data, std::vector<int>& fds)
+{
+    HandoverHeader header;
+    if(!receiveAll(sock, &header, sizeof(header)) || header.magic != handoverMagic)
+    {
+        fprintf(stderr, "handover: no state from the old process\n");
+        return false;
+    }
+    if(header.version != handoverVersion)
+    {
+        fprintf(stderr, "handover: state version %u, expected %u\n", header.version, handoverVersion);
+        return false;
+    }
+    data.resize(header.size);
+    fds.reserve(header.fdCount);
+    size_t received = 0;
+    char tag;
+    char control[CMSG_SPACE(maxFdsPerMessage * sizeof(int))];
+    bool ok = true;
+    while(ok && (received < data.size() || fds.size() < header.fdCount))
+    {
+        struct iovec iov[2];
+        iov[0].iov_base = &tag;
+        iov[0].iov_len = 1;
+        iov[1].iov_base = data.data() + received;
+        iov[1].iov_len = std::min((size_t)chunkSize, data.size() - received);
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n;
+        do {
+            n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        } while(n < 0 && errno == EINTR);
+        if(n <= 0)
+        {
+            perror("handover: recvmsg");
+            msg.msg_controllen = 0;
+            ok = false;
+        }
+        else if(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+        {
+            fprintf(stderr, "handover: truncated message\n");
+            ok = false; //дескрипторы, что все же пришли, закрываем ниже
+        } else {
+            received += n - 1;
+        }
+        for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+            int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int* passed = (const int*)CMSG_DATA(cmsg);
+            fds.insert(fds.end(), passed, passed + count);
+        }
+    }
+    if(!ok || fds.size() != header.fdCount)
+    {
+        for(size_t i=0; i<fds.size(); i++)
+            close(fds[i]);
+        fds.clear();
+        return false;
+    }
+    return true;
+}
+
+int requestState(const std::string& path, std::vector<char>& data, std::vector<int>& fds)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "handover: socket path is too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(sock == -1 || connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+    {
+        perror("handover: connect");
+        if(sock != -1)
+            close(sock);
+        return -1;
+    }
+    setTimeouts(sock);
+    uint32_t request[2] = { handoverMagic, handoverVersion };
+    if(!sendAll(sock, request, sizeof(request)) || !receiveState(sock, data, fds))
+    {
+        close(sock); //старый процесс не получит подтверждения и продолжит работу
+        return -1;
+    }
+    return sock;
+}
+
+bool sendAck(int sock)
+{
+    return sendAll(sock, &ackMagic, sizeof(ackMagic));
+}
+
+bool waitAck(int sock)
+{
+    uint32_t ack = 0;
+    return receiveAll(sock, &ack, sizeof(ack)) && ack == ackMagic;
+}
+
+HandoverEndpoint::HandoverEndpoint()
+{
+    _fd = -1;
+    _owned = false;
+    _reactor = 0;
+    _source = 0;
+}
+
+HandoverEndpoint::~HandoverEndpoint()
+{
+    if(_fd != -1)
+    {
+        close(_fd);
+        if(_owned)
+            unlink(_path.c_str());
+    }
+}
+
+bool HandoverEndpoint::open(const std::string& path, Reactor* reactor, HandoverSource* source)
+{
+    _reactor = reactor;
+    _source = source;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "handover: socket path is too long\n");
+        return false;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    unlink(addr.sun_path); //сокет предшественника: он уже передал все и завершается
+    _fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(bind(_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(_fd, 1) == -1)
+    {
+        perror("handover: bind");
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+    _path = path;
+    _owned = true;
+    return _reactor->add(_fd, this, EPOLLIN | EPOLLET);
+}
+
+void HandoverEndpoint::onReadable()
+{
+    for(;;)
+    {
+        int sock = accept4(_fd, NULL, NULL, SOCK_CLOEXEC); //блокирующий: передача идет одним вызовом
+        if(sock < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return;
+        }
+        setTimeouts(sock);
+        uint32_t request[2] = { 0, 0 };
+        if(receiveAll(sock, request, sizeof(request)) && request[0] == handoverMagic && request[1] == handoverVersion)
+        {
+            _source->handOver(sock);
+        } else {
+            fprintf(stderr, "handover: bad request or another version of the server\n");
+        }
+        close(sock);
+    }
+}
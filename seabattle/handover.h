@@ -0,0 +1,122 @@
+#ifndef HANDOVER_H
+#define HANDOVER_H
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "reactor.h"
+#include "bitboard.h"
+
+//передача работающего сервера новому процессу без разрыва соединений. Старый процесс слушает
+//Unix-сокет (SOCK_SEQPACKET), новый подключается к нему и получает слушающие сокеты и соединения
+//игроков (SCM_RIGHTS) вместе с состоянием всех партий. Старый процесс ждет подтверждения и завершается,
+//а без подтверждения продолжает работать сам
+
+//состояние сервера в байтах. Дескрипторы идут отдельно, в данных вместо них - номера в списке.
+//Числа - в порядке байтов машины: оба процесса на одном хосте
+class StateWriter
+{
+public:
+    void put8(int v) { _data.push_back((char)v); }
+    void put32(uint32_t v) { putBytes(&v, sizeof(v)); }
+    void put64(uint64_t v) { putBytes(&v, sizeof(v)); }
+    void putBits(Bits b) { putBytes(&b, sizeof(b)); }
+    void putBytes(const void* src, int n) { _data.insert(_data.end(), (const char*)src, (const char*)src + n); }
+    char* grow(int n) { size_t at = _data.size(); _data.resize(at + n); return _data.data() + at; } //n байт в конце, заполнить сразу
+    void putFd(int fd) //-1 - дескриптора нет
+    {
+        put32(fd < 0 ? ~0u : _fds.size());
+        if(fd >= 0)
+            _fds.push_back(fd);
+    }
+    void append(const StateWriter& other); //дескрипторы other - в конец списка, номера в данных other не меняются
+    const std::vector<char>& data() const { return _data; }
+    const std::vector<int>& fds() const { return _fds; }
+
+private:
+    std::vector<char> _data;
+    std::vector<int> _fds;
+};
+
+class StateReader
+{
+public:
+    StateReader() : _p(0), _end(0), _fds(0), _fdCount(0), _ok(false) {}
+    StateReader(const char* data, size_t size, const int* fds, int fdCount) :
+        _p(data), _end(data + size), _fds(fds), _fdCount(fdCount), _ok(true) {}
+    int get8() { uint8_t v = 0; getBytes(&v, 1); return v; }
+    uint32_t get32() { uint32_t v = 0; getBytes(&v, sizeof(v)); return v; }
+    uint64_t get64() { uint64_t v = 0; getBytes(&v, sizeof(v)); return v; }
+    Bits getBits() { Bits b = 0; getBytes(&b, sizeof(b)); return b & bits::all; }
+    void getBytes(void* dst, size_t n)
+    {
+        if(!_ok || (size_t)(_end - _p) < n)
+        {
+            _ok = false; //данные кончились: дальше только нули
+            return;
+        }
+        memcpy(dst, _p, n);
+        _p += n;
+    }
+    const char* skip(size_t n) //n байт без копирования, 0 - не хватило
+    {
+        if(!_ok || (size_t)(_end - _p) < n)
+        {
+            _ok = false;
+            return 0;
+        }
+        const char* at = _p;
+        _p += n;
+        return at;
+    }
+    int getFd() //-1 - номер вне списка
+    {
+        uint32_t i = get32();
+        return _ok && i < (uint32_t)_fdCount ? _fds[i] : -1;
+    }
+    bool ok() const { return _ok; }
+
+private:
+    const char* _p;
+    const char* _end;
+    const int* _fds;
+    int _fdCount;
+    bool _ok;
+};
+
+//кому отдавать состояние, когда подключился новый процесс
+class HandoverSource
+{
+public:
+    virtual ~HandoverSource() {}
+    virtual void handOver(int sock) = 0; //отправить все и дождаться подтверждения; сокет закроет вызывающий
+};
+
+//Unix-сокет, на котором старый процесс ждет преемника
+class HandoverEndpoint: public IoHandler
+{
+public:
+    HandoverEndpoint();
+    ~HandoverEndpoint();
+    bool open(const std::string& path, Reactor* reactor, HandoverSource* source);
+    void release() { _owned = false; } //путь перешел к преемнику: при закрытии не удалять
+    void onReadable();
+
+private:
+    int _fd;
+    std::string _path;
+    bool _owned;
+    Reactor* _reactor;
+    HandoverSource* _source;
+    HandoverEndpoint(const HandoverEndpoint&);
+    HandoverEndpoint& operator=(const HandoverEndpoint&);
+};
+
+//SCM_RIGHTS передает не больше 253 дескрипторов за сообщение: данные и дескрипторы идут пачками
+bool sendState(int sock, const StateWriter& state);
+bool waitAck(int sock); //преемник принял состояние и запустился
+//новый процесс: подключиться к старому и забрать состояние; возвращает сокет для подтверждения, -1 - ошибка
+int requestState(const std::string& path, std::vector<char>& data, std::vector<int>& fds);
+bool sendAck(int sock);
+
+#endif // HANDOVER_H
@@ -0,0 +1,51 @@
+#include "histogram.h"
+#include <string.h>
+
+void Histogram::reset()
+{
+    memset(_counts, 0, sizeof(_counts));
+    _total = 0;
+    _sum = 0;
+    _max = 0;
+}
+
+void Histogram::merge(const Histogram& other)
+{
+    for(int i=0; i<bucketCount; i++)
+    {
+        _counts[i] += other._counts[i];
+    }
+    _total += other._total;
+    _sum += other._sum;
+    if(other._max > _max)
+        _max = other._max;
+}
+
+uint64_t Histogram::bucketUpper(int bucket)
+{
+    if(bucket < subCount)
+        return bucket;
+    int shift = bucket / subCount - 1;
+    uint64_t top = bucket % subCount + subCount;
+    return ((top + 1) << shift) - 1;
+}
+
+uint64_t Histogram::percentile(double p) const
+{
+    if(_total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * _total + 0.5);
+    if(rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for(int i=0; i<bucketCount; i++)
+    {
+        seen += _counts[i];
+        if(seen >= rank)
+        {
+            uint64_t upper = bucketUpper(i);
+            return upper < _max ? upper : _max;
+        }
+    }
+    return _max;
+}
@@ -0,0 +1,48 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+#include <stdint.h>
+
+//гистограмма задержек в стиле HDR: 32 линейных корзины на каждую степень двойки (точность ~3%)
+class Histogram
+{
+public:
+    static const int subBits = 5;
+    static const int subCount = 1 << subBits;
+    static const int bucketCount = (64 - subBits + 1) * subCount;
+
+    Histogram() { reset(); }
+    void reset();
+    void record(uint64_t value)
+    {
+        _counts[bucketOf(value)]++;
+        _total++;
+        _sum += value;
+        if(value > _max)
+            _max = value;
+    }
+    void merge(const Histogram& other);
+    uint64_t count() const { return _total; }
+    uint64_t max() const { return _max; }
+    uint64_t sum() const { return _sum; }
+    double mean() const { return _total ? (double)_sum / _total : 0; }
+    uint64_t percentile(double p) const; //p от 0 до 100
+    uint64_t bucketCountAt(int bucket) const { return _counts[bucket]; }
+    static uint64_t bucketUpper(int bucket); //верхняя граница корзины
+
+    static int bucketOf(uint64_t value)
+    {
+        if(value < (uint64_t)subCount)
+            return (int)value;
+        int e = 63 - __builtin_clzll(value);
+        int top = (int)(value >> (e - subBits)); //старшие subBits+1 бит, от subCount до 2*subCount-1
+        return (e - subBits) * subCount + top;
+    }
+
+private:
+    uint64_t _counts[bucketCount];
+    uint64_t _total;
+    uint64_t _sum;
+    uint64_t _max;
+};
+
+#endif // HISTOGRAM_H
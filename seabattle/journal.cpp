@@ -0,0 +1,327 @@
+#include "journal.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+//заголовок сегмента: magic (4 байта), номер сегмента (4), зафиксированная длина (8)
+static const int committedOffset = 8;
+
+static void putFixed(uint8_t* p, uint64_t v, int n)
+{
+    for(int i=0; i<n; i++)
+        p[i] = v >> (8*i);
+}
+
+static uint64_t getFixed(const uint8_t* p, int n)
+{
+    uint64_t v = 0;
+    for(int i=0; i<n; i++)
+        v |= (uint64_t)p[i] << (8*i);
+    return v;
+}
+
+std::string Journal::segmentName(const std::string& dir, int index)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/journal-%06d.sbj", index);
+    return dir + name;
+}
+
+Journal::Journal()
+{
+    _fd = -1;
+    _index = 0;
+    _base = 0;
+    _used = _committed = _total = 0;
+}
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::open(const std::string& dir)
+{
+    close();
+    _dir = dir;
+    mkdir(dir.c_str(), 0755);
+    int index = 1;
+    while(access(segmentName(dir, index).c_str(), F_OK) == 0)
+        index++; //старые сегменты не трогаем, пишем в новый
+    return openSegment(index);
+}
+
+void Journal::close()
+{
+    if(!_base)
+        return;
+    closeSegment(true);
+}
+
+bool Journal::openSegment(int index)
+{
+    if(_base)
+        closeSegment(false); //смена сегмента идет посреди хода: цикл диска не ждет
+    std::string name = segmentName(_dir, index);
+    _fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if(_fd < 0)
+    {
+        perror("journal: open");
+        return false;
+    }
+    if(ftruncate(_fd, segmentSize) < 0)
+    {
+        perror("journal: ftruncate");
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+    void* base = mmap(0, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if(base == MAP_FAILED)
+    {
+        perror("journal: mmap");
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+    _base = (uint8_t*)base;
+    _index = index;
+    putFixed(_base, magic, 4);
+    putFixed(_base + 4, index, 4);
+    _used = _committed = headerSize;
+    commit();
+    return true;
+}
+
+void Journal::closeSegment(bool sync)
+{
+    commit();
+    //MS_ASYNC только ставит страницы в очередь на запись; ждем диска лишь при закрытии журнала
+    msync(_base, _used, sync ? MS_SYNC : MS_ASYNC);
+    munmap(_base, segmentSize);
+    ::close(_fd);
+    _base = 0;
+    _fd = -1;
+}
+
+void Journal::commit()
+{
+    if(!_base || _used == _committed)
+        return;
+    _total += _used - _committed;
+    _committed = _used;
+    //читатель сначала видит длину, потом данные до нее: публикуем с release
+    __atomic_store_n((uint64_t*)(_base + committedOffset), _committed, __ATOMIC_RELEASE);
+}
+
+void Journal::match(int id, uint64_t seed)
+{
+    uint8_t* p = reserve(24);
+    if(!p)
+        return;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    *p++ = recMatch;
+    p = putVarint(p, id);
+    putFixed(p, seed, 8);
+    putFixed(p + 8, (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000, 8);
+    _used = p + 16 - _base;
+}
+
+void Journal::arrange(int id, int side, Bits ships)
+{
+    uint8_t* p = reserve(20);
+    if(!p)
+        return;
+    *p++ = recArrange | (side << 4);
+    p = putVarint(p, id);
+    putFixed(p, bits::low(ships), 8);
+    putFixed(p + 8, bits::high(ships), 5);
+    _used = p + 13 - _base;
+}
+
+void Journal::start(int id, int turn, int aiSide)
+{
+    uint8_t* p = reserve(8);
+    if(!p)
+        return;
+    *p++ = recStart | ((turn | (aiSide + 1) << 1) << 4);
+    p = putVarint(p, id);
+    _used = p - _base;
+}
+
+void Journal::end(int id, int winner, bool forfeit)
+{
+    uint8_t* p = reserve(8);
+    if(!p)
+        return;
+    *p++ = recEnd | (((winner + 1) | (forfeit ? 4 : 0)) << 4);
+    p = putVarint(p, id);
+    _used = p - _base;
+}
+
+JournalReader::JournalReader()
+{
+    _dirIndex = 0;
+    _index = 0;
+    _base = 0;
+    _size = _end = _pos = 0;
+    _corrupt = false;
+}
+
+JournalReader::~JournalReader()
+{
+    closeSegment();
+}
+
+bool JournalReader::open(const std::string& dir)
+{
+    closeSegment();
+    _dirs.clear();
+    _dirs.push_back(dir);
+    for(int worker=0; ; worker++)
+    {
+        std::string sub = dir + "/worker-" + std::to_string(worker);
+        if(access(Journal::segmentName(sub, 1).c_str(), F_OK) != 0)
+            break;
+        _dirs.push_back(sub);
+    }
+    _corrupt = false;
+    for(_dirIndex=0; _dirIndex<(int)_dirs.size(); _dirIndex++)
+    {
+        if(openSegment(1))
+            return true;
+    }
+    return false;
+}
+
+bool JournalReader::open(const std::string& dir, int segment, uint64_t offset)
+{
+    closeSegment();
+    _dirs.clear();
+    _dirs.push_back(dir);
+    _dirIndex = 0;
+    _corrupt = false;
+    if(!openSegment(segment))
+        return false;
+    if(offset > _pos)
+        _pos = offset < _end ? offset : _end;
+    return true;
+}
+
+bool JournalReader::openSegment(int index)
+{
+    closeSegment();
+    int fd = ::open(Journal::segmentName(_dirs[_dirIndex], index).c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size < Journal::headerSize)
+    {
+        ::close(fd);
+        return false;
+    }
+    void* base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(base == MAP_FAILED)
+        return false;
+    _base = (const uint8_t*)base;
+    _size = st.st_size;
+    _index = index;
+    if(getFixed(_base, 4) != Journal::magic)
+    {
+        _corrupt = true;
+        closeSegment();
+        return false;
+    }
+    _end = __atomic_load_n((const uint64_t*)(_base + committedOffset), __ATOMIC_ACQUIRE);
+    if(_end > _size)
+        _end = _size;
+    _pos = Journal::headerSize;
+    return true;
+}
+
+void JournalReader::closeSegment()
+{
+    if(_base)
+        munmap((void*)_base, _size);
+    _base = 0;
+}
+
+bool JournalReader::next(JournalEntry& entry)
+{
+    while(_base && _pos >= _end)
+    {
+        if(openSegment(_index + 1))
+            continue;
+        //следующий поток
+        bool opened = false;
+        while(!opened && ++_dirIndex < (int)_dirs.size())
+            opened = openSegment(1);
+        if(!opened)
+            return false;
+    }
+    if(!_base)
+        return false;
+    const uint8_t* p = _base + _pos;
+    const uint8_t* end = _base + _end;
+    memset(&entry, 0, sizeof(entry));
+    int head = *p++;
+    entry.type = head & 15;
+    int param = head >> 4;
+    uint32_t id = 0;
+    for(int shift=0; p < end; shift+=7)
+    {
+        uint8_t b = *p++;
+        id |= (uint32_t)(b & 0x7f) << shift;
+        if(!(b & 0x80))
+            break;
+    }
+    entry.match = id;
+    int need = 0;
+    switch(entry.type)
+    {
+    case recMatch: need = 16; break;
+    case recArrange: need = 13; break;
+    case recShot: need = 1; break;
+    case recStart: case recEnd: break;
+    default:
+        _corrupt = true;
+        return false;
+    }
+    if(p + need > end)
+    {
+        _corrupt = true;
+        return false;
+    }
+    switch(entry.type)
+    {
+    case recMatch:
+        entry.seed = getFixed(p, 8);
+        entry.time = getFixed(p + 8, 8);
+        break;
+    case recArrange:
+        entry.side = param & 1;
+        entry.ships = bits::make(getFixed(p, 8), getFixed(p + 8, 5));
+        break;
+    case recStart:
+        entry.turn = param & 1;
+        entry.aiSide = (param >> 1) - 1;
+        break;
+    case recShot:
+        entry.kind = param & 3;
+        entry.side = (param >> 2) & 1;
+        entry.cell = *p;
+        break;
+    case recEnd:
+        entry.winner = (param & 3) - 1;
+        entry.forfeit = param >> 2;
+        break;
+    }
+    _pos = p + need - _base;
+    return true;
+}
@@ -0,0 +1,127 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "bitboard.h"
+
+//журнал партий: записи дописываются в отображенный в память файл-сегмент.
+//Запись - это memcpy без системных вызовов; commit раз за проход цикла публикует длину записанного
+//в заголовке сегмента (групповая фиксация), на диск страницы сбрасывает ядро, fsync только при закрытии.
+//Формат записи: байт типа (младшие 4 бита - тип, старшие - параметр), номер партии в varint, данные
+enum JournalRecord { recMatch = 1, //новая партия: зерно (8 байт), время создания в мс (8 байт)
+                     recArrange, //расстановка: параметр - сторона, корабли (13 байт, 100 бит)
+                     recStart, //начало: параметр - чей первый ход и (место компьютера + 1) << 1
+                     recShot, //выстрел: параметр - ShotKind | сторона << 2, клетка (1 байт)
+                     recEnd //конец: параметр - победитель + 1 (0 - партия прервана) | 4, если партия отдана: вышло время хода или соперник отключился
+                   };
+
+//разобранная запись
+struct JournalEntry
+{
+    int type;
+    int match;
+    int side;
+    int cell;
+    int kind; //ShotKind
+    int turn;
+    int aiSide;
+    int winner;
+    bool forfeit; //партия отдана: закончена не по правилам Game
+    uint64_t seed;
+    uint64_t time;
+    Bits ships;
+};
+
+class Journal
+{
+public:
+    Journal();
+    ~Journal();
+    bool open(const std::string& dir); //новый сегмент после уже лежащих в каталоге
+    void close();
+    bool isOpen() const { return _base != 0; }
+    void match(int id, uint64_t seed);
+    void arrange(int id, int side, Bits ships);
+    void start(int id, int turn, int aiSide);
+    void shot(int id, int side, int cell, int kind)
+    {
+        uint8_t* p = reserve(8);
+        if(!p)
+            return;
+        *p++ = recShot | (kind << 4) | (side << 6);
+        p = putVarint(p, id);
+        *p++ = cell;
+        _used = p - _base;
+    }
+    void end(int id, int winner, bool forfeit = false);
+    void commit(); //опубликовать записанное, вызывается раз за проход цикла
+    uint64_t bytes() const { return _total; } //записано за все сегменты
+    const std::string& dir() const { return _dir; }
+    int segment() const { return _index; } //место следующей записи: сегмент и смещение в нем
+    uint64_t offset() const { return _used; }
+
+    static const uint32_t magic = 0x314a4253; //"SBJ1"
+    static const int headerSize = 64;
+    static const uint64_t segmentSize = 16*1024*1024;
+    static std::string segmentName(const std::string& dir, int index);
+
+private:
+    std::string _dir;
+    int _fd;
+    int _index; //номер текущего сегмента
+    uint8_t* _base;
+    uint64_t _used; //записано в текущий сегмент, вместе с заголовком
+    uint64_t _committed;
+    uint64_t _total;
+    Journal(const Journal&);
+    Journal& operator=(const Journal&);
+    bool openSegment(int index);
+    void closeSegment(bool sync); //sync - дождаться записи на диск
+    uint8_t* reserve(int n) //место под запись, при нехватке - следующий сегмент
+    {
+        if(!_base)
+            return 0;
+        if(_used + n > segmentSize && !openSegment(_index + 1))
+            return 0;
+        return _base + _used;
+    }
+    static uint8_t* putVarint(uint8_t* p, uint32_t v)
+    {
+        while(v >= 0x80)
+        {
+            *p++ = v | 0x80;
+            v >>= 7;
+        }
+        *p++ = v;
+        return p;
+    }
+};
+
+//чтение журнала по сегментам; видны только зафиксированные записи.
+//Журнал сервера с несколькими потоками - подкаталоги worker-N, они читаются по очереди:
+//каждая партия целиком лежит в журнале своего потока
+class JournalReader
+{
+public:
+    JournalReader();
+    ~JournalReader();
+    bool open(const std::string& dir);
+    bool open(const std::string& dir, int segment, uint64_t offset); //хвост журнала одного потока с этого места
+    bool next(JournalEntry& entry); //false - записи кончились
+    bool corrupt() const { return _corrupt; } //встретилась неполная или неизвестная запись
+
+private:
+    std::vector<std::string> _dirs;
+    int _dirIndex; //какой из _dirs читаем
+    int _index;
+    const uint8_t* _base;
+    uint64_t _size; //размер отображения
+    uint64_t _end; //зафиксированная длина
+    uint64_t _pos;
+    bool _corrupt;
+    bool openSegment(int index);
+    void closeSegment();
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,84 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QDebug>
+#include <stdio.h>
+#include <chrono>
+#include "bot.h"
+
+//нагрузочный тест сервера: N ботов играют друг с другом
+static LoadStats stats;
+static std::chrono::steady_clock::time_point started;
+
+static void printLine(const char* name, const Histogram& h)
+{
+    printf("%-16s %10llu %10.1f %10.1f %10.1f %10.1f\n", name, (unsigned long long)h.count(),
+           h.percentile(50)/1000.0, h.percentile(99)/1000.0, h.percentile(99.9)/1000.0, h.max()/1000.0);
+}
+
+static void report()
+{
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    printf("elapsed %.1f s, moves/s %.0f, matches/s %.1f, errors %llu\n", sec, stats.moves/sec,
+           stats.matches/sec, (unsigned long long)stats.errors);
+    printf("%-16s %10s %10s %10s %10s %10s\n", "message", "count", "p50 us", "p99 us", "p999 us", "max us");
+    printLine("comArrange", stats.arrange);
+    printLine("comDot", stats.dot);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("seaBattle-loadgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sea Battle load generator");
+    parser.addHelpOption();
+    QCommandLineOption hostOption("host", "Server address.", "ip", "127.0.0.1");
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Server port.", "port", "3634");
+    QCommandLineOption connOption(QStringList() << "c" << "connections", "Number of concurrent bots.", "n", "100");
+    QCommandLineOption paceOption("pace", "Delay before each shot, ms.", "ms", "0");
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Test duration, s.", "s", "10");
+    QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+    QCommandLineOption aiOption("ai", "Play against the server AI instead of other bots.");
+    QCommandLineOption bucketsOption("buckets", "Spread bots over this many matchmaking buckets.", "n", "1");
+    parser.addOption(hostOption);
+    parser.addOption(portOption);
+    parser.addOption(connOption);
+    parser.addOption(paceOption);
+    parser.addOption(durationOption);
+    parser.addOption(seedOption);
+    parser.addOption(aiOption);
+    parser.addOption(bucketsOption);
+    parser.process(a);
+
+    int connections = parser.value(connOption).toInt();
+    int pace = parser.value(paceOption).toInt();
+    int duration = parser.value(durationOption).toInt();
+    unsigned seed = parser.value(seedOption).toUInt();
+    int buckets = parser.value(bucketsOption).toInt();
+    if(connections <= 0 || duration <= 0 || pace < 0 || buckets <= 0)
+    {
+        qCritical() << "invalid arguments";
+        return 1;
+    }
+
+    started = std::chrono::steady_clock::now();
+    for(int i=0; i<connections; i++)
+    {
+        Bot* bot = new Bot(seed + i, &stats, pace, &a);
+        bot->setVsAi(parser.isSet(aiOption));
+        bot->setBucket(i % buckets);
+        bot->start(parser.value(hostOption), parser.value(portOption).toInt());
+    }
+
+    QTimer progress;
+    QObject::connect(&progress, &QTimer::timeout, report);
+    progress.start(1000);
+    QTimer::singleShot(duration*1000, &a, SLOT(quit()));
+    int r = a.exec();
+    printf("--- total ---\n");
+    report();
+    return r;
+}
@@ -0,0 +1,76 @@
+#include "mailbox.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+Mailbox::Mailbox()
+{
+    _head.store(0, std::memory_order_relaxed);
+    _fd = -1;
+    _handler = 0;
+}
+
+Mailbox::~Mailbox()
+{
+    Mail* mail = _head.exchange(0, std::memory_order_acquire);
+    while(mail)
+    {
+        Mail* next = mail->next;
+        delete mail; //неразобранные при остановке
+        mail = next;
+    }
+    if(_fd != -1)
+        close(_fd);
+}
+
+bool Mailbox::open(Reactor* reactor, MailHandler* handler)
+{
+    _handler = handler;
+    _fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_fd == -1)
+    {
+        perror("eventfd");
+        return false;
+    }
+    return reactor->add(_fd, this, EPOLLIN | EPOLLET);
+}
+
+void Mailbox::post(Mail* mail)
+{
+    Mail* head = _head.load(std::memory_order_relaxed);
+    do {
+        mail->next = head;
+    } while(!_head.compare_exchange_weak(head, mail, std::memory_order_release, std::memory_order_relaxed));
+    if(head)
+        return; //ящик не пуст: получатель уже разбужен и заберет и это сообщение
+    uint64_t one = 1;
+    while(write(_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+        ;
+}
+
+void Mailbox::onReadable()
+{
+    uint64_t count;
+    while(read(_fd, &count, sizeof(count)) > 0)
+        ;
+    //забираем весь стек; пока разбираем, новые сообщения снова будят через eventfd
+    Mail* mail;
+    while((mail = _head.exchange(0, std::memory_order_acquire)) != 0)
+    {
+        Mail* ordered = 0;
+        while(mail)
+        {
+            Mail* next = mail->next;
+            mail->next = ordered; //стек в порядок отправки
+            ordered = mail;
+            mail = next;
+        }
+        while(ordered)
+        {
+            Mail* next = ordered->next;
+            _handler->onMail(ordered);
+            ordered = next;
+        }
+    }
+}
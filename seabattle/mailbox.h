@@ -0,0 +1,43 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+#include <atomic>
+#include "reactor.h"
+
+//сообщение другому рабочему потоку; получатель удаляет его после разбора
+struct Mail
+{
+    explicit Mail(int type) : next(0), type(type) {}
+    virtual ~Mail() {}
+    Mail* next;
+    int type;
+};
+
+//кому разбирать пришедшие сообщения
+class MailHandler
+{
+public:
+    virtual ~MailHandler() {}
+    virtual void onMail(Mail* mail) = 0; //вызывается в потоке получателя
+};
+
+//почтовый ящик рабочего потока: писать может любой поток без блокировок (стек Трайбера),
+//получатель забирает все сообщения разом. eventfd в реакторе получателя будит его, только
+//когда ящик был пуст: пока сообщения не разобраны, следующие отправители системных вызовов не делают
+class Mailbox: public IoHandler
+{
+public:
+    Mailbox();
+    ~Mailbox();
+    bool open(Reactor* reactor, MailHandler* handler);
+    void post(Mail* mail); //из любого потока
+    void onReadable(); //разобрать все сообщения в порядке отправки
+
+private:
+    std::atomic<Mail*> _head;
+    int _fd; //eventfd, -1 - не открыт
+    MailHandler* _handler;
+    Mailbox(const Mailbox&);
+    Mailbox& operator=(const Mailbox&);
+};
+
+#endif // MAILBOX_H
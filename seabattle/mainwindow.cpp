@@ -1,7 +1,11 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "fleet.h"
 #include <QDebug>
+#include <QTimer>
 MainWindow *_mainWindow;
+static const int resumeTries = 10; //сервер, упавший посреди партии, поднимается за секунды
+static const int resumeDelayMs = 1000;
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
@@ -9,9 +13,20 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->setupUi(this);
     _mainWindow = this;
     isReady = false;
-    isMyMove = false;
+    _resumeTries = 0;
+    strcpy(_host, "127.0.0.1");
     _serv = new Server();
     _client = new Client(this);
+    connect(_client,SIGNAL(connectProgress(QString)),this,SLOT(onConnectProgress(QString)));
+    connect(_client,SIGNAL(connected()),this,SLOT(onConnected()));
+    connect(_client,SIGNAL(connectFailed(QString)),this,SLOT(onConnectFailed(QString)));
+    connect(_client,SIGNAL(gameStarted(bool)),this,SLOT(onGameStarted(bool)));
+    connect(_client,SIGNAL(missed(int,bool)),this,SLOT(onMissed(int,bool)));
+    connect(_client,SIGNAL(damaged(int,bool)),this,SLOT(onDamaged(int,bool)));
+    connect(_client,SIGNAL(killed(QVector<int>,bool)),this,SLOT(onKilled(QVector<int>,bool)));
+    connect(_client,SIGNAL(statusChanged(QString)),this,SLOT(setStatus(QString)));
+    connect(_client,SIGNAL(arrangeRejected(int)),this,SLOT(onArrangeRejected(int)));
+    connect(_client,SIGNAL(resumed(bool)),this,SLOT(onResumed(bool)));
     MyPoint::initPix();
     ui->placingBackVIew->setHorizontalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
     ui->placingBackVIew->setVerticalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
@@ -114,75 +129,25 @@ void MainWindow::game()
         itemField2[i]->setZValue(1);
     }
 }
-void MainWindow::setAroundShip(int xCell,int yCell,QVector<int>& aroundShip)
-{
-    if(yCell<=9 && yCell>=0 && xCell<=9 && xCell>=0)
-        aroundShip[xCell+yCell*10]= 1;
-}
-
 bool MainWindow::checkShipsPlace(int numShip,int xCell, int yCell, QVector<int>& aroundShip)
 {
-        //проверка на правильность расстановки кораблей
-        if ((xCell >= 0 && xCell <= 9) && (yCell >= 0 && yCell <= 9))
-        {
-            int typeShip = ships[numShip]->_typeShip;
-            bool vert = ships[numShip]->isVertical;
-            if(vert)
-            {
-                //вертикально клетки над кораблем
-                setAroundShip(xCell-1,yCell-1,aroundShip); //сверху справа
-                setAroundShip(xCell+1,yCell-1,aroundShip); //сверху слева
-                setAroundShip(xCell,yCell-1,aroundShip); //сверху по центру
-                //вертикально клетки под кораблем
-                setAroundShip(xCell-1, yCell+typeShip, aroundShip); //аналогично снизу
-                setAroundShip(xCell+1, yCell+typeShip, aroundShip);
-                setAroundShip(xCell, yCell+typeShip, aroundShip);
-            } else {
-                //горизонтально слева
-                setAroundShip(xCell-1,yCell-1,aroundShip); //сверху слева
-                setAroundShip(xCell-1,yCell+1,aroundShip); //снизу слева
-                setAroundShip(xCell-1,yCell,aroundShip); //слева от корабля
-                //горизонтально справа
-                setAroundShip(xCell+typeShip, yCell-1, aroundShip); //аналогично справа
-                setAroundShip(xCell+typeShip, yCell+1, aroundShip);
-                setAroundShip(xCell+typeShip, yCell, aroundShip);
-            }
-            for(int j = 0;j<typeShip;j++)
-            {
-                if(vert) //корабль вертикально
-                {
+    //проверка на правильность расстановки кораблей
+    return placeShip(ships[numShip]->_typeShip, ships[numShip]->isVertical, xCell, yCell,
+                     aroundShip.data(), field.data());
+}
 
-                    if(aroundShip[xCell+(yCell+j)*10]==0)
-                    {
-                        setAroundShip(xCell-1,yCell+j,aroundShip); //слева
-                        setAroundShip(xCell+1,yCell+j,aroundShip); //справа
-                        setAroundShip(xCell,yCell+j,aroundShip); //центр
-                        field[xCell+(yCell+j)*10]= MyPoint::CL_SHIP; //палуба
-                    } else {
-                        return false;
-                    }
-                } else { //горизонтально
 
-                    if(aroundShip[(xCell+j)+yCell*10]==0)
-                    {
-                        setAroundShip(xCell+j,yCell,aroundShip); //центр
-                        setAroundShip(xCell+j,yCell-1,aroundShip); //сверху
-                        setAroundShip(xCell+j,yCell+1,aroundShip); //снизу
-                        field[(xCell+j)+yCell*10]= MyPoint::CL_SHIP;
-                    }
-                    else {
-                        return false;
-                    }
-                }
-            }
-        }
-        else
-            return false;
-        return true;
+ void MainWindow::on_startButton_clicked()
+{
+    sendShips(false);
 }
 
+void MainWindow::on_aiButton_clicked()
+{
+    sendShips(true); //соперник - компьютер на сервере
+}
 
- void MainWindow::on_startButton_clicked()
+void MainWindow::sendShips(bool vsAi)
 {
     if(isReady)
         return;
@@ -215,34 +180,70 @@ bool MainWindow::checkShipsPlace(int numShip,int xCell, int yCell, QVector<int>&
             }
             qDebug() << s;
         }
-    _client->sendArrange(field);
+    _client->sendArrange(field, vsAi);
 
 }
 
 void MainWindow::on_New_game_clicked()
 {
     char hostinfo[16]="127.0.0.1";
+    strcpy(_host, hostinfo);
     _serv->doStartServer(3634);
-    if(_client->connectTo(hostinfo,3634))
-    {
-        placingShips();
-    }
+    ui->New_game->setEnabled(false);
+    ui->Connect->setEnabled(false);
+    _client->connectTo(hostinfo,3634); //окно расстановки откроется по сигналу connected
 }
 
 void MainWindow::on_Connect_clicked()
 {
     char hostinfo[16];
     QByteArray ba = ui->lineEdit->text().toLatin1();
-    strcpy(hostinfo,ba.data());
-    if(_client->connectTo(hostinfo,3634))
+    strncpy(hostinfo,ba.data(),sizeof(hostinfo)-1);
+    hostinfo[sizeof(hostinfo)-1] = 0;
+    strcpy(_host, hostinfo);
+    ui->New_game->setEnabled(false);
+    ui->Connect->setEnabled(false);
+    _client->connectTo(hostinfo,3634); //окно расстановки откроется по сигналу connected
+}
+
+void MainWindow::onConnectProgress(QString status) //ход подключения
+{
+    setStatus(status);
+    if(ui->stackedWidget->currentIndex() == 0)
+    {
+        ui->Connect->setText(status.toUpper());
+    }
+}
+
+void MainWindow::onConnected()
+{
+    ui->Connect->setText("CONNECT");
+    placingShips();
+}
+
+void MainWindow::onConnectFailed(QString error)
+{
+    if(ui->stackedWidget->currentIndex() == 2 && _resumeTries < resumeTries && _client->canResume())
     {
-        placingShips();
+        //первая попытка - сразу, следующие - раз в секунду: не вышло - снова сюда
+        QTimer::singleShot(_resumeTries++ ? resumeDelayMs : 0, this, SLOT(resumeMatch()));
+        return;
+    }
+    _resumeTries = 0;
+    ui->New_game->setEnabled(true);
+    ui->Connect->setEnabled(true);
+    ui->Connect->setText("CONNECT");
+    if(ui->stackedWidget->currentIndex() == 0)
+    {
+        QMessageBox::warning(this, "Sea Battle", "Cannot connect: " + error);
+    } else {
+        QMessageBox::warning(this, "Sea Battle", "Connection lost: " + error);
     }
 }
 
 void MainWindow::shoot(char cell) //выстрел
 {
-    if(cell!=-1 && isMyMove)
+    if(cell!=-1 && _client->isMyMove())
     {
         _client->sendDot(cell);
     }
@@ -256,6 +257,51 @@ void MainWindow::changeCellType2(char cell,int type)
 {
     itemField2[cell]->changeType(type);
 }
+void MainWindow::onGameStarted(bool myMove)
+{
+    Q_UNUSED(myMove);
+    game();
+}
+//свои выстрелы рисуем на поле соперника (changeCellType), чужие - на своем (changeCellType2)
+void MainWindow::onMissed(int cell, bool mine)
+{
+    if(mine)
+        changeCellType(cell,5);
+    else
+        changeCellType2(cell,5);
+}
+void MainWindow::onDamaged(int cell, bool mine)
+{
+    if(mine)
+        changeCellType(cell,6);
+    else
+        changeCellType2(cell,6);
+}
+void MainWindow::onKilled(QVector<int> cells, bool mine)
+{
+    for(int i=0; i<cells.size(); i++)
+    {
+        if(mine)
+            changeCellType(cells[i],7);
+        else
+            changeCellType2(cells[i],7);
+    }
+}
+void MainWindow::onResumed(bool myMove)
+{
+    Q_UNUSED(myMove);
+    _resumeTries = 0; //поля перерисованы сигналами выстрелов, статус - сигналом statusChanged
+}
+void MainWindow::resumeMatch()
+{
+    _client->resumeTo(_host, 3634);
+}
+void MainWindow::onArrangeRejected(int error)
+{
+    Q_UNUSED(error);
+    isReady = false; //можно переставить корабли и нажать START снова
+    QMessageBox::warning(this, "Sea Battle", "The server rejected the ship placement.");
+}
 void MainWindow::setStatus(QString str)
 {
     ui->lineEdit_2->setText(str);
@@ -32,14 +32,24 @@ public:
     void shoot(char cell);
     void changeCellType(char cell,int type);
     void changeCellType2(char cell,int type);
-    void setStatus(QString str);
-    bool isMyMove;
 public slots:
+    void setStatus(QString str);
 
 private slots:
     void on_startButton_clicked();
+    void on_aiButton_clicked();
     void on_New_game_clicked();
     void on_Connect_clicked();
+    void onConnectProgress(QString status);
+    void onConnected();
+    void onConnectFailed(QString error);
+    void onGameStarted(bool myMove);
+    void onMissed(int cell, bool mine);
+    void onDamaged(int cell, bool mine);
+    void onKilled(QVector<int> cells, bool mine);
+    void onArrangeRejected(int error);
+    void onResumed(bool myMove);
+    void resumeMatch();
 private:
     Ui::MainWindow *ui;
     QGraphicsScene  *scene;
@@ -51,8 +61,10 @@ private:
     Client* _client;
     Server* _serv;
     bool isReady;
+    char _host[16]; //адрес сервера для возврата в партию после обрыва
+    int _resumeTries; //попыток вернуться в партию после обрыва
     bool checkShipsPlace(int numShip, int xCell, int yCell, QVector<int>& aroundShip);
-    void setAroundShip(int xCell, int yCell, QVector<int>& aroundShip);
+    void sendShips(bool vsAi); //проверить расстановку и отправить ее серверу
 };
 
 
@@ -0,0 +1,332 @@
+#include "match.h"
+#include "servclient.h"
+#include "metrics.h"
+
+Match::Match()
+{
+    ai = 0;
+    reset(0, 0);
+}
+
+void Match::reset(int id, uint64_t seed)
+{
+    this->id = id;
+    this->seed = seed;
+    rng.setSeed(seed);
+    clear();
+    for(int i=0; i<2; i++)
+    {
+        players[i] = 0;
+        ready[i] = false;
+        secrets[i] = 0;
+        away[i] = false;
+    }
+    started = false;
+    delete ai;
+    ai = 0;
+    aiSide = -1;
+    aiView.clear();
+    traced = false;
+}
+
+Match::~Match()
+{
+    delete ai;
+}
+
+int Match::side(ServClient* client) const
+{
+    return (players[1] == client)?1:0;
+}
+
+ServClient* Match::enemyOf(ServClient* client) const
+{
+    return players[1-side(client)];
+}
+
+bool Match::isFull() const
+{
+    return (players[0] || aiSide == 0) && (players[1] || aiSide == 1);
+}
+
+static void putTimer(StateWriter& out, const TimerWheel& timers, const Timer& timer)
+{
+    out.put32((uint32_t)timers.remaining(&timer)); //-1 - не взведен
+}
+
+void Match::save(StateWriter& out, const TimerWheel& timers) const
+{
+    out.put32(id);
+    out.put64(seed);
+    uint64_t state[4];
+    rng.state(state);
+    out.putBytes(state, sizeof(state));
+    out.put8(started | traced << 1);
+    out.put8(turn);
+    out.put8(kills[0]);
+    out.put8(kills[1]);
+    for(int i=0; i<2; i++)
+    {
+        out.putBits(boards[i].ships);
+        out.putBits(boards[i].hits);
+        out.putBits(boards[i].misses);
+    }
+    for(int i=0; i<2; i++)
+    {
+        out.put32(players[i] ? players[i]->poolIndex : ~0u);
+        out.put8(ready[i] | away[i] << 1);
+        out.put64(secrets[i]);
+        putTimer(out, timers, graceTimers[i]);
+    }
+    putTimer(out, timers, turnTimer);
+    out.put8(aiSide + 1);
+    if(ai)
+    {
+        ai->rng().state(state);
+        out.putBytes(state, sizeof(state));
+        out.putBits(aiView.misses);
+        out.putBits(aiView.hits);
+        out.putBits(aiView.sunk);
+        for(int i=0; i<5; i++)
+            out.put8(aiView.remaining[i]);
+    }
+}
+
+bool Match::load(StateReader& in, uint32_t playerSlots[2], int timers[3])
+{
+    int savedId = in.get32();
+    uint64_t savedSeed = in.get64();
+    reset(savedId, savedSeed);
+    uint64_t state[4];
+    in.getBytes(state, sizeof(state));
+    rng.setState(state);
+    int flags = in.get8();
+    started = flags & 1;
+    traced = flags & 2;
+    turn = in.get8() & 1;
+    kills[0] = in.get8();
+    kills[1] = in.get8();
+    for(int i=0; i<2; i++)
+    {
+        boards[i].ships = in.getBits();
+        boards[i].hits = in.getBits();
+        boards[i].misses = in.getBits();
+    }
+    for(int i=0; i<2; i++)
+    {
+        playerSlots[i] = in.get32();
+        flags = in.get8();
+        ready[i] = flags & 1;
+        away[i] = flags & 2;
+        secrets[i] = in.get64();
+        timers[1 + i] = (int)in.get32();
+    }
+    timers[0] = (int)in.get32();
+    aiSide = in.get8() - 1;
+    if(aiSide > 1)
+        return false;
+    if(aiSide >= 0)
+    {
+        ai = new AiPlayer();
+        in.getBytes(state, sizeof(state));
+        ai->rng().setState(state);
+        aiView.misses = in.getBits();
+        aiView.hits = in.getBits();
+        aiView.sunk = in.getBits();
+        for(int i=0; i<5; i++)
+            aiView.remaining[i] = in.get8();
+    }
+    return in.ok();
+}
+
+MatchRegistry::MatchRegistry()
+{
+    _nextId = 1;
+    _idStep = 1;
+    _limit = 0;
+    _away = 0;
+    _journal = 0;
+}
+
+Match* MatchRegistry::create()
+{
+    Match* match = _pool.acquire();
+    if(!match)
+    {
+        return 0;
+    }
+    match->reset(_nextId, _seeds());
+    _nextId += _idStep;
+    Metrics::add(ctrMatchesOpened);
+    if(_journal)
+        _journal->match(match->id, match->seed);
+    return match;
+}
+
+MatchRegistry::~MatchRegistry()
+{
+}
+
+void MatchRegistry::save(StateWriter& out) const
+{
+    out.put32(_nextId);
+    uint64_t state[4];
+    _seeds.state(state);
+    out.putBytes(state, sizeof(state));
+}
+
+bool MatchRegistry::load(StateReader& in)
+{
+    _nextId = in.get32(); //шаг тот же: число потоков переходит вместе с состоянием
+    uint64_t state[4];
+    in.getBytes(state, sizeof(state));
+    _seeds.setState(state);
+    return in.ok();
+}
+
+Match* MatchRegistry::restore(PoolHandle handle)
+{
+    Match* match = _pool.restore(handle);
+    if(match)
+        Metrics::add(ctrMatchesOpened); //закроется уже здесь
+    return match;
+}
+
+void MatchRegistry::skipTo(int id)
+{
+    while(_nextId <= id)
+    {
+        _nextId += _idStep;
+        _seeds(); //зерна идут в ногу с номерами
+    }
+}
+
+void MatchRegistry::restored()
+{
+    _pool.rebuild();
+    _away = 0;
+    _pool.forEach([&](Match* match) { _away += match->away[0] + match->away[1]; });
+}
+
+bool MatchRegistry::isFull() const
+{
+    return _limit > 0 && _pool.size() >= _limit;
+}
+
+Match* MatchRegistry::find(int id) const
+{
+    Match* found = 0;
+    _pool.forEach([&](Match* match) { if(match->id == id) found = match; });
+    return found;
+}
+
+QList<Match*> MatchRegistry::all() const
+{
+    QList<Match*> matches;
+    _pool.forEach([&](Match* match) { matches.append(match); });
+    return matches;
+}
+
+Match* MatchRegistry::pair(ServClient* first, ServClient* second)
+{
+    if(isFull())
+    {
+        return 0;
+    }
+    Match* match = create();
+    if(!match)
+    {
+        return 0;
+    }
+    ServClient* players[2] = { first, second };
+    for(int i=0; i<2; i++)
+    {
+        match->players[i] = players[i];
+        players[i]->setMatch(match, i);
+        match->boards[i].setField(players[i]->fleet()); //расстановки проверены до очереди
+        match->ready[i] = true;
+        if(_journal)
+            _journal->arrange(match->id, i, match->boards[i].ships);
+    }
+    return match;
+}
+
+Match* MatchRegistry::attachAi(ServClient* client)
+{
+    if(isFull())
+    {
+        return 0;
+    }
+    Match* match = create();
+    if(!match)
+    {
+        return 0;
+    }
+    match->players[0] = client;
+    client->setMatch(match, 0);
+    match->boards[0].setField(client->fleet());
+    match->ready[0] = true;
+    if(_journal)
+        _journal->arrange(match->id, 0, match->boards[0].ships);
+    match->aiSide = 1;
+    match->ai = new AiPlayer(match->rng()); //генератор компьютера тоже выводится из зерна партии
+    match->boards[1].ships = match->ai->arrange();
+    match->ready[1] = true; //компьютер расставляет корабли сразу
+    if(_journal)
+        _journal->arrange(match->id, 1, match->boards[1].ships);
+    return match;
+}
+
+void MatchRegistry::detach(ServClient* client)
+{
+    Match* match = client->match();
+    if(match)
+    {
+        finish(match); //партию создают уже с обоими игроками, без одного из них она продолжаться не может
+    }
+}
+
+void MatchRegistry::suspend(Match* match, int side)
+{
+    match->players[side]->setMatch(0, 0);
+    match->players[side] = 0;
+    match->away[side] = true;
+    _away++;
+}
+
+void MatchRegistry::resume(Match* match, int side, ServClient* client)
+{
+    match->away[side] = false;
+    match->graceTimers[side].cancel();
+    match->players[side] = client;
+    client->setMatch(match, side);
+    _away--;
+}
+
+void MatchRegistry::finish(Match* match, bool forfeit)
+{
+    if(_journal)
+        _journal->end(match->id, match->winner(), forfeit); //-1, если партия прервана
+    match->finished = true;
+    for(int i=0; i<2; i++)
+    {
+        if(match->players[i])
+        {
+            match->players[i]->setMatch(0, 0);
+        }
+    }
+    match->turnTimer.cancel();
+    for(int i=0; i<2; i++)
+    {
+        match->graceTimers[i].cancel();
+        if(match->away[i])
+        {
+            match->away[i] = false;
+            _away--; //соперник потопил все корабли или место не дождалось игрока
+        }
+    }
+    delete match->ai; //компьютер занимает память, пока ячейка ждет следующей партии
+    match->ai = 0;
+    Metrics::add(ctrMatchesClosed);
+    _pool.release(match);
+}
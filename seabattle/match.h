@@ -0,0 +1,88 @@
+#ifndef MATCH_H
+#define MATCH_H
+#include <QList>
+#include "game.h"
+#include "aiplayer.h"
+#include "journal.h"
+#include "timerwheel.h"
+#include "pool.h"
+#include "handover.h"
+class ServClient;
+
+//одна партия: два игрока и состояние их полей (правила - в Game). Живет в пуле реестра
+class Match: public Game, public PoolSlot
+{
+public:
+    Match();
+    ~Match();
+    void reset(int id, uint64_t seed); //новая партия в освободившейся ячейке
+    int id;
+    uint64_t seed; //зерно партии: по нему и ходам партия, включая решения компьютера, воспроизводится точно
+    Rng rng; //все случайные решения партии - только отсюда
+    ServClient* players[2];
+    bool ready[2]; //игрок прислал расстановку
+    bool started;
+    AiPlayer* ai; //компьютерный соперник, 0 - играют два человека
+    int aiSide; //место компьютера, -1 - нет
+    Knowledge aiView; //что компьютер знает о поле человека
+    bool traced; //писать трассу партии
+    Timer turnTimer; //время хода игрока turn
+    uint64_t secrets[2]; //секреты билетов возврата, выданы в comStartGame
+    bool away[2]; //соединение игрока оборвалось, место ждет его возврата
+    Timer graceTimers[2]; //сколько еще держать место ушедшего
+    int side(ServClient* client) const; //номер игрока в партии
+    ServClient* enemyOf(ServClient* client) const; //узнать о противнике
+    bool isFull() const;
+    //партия для нового процесса: игроки - номерами их ячеек в пуле соединений (~0 - нет), таймеры - оставшимися мс
+    void save(StateWriter& out, const TimerWheel& timers) const;
+    bool load(StateReader& in, uint32_t playerSlots[2], int timers[3]); //timers: ход, места 0 и 1; -1 - не взведен
+
+private:
+    Match(const Match&);
+    Match& operator=(const Match&);
+};
+
+//реестр партий: создает партии для найденных пар и освобождает завершенные
+class MatchRegistry
+{
+public:
+    MatchRegistry();
+    ~MatchRegistry();
+    Match* pair(ServClient* first, ServClient* second); //партия двух игроков из очереди подбора, 0 - мест нет
+    Match* attachAi(ServClient* client); //партия против компьютера с расстановкой клиента, 0 - мест нет
+    void detach(ServClient* client); //игрок отключился
+    void suspend(Match* match, int side); //соединение игрока оборвалось посреди партии, место ждет его
+    void resume(Match* match, int side, ServClient* client); //игрок вернулся на место с новым соединением
+    int awayCount() const { return _away; } //мест, ждущих своих игроков
+    void finish(Match* match, bool forfeit = false); //партия окончена, освобождаем ее; forfeit - победа по времени
+    int count() const { return _pool.size(); }
+    Match* find(int id) const; //0 - нет такой партии; перебор, только для управления трассой
+    QList<Match*> all() const;
+    PoolHandle handle(const Match* match) const { return _pool.handle(match); }
+    Match* get(PoolHandle handle) const { return _pool.get(handle); } //0 - партия уже окончена
+    //передача новому процессу: номера и зерна следующих партий; сами партии пишет и читает сервер
+    void save(StateWriter& out) const;
+    bool load(StateReader& in);
+    Match* restore(PoolHandle handle); //партия старого процесса в ту же ячейку, 0 - ячейка занята
+    void restored(); //все партии восстановлены
+    void skipTo(int id); //партии до id включительно уже создавал упавший процесс: номера и зерна не повторять
+    uint32_t slotCount() const { return _pool.capacity(); } //ячеек пула, для обхода по частям
+    Match* at(uint32_t slot) const { return _pool.live(slot); } //0 - ячейка свободна
+    void setLimit(int maxMatches) { _limit = maxMatches; _pool.setLimit(maxMatches); }
+    void setIds(int first, int step) { _nextId = first; _idStep = step; } //номера партий: first, first+step, ...
+    void setSeed(uint64_t seed) { _seeds.setSeed(seed); } //зерна новых партий берутся из этой последовательности
+    void setJournal(Journal* journal) { _journal = journal; } //куда записывать начало и конец партий
+    bool isFull() const; //новую партию создать нельзя
+
+private:
+    int _limit; //0 - без ограничения
+    int _away;
+    Pool<Match> _pool;
+    int _nextId;
+    int _idStep;
+    Rng _seeds;
+    Journal* _journal;
+    Match* create(); //новая партия со своим зерном, 0 - мест нет
+};
+
+#endif // MATCH_H
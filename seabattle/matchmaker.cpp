@@ -0,0 +1,175 @@
+#include "matchmaker.h"
+#include "metrics.h"
+
+TicketQueue::TicketQueue(int capacity)
+{
+    _cells = new Cell[capacity];
+    _mask = capacity - 1;
+    for(int i=0; i<capacity; i++)
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+}
+
+TicketQueue::~TicketQueue()
+{
+    delete[] _cells;
+}
+
+bool TicketQueue::push(const MatchTicket& ticket)
+{
+    uint64_t pos = _head.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        Cell& cell = _cells[pos & _mask];
+        uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+        if(diff == 0)
+        {
+            //ячейка свободна на этом круге: занимаем позицию, пока ее не занял другой писатель
+            if(_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                cell.ticket = ticket;
+                cell.sequence.store(pos + 1, std::memory_order_release); //читатель увидит билет целиком
+                return true;
+            }
+        }
+        else if(diff < 0)
+        {
+            return false; //читатели еще не освободили ячейку с прошлого круга
+        }
+        else
+        {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool TicketQueue::pop(MatchTicket& ticket)
+{
+    uint64_t pos = _tail.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        Cell& cell = _cells[pos & _mask];
+        uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+        if(diff == 0)
+        {
+            if(_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                ticket = cell.ticket;
+                cell.sequence.store(pos + _mask + 1, std::memory_order_release); //ячейка свободна для следующего круга
+                return true;
+            }
+        }
+        else if(diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = _tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+int TicketQueue::size() const
+{
+    int64_t n = (int64_t)(_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_relaxed));
+    return n > 0 ? (int)n : 0;
+}
+
+Matchmaker::Matchmaker(int capacity)
+{
+    for(int i=0; i<bucketCount; i++)
+        _queues[i] = new TicketQueue(capacity);
+}
+
+Matchmaker::~Matchmaker()
+{
+    for(int i=0; i<bucketCount; i++)
+        delete _queues[i];
+}
+
+Matchmaker::Result Matchmaker::join(Waiter* waiter, int bucket, MatchTicket& partner)
+{
+    if(bucket < 0 || bucket >= bucketCount)
+        bucket = 0;
+    cancel(waiter); //заново в очередь, в конец
+    if(popLive(bucket, partner))
+        return paired;
+    if(!enqueue(waiter, bucket))
+        return full;
+    //другой поток мог встать в очередь одновременно с нами, и ни один не увидел другого:
+    //забираем свой билет обратно и ищем еще раз (по дороге выбрасываются и устаревшие билеты)
+    if(_queues[bucket]->size() > 1 && cancel(waiter))
+    {
+        if(popLive(bucket, partner))
+            return paired;
+        if(!enqueue(waiter, bucket))
+            return full;
+    }
+    return queued;
+}
+
+bool Matchmaker::cancel(Waiter* waiter)
+{
+    if(waiter->ticket.exchange(0, std::memory_order_acq_rel) == 0)
+        return false; //не стоял или его уже забрал соперник
+    Metrics::add(ctrQueueLeft);
+    return true;
+}
+
+void Matchmaker::retire(Waiter* waiter)
+{
+    cancel(waiter);
+    if(++waiter->issued == 0)
+        waiter->issued++; //0 означает "не ждет"
+}
+
+bool Matchmaker::popLive(int bucket, MatchTicket& partner)
+{
+    MatchTicket ticket;
+    while(_queues[bucket]->pop(ticket))
+    {
+        uint32_t generation = ticket.generation;
+        //забрать ожидающего может только один: тот, кто сбросит его поколение
+        if(ticket.waiter->ticket.compare_exchange_strong(generation, 0, std::memory_order_acq_rel))
+        {
+            uint64_t now = Metrics::ticks();
+            Metrics::add(ctrQueueLeft);
+            Metrics::local().queueWait.record(now > ticket.enqueued ? now - ticket.enqueued : 0);
+            partner = ticket;
+            return true;
+        }
+        //игрок ушел из очереди или встал в нее заново: билет устарел
+    }
+    return false;
+}
+
+bool Matchmaker::enqueue(Waiter* waiter, int bucket)
+{
+    MatchTicket ticket;
+    ticket.waiter = waiter;
+    ticket.generation = ++waiter->issued;
+    if(ticket.generation == 0)
+        ticket.generation = ++waiter->issued; //0 означает "не ждет"
+    ticket.enqueued = Metrics::ticks();
+    waiter->bucket = bucket;
+    waiter->ticket.store(ticket.generation, std::memory_order_release); //до публикации билета
+    if(!_queues[bucket]->push(ticket))
+    {
+        waiter->ticket.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    Metrics::add(ctrQueued);
+    return true;
+}
+
+int Matchmaker::waiting() const
+{
+    int n = 0;
+    for(int i=0; i<bucketCount; i++)
+        n += _queues[i]->size();
+    return n;
+}
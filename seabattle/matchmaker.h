@@ -0,0 +1,88 @@
+#ifndef MATCHMAKER_H
+#define MATCHMAKER_H
+#include <stdint.h>
+#include <atomic>
+class ServClient;
+
+//место игрока в подборе: встраивается в сессию. Билет в очереди действителен, пока совпадает поколение.
+//Поколения растут и при закрытии сессии, и через переиспользование ее ячейки в пуле,
+//поэтому пара (Waiter, поколение) ссылается ровно на одно ожидание одного соединения
+struct Waiter
+{
+    Waiter() : ticket(0), issued(0), bucket(0), client(0) {}
+    std::atomic<uint32_t> ticket; //поколение билета, стоящего в очереди; 0 - не ждет
+    uint32_t issued; //последнее выданное поколение, меняет только владелец
+    int bucket; //в какой корзине ждет
+    ServClient* client;
+};
+
+//билет в очереди: кто ждет и с какого момента
+struct MatchTicket
+{
+    Waiter* waiter;
+    uint32_t generation;
+    uint64_t enqueued; //тики Metrics::ticks()
+};
+
+//ограниченная очередь многих писателей и читателей без блокировок (ячейки с номерами последовательности)
+class TicketQueue
+{
+public:
+    explicit TicketQueue(int capacity); //степень двойки
+    ~TicketQueue();
+    bool push(const MatchTicket& ticket); //false - очередь полна
+    bool pop(MatchTicket& ticket); //false - пуста
+    int size() const; //приблизительно, для решения о повторной попытке
+
+private:
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence;
+        MatchTicket ticket;
+    };
+    Cell* _cells;
+    uint64_t _mask;
+    //писатели и читатели крутят разные счетчики: разносим их по разным кэш-линиям
+    //отступами, а не alignas, чтобы очередь можно было создавать обычным new
+    char _pad0[64];
+    std::atomic<uint64_t> _head; //следующая занимаемая ячейка
+    char _pad1[64 - sizeof(std::atomic<uint64_t>)];
+    std::atomic<uint64_t> _tail; //следующая забираемая
+    char _pad2[64 - sizeof(std::atomic<uint64_t>)];
+    TicketQueue(const TicketQueue&);
+    TicketQueue& operator=(const TicketQueue&);
+};
+
+//подбор соперников: ожидающие стоят в очередях по корзинам (например, рейтинговым полосам),
+//пришедший забирает первого живого ожидающего своей корзины или встает в очередь сам.
+//Уход из очереди - сброс поколения в Waiter, устаревшие билеты выбрасывает тот, кто их достанет.
+//Все операции - O(1) без блокировок, очередь общая для любых потоков
+class Matchmaker
+{
+public:
+    static const int bucketCount = 4;
+
+    enum Result { paired, //partner - билет соперника, он из очереди уже вынут
+                  queued, //ждем соперника
+                  full //очередь корзины переполнена
+                };
+
+    explicit Matchmaker(int capacity = 1 << 14); //билетов на корзину
+    ~Matchmaker();
+    Result join(Waiter* waiter, int bucket, MatchTicket& partner);
+    bool cancel(Waiter* waiter); //выйти из очереди, false - не стоял
+    void retire(Waiter* waiter); //сессия закрыта: выйти из очереди и сделать недействительными выданные поколения
+    //забранный соперник все еще то же ожидание: не закрылся и не встал в очередь заново. Только в потоке владельца
+    static bool isCurrent(const MatchTicket& ticket) { return ticket.waiter->issued == ticket.generation && !isWaiting(ticket.waiter); }
+    static bool isWaiting(const Waiter* waiter) { return waiter->ticket.load(std::memory_order_relaxed) != 0; }
+    int waiting() const; //приблизительно, вместе с еще не выброшенными устаревшими билетами
+
+private:
+    TicketQueue* _queues[bucketCount];
+    bool popLive(int bucket, MatchTicket& partner); //первый еще ждущий, устаревшие выбрасываются
+    bool enqueue(Waiter* waiter, int bucket);
+    Matchmaker(const Matchmaker&);
+    Matchmaker& operator=(const Matchmaker&);
+};
+
+#endif // MATCHMAKER_H
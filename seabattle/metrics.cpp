@@ -0,0 +1,162 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+
+thread_local MetricsShard* Metrics::_local = 0;
+
+namespace {
+
+std::atomic<MetricsShard*> shards(0); //все потоки, когда-либо писавшие метрики
+
+//пара отсчетов для перевода тиков в секунды: частоту TSC узнаем по прошедшему времени
+const uint64_t startTicks = Metrics::ticks();
+const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+const char* counterNames[counterCount][2] = {
+    { "seabattle_connections_accepted_total", "Accepted client connections." },
+    { "seabattle_connections_rejected_total", "Connections closed at once because the match limit was reached." },
+    { "seabattle_accept_errors_total", "Failed accept calls." },
+    { "seabattle_connections_closed_total", "Closed client connections." },
+    { "seabattle_matches_opened_total", "Created matches." },
+    { "seabattle_matches_closed_total", "Finished or abandoned matches." },
+    { "seabattle_moves_total", "Resolved shots, human and AI." },
+    { "seabattle_bad_shots_total", "Shots out of turn or off the board." },
+    { "seabattle_bytes_in_total", "Bytes read from clients." },
+    { "seabattle_bytes_out_total", "Bytes written to clients." },
+    { "seabattle_partial_writes_total", "Flushes that filled the socket buffer and left data queued." },
+    { "seabattle_turn_timeouts_total", "Matches lost because a player ran out of turn time." },
+    { "seabattle_connections_reaped_total", "Connections closed for missing the placement deadline or idling." },
+    { "seabattle_matchmaking_queued_total", "Players put in the matchmaking queue." },
+    { "seabattle_matchmaking_left_total", "Players taken out of the matchmaking queue, paired or gone." },
+    { "seabattle_handovers_total", "Players moved to the worker thread of the opponent they were paired with." },
+    { "seabattle_sessions_suspended_total", "Players who lost their connection mid-match and had their seat held." },
+    { "seabattle_sessions_resumed_total", "Players who reconnected to a held seat." },
+    { "seabattle_resumes_rejected_total", "Resume requests for a finished match or with a wrong token." },
+    { "seabattle_snapshots_total", "Match table snapshots written for warm restart." }
+};
+
+const char* commandNames[frameOpcodes] = { "dot", "arrange", "kill", "damage", "void", "error", "start_game", "arrange_error",
+                                          "game_over", "resume", "snapshot" };
+
+//границы корзин для экспорта, секунды
+const double bounds[] = { 1e-6, 2e-6, 5e-6, 1e-5, 2e-5, 5e-5, 1e-4, 2e-4, 5e-4, 1e-3, 2e-3, 5e-3, 1e-2, 0.1, 1 };
+const int boundCount = sizeof(bounds) / sizeof(bounds[0]);
+//ожидание соперника меряется секундами
+const double waitBounds[] = { 1e-3, 1e-2, 0.1, 0.5, 1, 2, 5, 10, 30, 60, 120, 300 };
+const int waitBoundCount = sizeof(waitBounds) / sizeof(waitBounds[0]);
+
+void appendf(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void appendf(std::string& out, const char* format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    out.append(line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+}
+
+//внутренние корзины HDR (около 3%) сводятся к корзинам Prometheus limits, по умолчанию стандартным
+void appendHistogram(std::string& out, const char* name, const char* labels, const Histogram& h, double secondsPerTick,
+                     const double* limits = bounds, int limitCount = boundCount)
+{
+    uint64_t cumulative[32];
+    for(int b=0; b<limitCount; b++)
+        cumulative[b] = 0;
+    for(int i=0; i<Histogram::bucketCount; i++)
+    {
+        uint64_t n = h.bucketCountAt(i);
+        if(!n)
+            continue;
+        double upper = Histogram::bucketUpper(i) * secondsPerTick;
+        for(int b=0; b<limitCount; b++)
+            if(upper <= limits[b])
+                cumulative[b] += n;
+    }
+    const char* comma = *labels ? "," : "";
+    for(int b=0; b<limitCount; b++)
+        appendf(out, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, comma, limits[b], (unsigned long long)cumulative[b]);
+    appendf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, comma, (unsigned long long)h.count());
+    std::string series = *labels ? std::string("{") + labels + "}" : std::string();
+    appendf(out, "%s_sum%s %.9f\n", name, series.c_str(), h.sum() * secondsPerTick);
+    appendf(out, "%s_count%s %llu\n", name, series.c_str(), (unsigned long long)h.count());
+}
+
+}
+
+MetricsShard& Metrics::attach()
+{
+    //поток живет до конца работы сервера, поэтому его метрики не освобождаются
+    void* memory = 0;
+    if(posix_memalign(&memory, 64, sizeof(MetricsShard)) != 0)
+        abort();
+    MetricsShard* shard = new(memory) MetricsShard();
+    for(int i=0; i<counterCount; i++)
+        shard->counters[i].store(0, std::memory_order_relaxed);
+    shard->next = shards.load(std::memory_order_relaxed);
+    while(!shards.compare_exchange_weak(shard->next, shard, std::memory_order_release, std::memory_order_relaxed))
+        ;
+    _local = shard;
+    return *shard;
+}
+
+double Metrics::secondsPerTick()
+{
+    uint64_t elapsedTicks = ticks() - startTicks;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return elapsedTicks ? elapsed / elapsedTicks : 1e-9;
+}
+
+std::string Metrics::render()
+{
+    uint64_t counters[counterCount] = { 0 };
+    Histogram accept, frames[frameOpcodes], queueWait;
+    //гистограммы чужих потоков читаются без синхронизации: значение может отстать на несколько событий
+    for(MetricsShard* s = shards.load(std::memory_order_acquire); s; s = s->next)
+    {
+        for(int i=0; i<counterCount; i++)
+            counters[i] += s->counters[i].load(std::memory_order_relaxed);
+        accept.merge(s->accept);
+        for(int c=0; c<frameOpcodes; c++)
+            frames[c].merge(s->frames[c]);
+        queueWait.merge(s->queueWait);
+    }
+    double tick = secondsPerTick();
+
+    std::string out;
+    out.reserve(16384);
+    for(int i=0; i<counterCount; i++)
+    {
+        appendf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counterNames[i][0], counterNames[i][1],
+                counterNames[i][0], counterNames[i][0], (unsigned long long)counters[i]);
+    }
+    appendf(out, "# HELP seabattle_connections_active Open client connections.\n"
+                 "# TYPE seabattle_connections_active gauge\nseabattle_connections_active %lld\n",
+            (long long)(counters[ctrAccepted] - counters[ctrClosed]));
+    appendf(out, "# HELP seabattle_matches_active Matches waiting for players or in progress.\n"
+                 "# TYPE seabattle_matches_active gauge\nseabattle_matches_active %lld\n",
+            (long long)(counters[ctrMatchesOpened] - counters[ctrMatchesClosed]));
+    appendf(out, "# HELP seabattle_matchmaking_waiting Players waiting in the matchmaking queue.\n"
+                 "# TYPE seabattle_matchmaking_waiting gauge\nseabattle_matchmaking_waiting %lld\n",
+            (long long)(counters[ctrQueued] - counters[ctrQueueLeft]));
+    appendf(out, "# HELP seabattle_accept_duration_seconds Time to set up one accepted connection.\n"
+                 "# TYPE seabattle_accept_duration_seconds histogram\n");
+    appendHistogram(out, "seabattle_accept_duration_seconds", "", accept, tick);
+    appendf(out, "# HELP seabattle_frame_duration_seconds Time to handle one client frame, by opcode.\n"
+                 "# TYPE seabattle_frame_duration_seconds histogram\n");
+    for(int c=0; c<frameOpcodes; c++)
+    {
+        if(!frames[c].count())
+            continue; //сервер принимает только comDot, comArrange и comResume, остальные не показываем
+        char labels[32];
+        snprintf(labels, sizeof(labels), "opcode=\"%s\"", commandNames[c]);
+        appendHistogram(out, "seabattle_frame_duration_seconds", labels, frames[c], tick);
+    }
+    appendf(out, "# HELP seabattle_matchmaking_wait_seconds Time a player waited in the queue for an opponent.\n"
+                 "# TYPE seabattle_matchmaking_wait_seconds histogram\n");
+    appendHistogram(out, "seabattle_matchmaking_wait_seconds", "", queueWait, tick, waitBounds, waitBoundCount);
+    return out;
+}
@@ -0,0 +1,88 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <string>
+#include "histogram.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//счетчики сервера
+enum Counter { ctrAccepted, //принятые соединения
+               ctrRejected, //отклонены: нет мест
+               ctrAcceptErrors,
+               ctrClosed, //закрытые соединения
+               ctrMatchesOpened,
+               ctrMatchesClosed,
+               ctrMoves, //выстрелы людей и компьютера
+               ctrBadShots, //выстрел не в свой ход или за полем
+               ctrBytesIn,
+               ctrBytesOut,
+               ctrPartialWrites, //буфер ядра заполнился, часть очереди ждет EPOLLOUT
+               ctrTurnTimeouts, //партия проиграна по времени хода
+               ctrReaped, //соединение закрыто: не прислало расстановку или ждало слишком долго
+               ctrQueued, //билет встал в очередь подбора
+               ctrQueueLeft, //билет вышел из очереди: найден соперник или игрок ушел
+               ctrHandovers, //игрок переехал на поток соперника
+               ctrSuspended, //соединение игрока оборвалось в партии, место держится до возврата
+               ctrResumed, //игрок вернулся на свое место по билету
+               ctrResumeRejected, //билет не подошел: партия окончена или билет чужой
+               ctrSnapshots, //записанные снимки партий
+               counterCount
+             };
+
+const int frameOpcodes = 11; //команды com, для которых ведутся гистограммы кадров
+
+//у каждого потока свои счетчики и гистограммы: запись без блокировок и без общих кэш-линий
+struct alignas(64) MetricsShard
+{
+    MetricsShard* next;
+    std::atomic<uint64_t> counters[counterCount]; //пишет только поток-владелец, relaxed без lock-префикса
+    Histogram accept; //прием одного соединения, в тиках
+    Histogram frames[frameOpcodes]; //обработка кадра по командам com, в тиках
+    Histogram queueWait; //ожидание соперника в очереди подбора, в тиках
+};
+
+class Metrics
+{
+public:
+    static MetricsShard& local() //метрики текущего потока
+    {
+        MetricsShard* shard = _local;
+        return shard ? *shard : attach();
+    }
+    static void add(Counter counter, uint64_t n = 1)
+    {
+        std::atomic<uint64_t>& c = local().counters[counter];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    //дешевые тики для замеров: TSC на x86, иначе монотонные наносекунды
+    static uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+    }
+    //кадр command обрабатывался с started до сейчас, возвращает текущие тики
+    static uint64_t recordFrame(int command, uint64_t started)
+    {
+        uint64_t now = ticks();
+        if(command >= 0 && command < frameOpcodes)
+            local().frames[command].record(now - started);
+        return now;
+    }
+    static double secondsPerTick(); //по времени, прошедшему с запуска
+    static std::string render(); //сумма по всем потокам в текстовом формате Prometheus
+
+private:
+    static thread_local MetricsShard* _local;
+    static MetricsShard& attach();
+};
+
+#endif // METRICS_H
@@ -0,0 +1,278 @@
+#include "metricsendpoint.h"
+#include "metrics.h"
+#include "trace.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//запрос без движения дольше этого закрывается: медленный сборщик не держит дескриптор и память
+static const int requestIdleMs = 2000;
+
+//один запрос: дочитываем заголовки HTTP, отвечаем и закрываем соединение.
+//Ответ уходит неблокирующими send по EPOLLOUT: цикл сервера не ждет сборщика
+class MetricsRequest: public IoHandler, public TimerHandler
+{
+public:
+    MetricsRequest(int sock, MetricsEndpoint* endpoint) : _sock(sock), _endpoint(endpoint), _sent(0), _replying(false)
+    {
+        _endpoint->timers()->arm(&_deadline, this, requestIdleMs);
+    }
+    ~MetricsRequest()
+    {
+        if(_sock != -1)
+            close(_sock);
+    }
+    void onReadable()
+    {
+        if(_sock == -1 || _replying)
+            return; //остальное, что прислал клиент, не нужно
+        char buf[1024];
+        for(;;)
+        {
+            int n = read(_sock, buf, sizeof(buf));
+            if(n > 0)
+            {
+                _request.append(buf, n);
+                if(_request.find("\r\n\r\n") != std::string::npos || _request.find("\n\n") != std::string::npos)
+                    break;
+                if(_request.size() > 8192)
+                    break; //заголовки не нужны, не копим их бесконечно
+                continue;
+            }
+            if(n < 0 && errno == EINTR)
+                continue;
+            if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                _endpoint->timers()->arm(&_deadline, this, requestIdleMs); //ждем остаток запроса
+                return;
+            }
+            break; //клиент закрыл запись: отвечаем на то, что есть
+        }
+        respond();
+    }
+    void onWritable()
+    {
+        if(_sock == -1 || !_replying)
+            return;
+        while(_sent < _reply.size())
+        {
+            ssize_t w = send(_sock, _reply.data() + _sent, _reply.size() - _sent, MSG_NOSIGNAL);
+            if(w < 0 && errno == EINTR)
+                continue;
+            if(w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                _endpoint->timers()->arm(&_deadline, this, requestIdleMs); //допишем по следующему EPOLLOUT
+                return;
+            }
+            if(w <= 0)
+                break;
+            _sent += w;
+        }
+        finish();
+    }
+    void onTimer(Timer*)
+    {
+        if(_sock != -1)
+        {
+            finish(); //сборщик пропал посреди запроса или не читает ответ
+            return;
+        }
+        _endpoint->forget(this);
+        delete this;
+    }
+
+private:
+    int _sock;
+    MetricsEndpoint* _endpoint;
+    std::string _request;
+    std::string _reply;
+    size_t _sent;
+    bool _replying;
+    Timer _deadline;
+
+    //соединение закрывается сразу, а объект удаляется на следующем тике колеса: в текущей пачке
+    //событий epoll могут остаться события этого дескриптора со ссылкой на обработчик
+    void finish()
+    {
+        _endpoint->reactor()->remove(_sock);
+        close(_sock);
+        _sock = -1;
+        _endpoint->timers()->arm(&_deadline, this, 0);
+    }
+
+    //GET /metrics          - метрики Prometheus
+    //GET /trace            - записанная трасса в формате Chrome trace
+    //GET /trace/match/ID   - включить трассу партии (/trace/match/ID/off - выключить)
+    //GET /trace/conn/SOCK  - включить трассу соединения
+    //GET /trace/off        - выключить трассу у всех и забыть записанное
+    bool route(const std::string& path, std::string& body, const char*& type)
+    {
+        TraceControl* control = _endpoint->control();
+        type = "text/plain; version=0.0.4";
+        if(path == "/" || path == "/metrics")
+        {
+            body = Metrics::render();
+            return true;
+        }
+        if(path == "/trace")
+        {
+            type = "application/json";
+            body = Trace::dumpJson();
+            return true;
+        }
+        if(!control)
+            return false;
+        if(path == "/trace/off")
+        {
+            control->traceOff();
+            Trace::clear();
+            body = "tracing off\n";
+            return true;
+        }
+        int id = 0;
+        char what[8], off[4];
+        int fields = sscanf(path.c_str(), "/trace/%7[a-z]/%d/%3s", what, &id, off);
+        if(fields < 2)
+            return false;
+        bool on = fields == 2;
+        bool found = false;
+        if(!strcmp(what, "match"))
+            found = control->traceMatch(id, on);
+        else if(!strcmp(what, "conn"))
+            found = control->traceConnection(id, on);
+        body = found ? (on ? "tracing on\n" : "tracing off\n") : "";
+        return found;
+    }
+
+    void respond()
+    {
+        char method[8] = "", path[128] = "";
+        sscanf(_request.c_str(), "%7s %127s", method, path);
+        std::string body;
+        const char* type = "text/plain";
+        bool found = !strcmp(method, "GET") && route(path, body, type);
+        if(!found)
+            body = "not found\n";
+        char head[192];
+        int n = snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: %s\r\n"
+                                             "Content-Length: %d\r\nConnection: close\r\n\r\n",
+                         found ? "200 OK" : "404 Not Found", type, (int)body.size());
+        _reply = std::string(head, n) + body;
+        _replying = true;
+        _endpoint->reactor()->modify(_sock, this, EPOLLOUT | EPOLLET);
+        onWritable(); //обычно страница целиком помещается в буфер сокета сразу
+    }
+};
+
+MetricsEndpoint::MetricsEndpoint()
+{
+    _listener = -1;
+    _reactor = 0;
+    _timers = 0;
+    _control = 0;
+}
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+    for(std::set<MetricsRequest*>::iterator i = _requests.begin(); i != _requests.end(); ++i)
+        delete *i; //сервер остановлен посреди запроса
+    if(_listener != -1)
+    {
+        close(_listener);
+        if(!_path.empty())
+            unlink(_path.c_str());
+    }
+}
+
+bool MetricsEndpoint::open(const std::string& address, Reactor* reactor, TimerWheel* timers, TraceControl* control, int listener)
+{
+    _reactor = reactor;
+    _timers = timers;
+    _control = control;
+    char* end = 0;
+    long port = strtol(address.c_str(), &end, 10);
+    bool tcp = *end == 0 && port > 0 && port < 65536;
+    if(listener != -1)
+    {
+        _listener = listener; //уже слушает, очередь запросов сохранилась
+        if(!tcp)
+            _path = address;
+        return _reactor->add(_listener, this, EPOLLIN | EPOLLET);
+    }
+    if(tcp)
+    {
+        //только 127.0.0.1: метрики не выставляем наружу
+        _listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int yes = 1;
+        setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(bind(_listener, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+        {
+            perror("metrics: bind");
+            close(_listener);
+            _listener = -1;
+            return false;
+        }
+    } else {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if(address.size() >= sizeof(addr.sun_path))
+        {
+            fprintf(stderr, "metrics: socket path is too long\n");
+            return false;
+        }
+        strcpy(addr.sun_path, address.c_str());
+        unlink(addr.sun_path); //сокет от прошлого запуска
+        _listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(bind(_listener, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+        {
+            perror("metrics: bind");
+            close(_listener);
+            _listener = -1;
+            return false;
+        }
+        _path = address;
+    }
+    if(listen(_listener, 16) == -1)
+    {
+        perror("metrics: listen");
+        return false;
+    }
+    return _reactor->add(_listener, this, EPOLLIN | EPOLLET);
+}
+
+void MetricsEndpoint::onReadable()
+{
+    for(;;)
+    {
+        int sock = accept4(_listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(sock < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return;
+        }
+        MetricsRequest* request = new MetricsRequest(sock, this);
+        _requests.insert(request);
+        _reactor->add(sock, request);
+        request->onReadable(); //запрос мог прийти вместе с соединением
+    }
+}
+
+void MetricsEndpoint::forget(MetricsRequest* request)
+{
+    _requests.erase(request);
+}
@@ -0,0 +1,36 @@
+#ifndef METRICSENDPOINT_H
+#define METRICSENDPOINT_H
+#include <string>
+#include <set>
+#include "reactor.h"
+#include "timerwheel.h"
+class TraceControl;
+class MetricsRequest;
+
+//страница метрик для Prometheus и управление трассой: слушает локальный порт или Unix-сокет в реакторе сервера
+class MetricsEndpoint: public IoHandler
+{
+public:
+    MetricsEndpoint();
+    ~MetricsEndpoint();
+    //address - номер порта на 127.0.0.1 или путь к Unix-сокету, control - кто включает трассу (0 - только чтение),
+    //timers - сроки запросов, listener - уже слушающий сокет на этом адресе от старого процесса (-1 - открыть свой)
+    bool open(const std::string& address, Reactor* reactor, TimerWheel* timers, TraceControl* control = 0, int listener = -1);
+    int listener() const { return _listener; }
+    void release() { _path.clear(); } //сокет перешел к новому процессу: путь при закрытии не удалять
+    void onReadable(); //новые подключения
+    Reactor* reactor() const { return _reactor; }
+    TimerWheel* timers() const { return _timers; }
+    TraceControl* control() const { return _control; }
+    void forget(MetricsRequest* request); //запрос закончен и удаляет себя
+
+private:
+    int _listener;
+    Reactor* _reactor;
+    TimerWheel* _timers;
+    TraceControl* _control;
+    std::set<MetricsRequest*> _requests; //незаконченные запросы, удаляются вместе с сервером
+    std::string _path; //Unix-сокет удаляем при закрытии
+};
+
+#endif // METRICSENDPOINT_H
@@ -0,0 +1,153 @@
+#include "outqueue.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+OutQueue::OutQueue()
+{
+    _head = 0;
+    _tail = 0;
+    _spare = 0;
+    _size = 0;
+}
+
+OutQueue::~OutQueue()
+{
+    clear();
+    delete _spare;
+}
+
+void OutQueue::swap(OutQueue& other)
+{
+    std::swap(_head, other._head);
+    std::swap(_tail, other._tail);
+    std::swap(_spare, other._spare);
+    std::swap(_size, other._size);
+}
+
+void OutQueue::peek(char* dst) const
+{
+    for(Chunk* chunk = _head; chunk; chunk = chunk->next)
+    {
+        memcpy(dst, chunk->data + chunk->begin, chunk->end - chunk->begin);
+        dst += chunk->end - chunk->begin;
+    }
+}
+
+OutQueue::Chunk* OutQueue::newChunk()
+{
+    Chunk* chunk = _spare;
+    if(chunk)
+    {
+        _spare = 0;
+    } else {
+        chunk = new Chunk;
+    }
+    chunk->next = 0;
+    chunk->begin = 0;
+    chunk->end = 0;
+    return chunk;
+}
+
+void OutQueue::freeChunk(Chunk* chunk)
+{
+    if(!_spare)
+    {
+        _spare = chunk;
+    } else {
+        delete chunk;
+    }
+}
+
+char* OutQueue::reserve(int n)
+{
+    if(!_tail || chunkCapacity - _tail->end < n)
+    {
+        Chunk* chunk = newChunk();
+        if(_tail)
+        {
+            _tail->next = chunk;
+        } else {
+            _head = chunk;
+        }
+        _tail = chunk;
+    }
+    return _tail->data + _tail->end;
+}
+
+void OutQueue::commit(int n)
+{
+    _tail->end += n;
+    _size += n;
+}
+
+void OutQueue::append(const char* data, int n)
+{
+    while(n > 0)
+    {
+        int part = (n < chunkCapacity)?n:chunkCapacity;
+        memcpy(reserve(part), data, part);
+        commit(part);
+        data += part;
+        n -= part;
+    }
+}
+
+int OutQueue::flush(int fd)
+{
+    while(_size > 0)
+    {
+        struct iovec iov[16];
+        int cnt = 0;
+        for(Chunk* chunk = _head; chunk && cnt < 16; chunk = chunk->next)
+        {
+            iov[cnt].iov_base = chunk->data + chunk->begin;
+            iov[cnt].iov_len = chunk->end - chunk->begin;
+            cnt++;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = cnt;
+        int n = sendmsg(fd, &msg, MSG_NOSIGNAL); //writev, но без SIGPIPE
+        if(n < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+        _size -= n;
+        while(n > 0)
+        {
+            int part = _head->end - _head->begin;
+            if(n < part)
+            {
+                _head->begin += n;
+                break;
+            }
+            n -= part;
+            Chunk* done = _head;
+            _head = _head->next;
+            if(!_head)
+                _tail = 0;
+            freeChunk(done);
+        }
+    }
+    return 1;
+}
+
+void OutQueue::clear()
+{
+    while(_head)
+    {
+        Chunk* next = _head->next;
+        freeChunk(_head);
+        _head = next;
+    }
+    _tail = 0;
+    _size = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef OUTQUEUE_H
+#define OUTQUEUE_H
+
+//очередь исходящих байтов: кадры дописываются в блоки, отправка - одним writev
+class OutQueue
+{
+public:
+    OutQueue();
+    ~OutQueue();
+    int size() const { return _size; } //сколько байт ждет отправки
+    bool isEmpty() const { return _size == 0; }
+    char* reserve(int n); //n байт подряд в конце очереди (n <= chunkCapacity)
+    void commit(int n); //записано n байт из reserve
+    void append(const char* data, int n);
+    int flush(int fd); //1 - все отправлено, 0 - буфер ядра полон (EAGAIN), -1 - ошибка
+    void clear();
+    void swap(OutQueue& other); //обменяться содержимым без копирования
+    void peek(char* dst) const; //скопировать всю очередь (size() байт), не забирая
+
+    static const int chunkCapacity = 4096 - 3*sizeof(int) - sizeof(void*);
+
+private:
+    struct Chunk
+    {
+        Chunk* next;
+        int begin; //первый неотправленный байт
+        int end; //конец записанных данных
+        int pad;
+        char data[chunkCapacity];
+    };
+    OutQueue(const OutQueue&);
+    OutQueue& operator=(const OutQueue&);
+    Chunk* newChunk();
+    void freeChunk(Chunk* chunk);
+    Chunk* _head;
+    Chunk* _tail;
+    Chunk* _spare; //один свободный блок держим про запас, чтобы не дергать аллокатор
+    int _size;
+};
+
+#endif // OUTQUEUE_H
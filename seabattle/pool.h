@@ -0,0 +1,127 @@
+#ifndef POOL_H
+#define POOL_H
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+//ссылка на объект пула: номер ячейки и ее поколение. После возврата объекта в пул
+//поколение ячейки растет, и старая ссылка перестает разыменовываться
+struct PoolHandle
+{
+    uint32_t index;
+    uint32_t generation;
+    uint64_t pack() const { return ((uint64_t)generation << 32) | index; } //например, в тег таймера
+    static PoolHandle unpack(uint64_t packed) { PoolHandle h = { (uint32_t)packed, (uint32_t)(packed >> 32) }; return h; }
+};
+
+//служебные поля объекта в пуле: объекты пула наследуют их
+struct PoolSlot
+{
+    PoolSlot() : poolIndex(0), poolGeneration(0), poolLive(false) {}
+    uint32_t poolIndex;
+    uint32_t poolGeneration;
+    bool poolLive; //выдан и еще не возвращен
+};
+
+//пул объектов кусками по slabSize. Объекты создаются один раз и дальше только переиспользуются:
+//их буферы остаются с ними, так что выдача и возврат не трогают аллокатор, а память
+//держится на пике нагрузки и не растет со временем работы. Пул принадлежит одному потоку
+template<class T>
+class Pool
+{
+public:
+    static const int slabSize = 256;
+
+    explicit Pool(int limit = 0) : _limit(limit), _live(0) {} //limit - не больше объектов, 0 - без ограничения
+    ~Pool()
+    {
+        for(size_t i=0; i<_slabs.size(); i++)
+            delete[] _slabs[i];
+    }
+    void setLimit(int limit) { _limit = limit; }
+
+    T* acquire() //0 - достигнут предел
+    {
+        if(_limit > 0 && _live >= _limit)
+            return 0;
+        if(_free.empty())
+            grow();
+        T* object = at(_free.back());
+        _free.pop_back();
+        object->poolLive = true;
+        _live++;
+        return object;
+    }
+    void release(T* object)
+    {
+        object->poolLive = false;
+        object->poolGeneration++; //старые ссылки больше не действуют
+        _free.push_back(object->poolIndex);
+        _live--;
+    }
+
+    //объект из состояния другого процесса - в ту же ячейку с тем же поколением, чтобы старые ссылки
+    //на него продолжали действовать. Предел не проверяется; после всех restore - rebuild
+    T* restore(PoolHandle h)
+    {
+        while(capacity() <= h.index)
+            grow();
+        T* object = at(h.index);
+        if(object->poolLive)
+            return 0; //ячейка уже занята
+        object->poolLive = true;
+        object->poolGeneration = h.generation;
+        _live++;
+        return object;
+    }
+    void rebuild() //список свободных ячеек после restore
+    {
+        _free.clear();
+        for(uint32_t i=capacity(); i>0; i--)
+            if(!at(i - 1)->poolLive)
+                _free.push_back(i - 1);
+    }
+
+    PoolHandle handle(const T* object) const { PoolHandle h = { object->poolIndex, object->poolGeneration }; return h; }
+    T* get(PoolHandle h) const //0 - объект уже возвращен в пул
+    {
+        if(h.index >= capacity())
+            return 0;
+        T* object = at(h.index);
+        return object->poolLive && object->poolGeneration == h.generation ? object : 0;
+    }
+
+    T* live(uint32_t index) const { return index < capacity() && at(index)->poolLive ? at(index) : 0; } //0 - ячейка свободна
+    int size() const { return _live; } //выдано
+    uint32_t capacity() const { return _slabs.size() * slabSize; } //создано
+    template<class F> void forEach(F f) const //все выданные объекты
+    {
+        for(size_t s=0; s<_slabs.size(); s++)
+            for(int i=0; i<slabSize; i++)
+                if(_slabs[s][i].poolLive)
+                    f(&_slabs[s][i]);
+    }
+
+private:
+    int _limit;
+    int _live;
+    std::vector<T*> _slabs;
+    std::vector<uint32_t> _free; //номера свободных ячеек, последним освободился - первым выдается (он теплее в кэше)
+    T* at(uint32_t index) const { return &_slabs[index / slabSize][index % slabSize]; }
+    void grow()
+    {
+        T* slab = new T[slabSize];
+        uint32_t first = capacity();
+        _slabs.push_back(slab);
+        _free.reserve(capacity());
+        for(int i=slabSize-1; i>=0; i--)
+        {
+            slab[i].poolIndex = first + i;
+            _free.push_back(first + i);
+        }
+    }
+    Pool(const Pool&);
+    Pool& operator=(const Pool&);
+};
+
+#endif // POOL_H
@@ -0,0 +1,117 @@
+#include "protocol.h"
+#include <string.h>
+
+int encodeFrame(char* out, int command, const char* payload, int length)
+{
+    out[0] = protocolVersion;
+    out[1] = command;
+    out[2] = (length >> 8) & 0xff;
+    out[3] = length & 0xff;
+    if(length > 0)
+    {
+        memcpy(out + frameHeaderSize, payload, length);
+    }
+    return frameHeaderSize + length;
+}
+
+int decodeFrame(RingBuffer& in, Frame& frame, char* scratch)
+{
+    if(in.size() < frameHeaderSize)
+        return 0;
+    unsigned char header[frameHeaderSize];
+    in.peek((char*)header, frameHeaderSize);
+    if(header[0] != protocolVersion)
+        return -1;
+    int length = (header[2] << 8) | header[3];
+    if(length > maxFramePayload)
+        return -1;
+    if(in.size() < frameHeaderSize + length)
+        return 0;
+    frame.command = header[1];
+    frame.length = length;
+    frame.payload = in.contiguous(length, frameHeaderSize, scratch);
+    in.consume(frameHeaderSize + length);
+    return 1;
+}
+
+static void putUint(char* out, uint64_t value, int bytes) //big-endian, как длина кадра
+{
+    for(int i=bytes-1; i>=0; i--)
+    {
+        out[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+static uint64_t getUint(const char* in, int bytes)
+{
+    uint64_t value = 0;
+    for(int i=0; i<bytes; i++)
+        value = (value << 8) | (unsigned char)in[i];
+    return value;
+}
+
+static void putBits(char* out, Bits b)
+{
+    for(int i=0; i<13; i++)
+    {
+        out[i] = (char)(b & 0xff);
+        b >>= 8;
+    }
+}
+
+static Bits getBits(const char* in)
+{
+    Bits b = 0;
+    for(int i=12; i>=0; i--)
+        b = (b << 8) | (unsigned char)in[i];
+    return b & bits::all;
+}
+
+void encodeToken(char* out, const ResumeToken& token)
+{
+    putUint(out, token.worker, 2);
+    out[2] = token.side;
+    out[3] = 0;
+    putUint(out + 4, token.index, 4);
+    putUint(out + 8, token.generation, 4);
+    putUint(out + 12, token.secret, 8);
+}
+
+void decodeToken(const char* in, ResumeToken& token)
+{
+    token.worker = getUint(in, 2);
+    token.side = (unsigned char)in[2];
+    token.index = getUint(in + 4, 4);
+    token.generation = getUint(in + 8, 4);
+    token.secret = getUint(in + 12, 8);
+}
+
+int encodeSnapshot(char* out, const Snapshot& snapshot)
+{
+    out[0] = 1;
+    out[1] = snapshot.myMove;
+    putUint(out + 2, snapshot.moves, 2);
+    out[4] = snapshot.wins;
+    out[5] = snapshot.losses;
+    const Bits boards[6] = { snapshot.myShips, snapshot.myHits, snapshot.myMisses,
+                             snapshot.enemyHits, snapshot.enemyMisses, snapshot.enemySunk };
+    for(int i=0; i<6; i++)
+        putBits(out + 6 + i*13, boards[i]);
+    return snapshotSize;
+}
+
+bool decodeSnapshot(const char* payload, int length, Snapshot& snapshot)
+{
+    if(length < snapshotSize || payload[0] != 1)
+        return false;
+    snapshot.myMove = payload[1] != 0;
+    snapshot.moves = getUint(payload + 2, 2);
+    snapshot.wins = (unsigned char)payload[4];
+    snapshot.losses = (unsigned char)payload[5];
+    Bits* boards[6] = { &snapshot.myShips, &snapshot.myHits, &snapshot.myMisses,
+                        &snapshot.enemyHits, &snapshot.enemyMisses, &snapshot.enemySunk };
+    for(int i=0; i<6; i++)
+        *boards[i] = getBits(payload + 6 + i*13);
+    return true;
+}
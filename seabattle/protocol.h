@@ -0,0 +1,87 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+#include "ringbuffer.h"
+#include "bitboard.h"
+
+//команды протокола клиент-сервер
+enum com { comDot, //выстрел
+           comArrange, //расположение
+           comKill, //убит
+           comDamage, //попадание
+           comVoid, //промах
+           comError, //нельзя стрелять
+           comStartGame,
+           comArrangeError, //расстановка отклонена, данные - код FleetError
+           comGameOver, //партия окончена не потоплением: данные - победил ли получатель (1/0) и причина gameOverReason
+           comResume, //вернуться в партию после обрыва: данные - билет из comStartGame
+           comSnapshot, //ответ на comResume: Snapshot или один байт 0, если партию уже не вернуть
+           comOpponent //соединение соперника: 1 - оборвалось, место ждет его (2 байта big-endian - секунд ожидания), 0 - вернулся
+        };
+
+//причина comGameOver
+enum gameOverReason { gameOverTimeout, //у игрока вышло время хода
+                      gameOverOpponentLeft //соперник отключился
+                    };
+
+//необязательный 101-й байт данных comArrange: с кем играть
+enum arrangeMode { arrangeHuman, //ждать живого соперника
+                   arrangeVsAi //играть с компьютером
+                 };
+//необязательный 102-й байт comArrange - корзина подбора (рейтинговая полоса) от 0 до Matchmaker::bucketCount-1:
+//живого соперника ищут только в своей корзине
+
+//данные comStartGame: кто ходит первым (1 байт), затем билет возврата (resumeTokenSize байт);
+//в партии против компьютера билет тоже выдается, старые клиенты читают только первый байт
+
+//кадр: версия (1 байт), команда (1 байт), длина данных (2 байта, big-endian), данные
+const int protocolVersion = 1;
+const int frameHeaderSize = 4;
+const int maxFramePayload = 1024;
+
+struct Frame
+{
+    int command;
+    int length;
+    const char* payload; //действителен до следующего заполнения буфера
+};
+
+//собрать кадр в out (не меньше frameHeaderSize+length байт), возвращает его размер
+int encodeFrame(char* out, int command, const char* payload, int length);
+
+//забрать из буфера очередной кадр: 1 - кадр есть, 0 - нужно больше данных, -1 - ошибка протокола
+//scratch - не меньше maxFramePayload байт, туда копируются данные, разорванные концом буфера
+int decodeFrame(RingBuffer& in, Frame& frame, char* scratch);
+
+//билет возврата в партию: где она живет и секрет места, которого нет в журнале и логе
+const int resumeTokenSize = 20;
+struct ResumeToken
+{
+    int worker; //поток-владелец партии
+    int side; //место игрока
+    uint32_t index; //ячейка партии в пуле потока и ее поколение
+    uint32_t generation;
+    uint64_t secret;
+};
+void encodeToken(char* out, const ResumeToken& token); //resumeTokenSize байт
+void decodeToken(const char* in, ResumeToken& token);
+
+//партия глазами вернувшегося игрока: оба поля без чужих целых кораблей, чей ход и счет.
+//Поле - 13 байт, бит клетки c - бит c%8 байта c/8
+struct Snapshot
+{
+    bool myMove;
+    int moves; //выстрелов в партии, без повторов
+    int wins; //потоплено кораблей соперника
+    int losses; //потоплено своих
+    Bits myShips;
+    Bits myHits; //попадания соперника по своему полю
+    Bits myMisses;
+    Bits enemyHits; //свои попадания
+    Bits enemyMisses;
+    Bits enemySunk; //палубы потопленных кораблей соперника
+};
+const int snapshotSize = 6 + 6*13;
+int encodeSnapshot(char* out, const Snapshot& snapshot); //snapshotSize байт
+bool decodeSnapshot(const char* payload, int length, Snapshot& snapshot); //false - отказ в возврате
+
+#endif // PROTOCOL_H
@@ -0,0 +1,299 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <map>
+#include <vector>
+#include "archive.h"
+#include "journal.h"
+
+//аналитика по архиву партий: сборка архива из журнала сервера и запросы по столбцам
+struct Filter
+{
+    uint64_t from, to; //время создания партии, мс
+    int minMoves, maxMoves;
+    int ai; //1 - только с компьютером, 0 - только люди, -1 - все
+    bool matches(const BlockView& v, int i) const
+    {
+        int moves = v.shotCount[0][i] + v.shotCount[1][i];
+        return v.time[i] >= from && v.time[i] <= to && moves >= minMoves && moves <= maxMoves &&
+               (ai < 0 || (v.aiSide[i] >= 0) == (ai == 1));
+    }
+};
+
+//по индексу блока: 0 - пропустить, 1 - подходят все партии, 2 - проверять каждую
+static int classify(const BlockIndex& b, const Filter& f)
+{
+    if(b.maxTime < f.from || b.minTime > f.to || b.maxMoves < f.minMoves || b.minMoves > f.maxMoves)
+        return 0;
+    if((f.ai == 1 && b.aiMatches == 0) || (f.ai == 0 && b.aiMatches == b.count))
+        return 0;
+    bool all = b.minTime >= f.from && b.maxTime <= f.to && b.minMoves >= f.minMoves && b.maxMoves <= f.maxMoves &&
+               (f.ai < 0 || (f.ai == 1 && b.aiMatches == b.count) || (f.ai == 0 && b.aiMatches == 0));
+    return all ? 1 : 2;
+}
+
+static int build(const std::string& journalDir, const std::string& path)
+{
+    JournalReader reader;
+    if(!reader.open(journalDir))
+    {
+        qCritical() << "cannot open journal";
+        return 1;
+    }
+    ArchiveWriter writer;
+    if(!writer.open(path))
+        return 1;
+    std::map<int, ArchivedMatch> live;
+    std::map<int, bool> started;
+    JournalEntry e;
+    while(reader.next(e))
+    {
+        ArchivedMatch& m = live[e.match];
+        switch(e.type)
+        {
+        case recMatch:
+            m = ArchivedMatch();
+            m.id = e.match;
+            m.seed = e.seed;
+            m.time = e.time;
+            m.aiSide = -1;
+            m.ships[0] = m.ships[1] = 0;
+            started[e.match] = false;
+            break;
+        case recArrange:
+            m.ships[e.side] = e.ships;
+            break;
+        case recStart:
+            m.first = e.turn;
+            m.aiSide = e.aiSide;
+            started[e.match] = true;
+            break;
+        case recShot:
+            m.shots[e.side].push_back(e.cell);
+            break;
+        case recEnd:
+            m.winner = e.winner;
+            if(started[e.match])
+                writer.add(m); //в архив попадают только начавшиеся и завершенные партии
+            live.erase(e.match);
+            started.erase(e.match);
+            break;
+        }
+    }
+    uint64_t n = writer.matches();
+    if(!writer.close())
+        return 1;
+    printf("%llu matches archived\n", (unsigned long long)n);
+    return 0;
+}
+
+static void printGrid(const char* title, const double value[100], const char* format)
+{
+    printf("%s\n   ", title);
+    for(int x=0; x<10; x++)
+        printf("%7c", 'A' + x);
+    printf("\n");
+    for(int y=0; y<10; y++)
+    {
+        printf("%3d", y + 1);
+        for(int x=0; x<10; x++)
+            printf(format, value[x + y*10]);
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("seaBattle-query");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sea Battle match archive queries");
+    parser.addHelpOption();
+    parser.addPositionalArgument("archive", "Archive file.");
+    QCommandLineOption buildOption("build", "Build the archive from a server journal directory.", "journal");
+    QCommandLineOption queryOption(QStringList() << "q" << "query", "summary, first (first-shot heatmap), hits (hit rate by cell), ships (placement frequency).", "name", "summary");
+    QCommandLineOption sideOption("side", "Only shots or boards of this side, -1 for both.", "n", "-1");
+    QCommandLineOption fromOption("from", "Matches created at or after this time, ms since epoch.", "ms", "0");
+    QCommandLineOption toOption("to", "Matches created at or before this time, ms since epoch.", "ms", "18446744073709551615");
+    QCommandLineOption minMovesOption("min-moves", "Matches with at least this many shots.", "n", "0");
+    QCommandLineOption maxMovesOption("max-moves", "Matches with at most this many shots.", "n", "1000");
+    QCommandLineOption aiOption("ai", "Only matches against the AI.");
+    QCommandLineOption humanOption("human", "Only matches between humans.");
+    parser.addOption(buildOption);
+    parser.addOption(queryOption);
+    parser.addOption(sideOption);
+    parser.addOption(fromOption);
+    parser.addOption(toOption);
+    parser.addOption(minMovesOption);
+    parser.addOption(maxMovesOption);
+    parser.addOption(aiOption);
+    parser.addOption(humanOption);
+    parser.process(a);
+    if(parser.positionalArguments().size() != 1)
+    {
+        parser.showHelp(1);
+    }
+    std::string path = parser.positionalArguments()[0].toStdString();
+    if(parser.isSet(buildOption))
+    {
+        return build(parser.value(buildOption).toStdString(), path);
+    }
+
+    Filter filter;
+    filter.from = parser.value(fromOption).toULongLong();
+    filter.to = parser.value(toOption).toULongLong();
+    filter.minMoves = parser.value(minMovesOption).toInt();
+    filter.maxMoves = parser.value(maxMovesOption).toInt();
+    filter.ai = parser.isSet(aiOption) ? 1 : (parser.isSet(humanOption) ? 0 : -1);
+    int side = parser.value(sideOption).toInt();
+    std::string query = parser.value(queryOption).toStdString();
+    if(query != "summary" && query != "first" && query != "hits" && query != "ships")
+    {
+        qCritical() << "unknown query" << query.c_str();
+        return 1;
+    }
+    bool firstOnly = query == "first";
+
+    Archive archive;
+    if(!archive.open(path))
+    {
+        qCritical() << "cannot open archive";
+        return 1;
+    }
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    uint64_t scanned = 0, selected = 0, skipped = 0;
+    uint64_t bitCounts[2][2][64]; //сторона, младшее/старшее слово, бит
+    memset(bitCounts, 0, sizeof(bitCounts));
+    ShotCounts counts;
+    memset(&counts, 0, sizeof(counts));
+    uint64_t firstShots[100];
+    memset(firstShots, 0, sizeof(firstShots));
+    uint64_t moves = 0, firstWins = 0, aiMatches = 0, aiWins = 0, finished = 0;
+    std::vector<uint64_t> gather;
+    std::vector<uint8_t> take;
+    ShotScratch scratch;
+    for(int b=0; b<archive.blockCount(); b++)
+    {
+        int kind = classify(archive.index(b), filter);
+        if(!kind)
+        {
+            skipped++; //блок отсеян по индексу min/max, его столбцы даже не читаются
+            continue;
+        }
+        BlockView v = archive.block(b);
+        int n = v.count;
+        take.assign(n, 1);
+        if(kind == 2)
+        {
+            for(int i=0; i<n; i++)
+                take[i] = filter.matches(v, i);
+        }
+        for(int i=0; i<n; i++)
+            selected += take[i];
+        if(query == "ships")
+        {
+            for(int s=0; s<2; s++)
+            {
+                if(side >= 0 && s != side)
+                    continue;
+                const uint64_t* columns[2] = { v.shipsLow[s], v.shipsHigh[s] };
+                for(int h=0; h<2; h++)
+                {
+                    const uint64_t* words = columns[h];
+                    if(kind == 2)
+                    {
+                        //часть партий отсеяна: собираем подходящие слова подряд
+                        gather.clear();
+                        for(int i=0; i<n; i++)
+                            if(take[i])
+                                gather.push_back(words[i]);
+                        words = gather.data();
+                    }
+                    positionalPopcount(words, kind == 2 ? gather.size() : n, bitCounts[s][h]);
+                    scanned += n * sizeof(uint64_t);
+                }
+            }
+        } else if(query == "summary") {
+            for(int i=0; i<n; i++)
+            {
+                if(!take[i])
+                    continue;
+                moves += v.shotCount[0][i] + v.shotCount[1][i];
+                if(v.winner[i] >= 0)
+                {
+                    finished++;
+                    firstWins += v.winner[i] == v.first[i];
+                    if(v.aiSide[i] >= 0)
+                        aiWins += v.winner[i] == v.aiSide[i];
+                }
+                aiMatches += v.aiSide[i] >= 0;
+            }
+            scanned += n * 5;
+        } else {
+            for(int s=0; s<2; s++)
+            {
+                if(side >= 0 && s != side)
+                    continue;
+                scanned += n + v.shotWords[s] * sizeof(uint64_t) + (firstOnly ? 0 : 2 * n * sizeof(uint64_t));
+                if(!firstOnly)
+                {
+                    countShots(v, s, take.data(), counts, scratch);
+                    continue;
+                }
+                uint64_t position = 0;
+                for(int i=0; i<n; i++)
+                {
+                    int count = v.shotCount[s][i];
+                    if(take[i] && count)
+                    {
+                        ShotUnpacker unpack(v.shots[s], position);
+                        firstShots[unpack.next()]++; //первая разность отсчитана от 0 - это сама клетка
+                    }
+                    position += count;
+                }
+            }
+        }
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    double grid[100];
+    if(query == "ships")
+    {
+        uint64_t boards = selected * (side >= 0 ? 1 : 2);
+        for(int c=0; c<100; c++)
+        {
+            uint64_t k = 0;
+            for(int s=0; s<2; s++)
+                k += c < 64 ? bitCounts[s][0][c] : bitCounts[s][1][c - 64];
+            grid[c] = boards ? 100.0 * k / boards : 0;
+        }
+        printGrid("ship placement frequency, % of boards", grid, "%7.2f");
+    } else if(query == "first") {
+        uint64_t total = 0;
+        for(int c=0; c<100; c++)
+            total += firstShots[c];
+        for(int c=0; c<100; c++)
+            grid[c] = total ? 100.0 * firstShots[c] / total : 0;
+        printGrid("first shot heatmap, % of first shots", grid, "%7.2f");
+    } else if(query == "hits") {
+        for(int c=0; c<100; c++)
+        {
+            uint64_t k = counts.shots[c >> 6][c & 63];
+            grid[c] = k ? 100.0 * counts.hits[c >> 6][c & 63] / k : 0;
+        }
+        printGrid("hit rate by cell, % of shots at the cell", grid, "%7.2f");
+    } else {
+        printf("matches %llu, mean shots %.2f, first mover wins %.2f%%, ai matches %llu, ai wins %.2f%%\n",
+               (unsigned long long)selected, selected ? (double)moves / selected : 0,
+               finished ? 100.0 * firstWins / finished : 0, (unsigned long long)aiMatches,
+               aiMatches ? 100.0 * aiWins / aiMatches : 0);
+    }
+    printf("%llu of %llu matches, %llu of %d blocks skipped by index, %.1f MB scanned in %.2f ms (%.0f MB/s)\n",
+           (unsigned long long)selected, (unsigned long long)archive.matchCount(), (unsigned long long)skipped,
+           archive.blockCount(), scanned / 1e6, sec * 1e3, sec > 0 ? scanned / sec / 1e6 : 0);
+    return 0;
+}
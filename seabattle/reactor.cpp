@@ -0,0 +1,80 @@
+#include "reactor.h"
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+Reactor::Reactor()
+{
+    _epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(_epfd == -1)
+    {
+        perror("epoll_create1");
+    }
+}
+
+Reactor::~Reactor()
+{
+    if(_epfd != -1)
+    {
+        close(_epfd);
+    }
+}
+
+bool Reactor::add(int fd, IoHandler* handler, uint32_t events)
+{
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = handler;
+    if(epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+        perror("epoll_ctl add");
+        return false;
+    }
+    return true;
+}
+
+bool Reactor::modify(int fd, IoHandler* handler, uint32_t events)
+{
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = handler;
+    return epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void Reactor::remove(int fd)
+{
+    epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, NULL); //ядро само убирает закрытые дескрипторы, ошибку не проверяем
+}
+
+int Reactor::poll(int timeoutMs)
+{
+    int n = epoll_wait(_epfd, _events, maxEvents, timeoutMs);
+    if(n < 0)
+    {
+        if(errno != EINTR)
+        {
+            perror("epoll_wait");
+        }
+        return 0;
+    }
+    for(int i=0; i<n; i++)
+    {
+        IoHandler* handler = static_cast<IoHandler*>(_events[i].data.ptr);
+        uint32_t ev = _events[i].events;
+        //разрыв соединения тоже отдаем в onReadable: recv вернет 0 или ошибку
+        if(ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            handler->onReadable();
+        }
+        //данные и FIN приходят одним фронтом: onReadable мог выйти после короткого чтения, не дойдя до recv, вернувшего 0
+        if(ev & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            handler->onHangup();
+        }
+        if(ev & EPOLLOUT)
+        {
+            handler->onWritable();
+        }
+    }
+    return n;
+}
@@ -0,0 +1,34 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+#include <sys/epoll.h>
+#include <stdint.h>
+
+//обработчик событий на дескрипторе
+class IoHandler
+{
+public:
+    virtual ~IoHandler() {}
+    virtual void onReadable() = 0; //пришли данные (или соединение закрыто)
+    virtual void onWritable() {} //в буфере отправки освободилось место
+    virtual void onHangup() {} //собеседник закрыл соединение или ошибка, после onReadable того же события
+};
+
+//edge-triggered цикл событий на epoll
+class Reactor
+{
+public:
+    Reactor();
+    ~Reactor();
+    int fd() const { return _epfd; } //дескриптор epoll, можно отдать в QSocketNotifier
+    bool add(int fd, IoHandler* handler, uint32_t events = EPOLLIN | EPOLLRDHUP | EPOLLET);
+    bool modify(int fd, IoHandler* handler, uint32_t events);
+    void remove(int fd);
+    int poll(int timeoutMs); //ожидание и разбор готовых событий, возвращает их количество
+
+private:
+    static const int maxEvents = 256;
+    int _epfd;
+    struct epoll_event _events[maxEvents];
+};
+
+#endif // REACTOR_H
@@ -0,0 +1,206 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <stdio.h>
+#include <map>
+#include <vector>
+#include "journal.h"
+#include "game.h"
+#include "aiplayer.h"
+#include "rng.h"
+
+//восстановление партий по журналу сервера: состояние собирается заново по правилам Game,
+//а исход каждого выстрела, первый ход и ходы компьютера сверяются с записанными
+struct Replay
+{
+    explicit Replay(int id) : id(id), seed(0), time(0), aiSide(-1), started(false), ended(false), moves(0), winner(-1),
+               mismatches(0), ai(0) { game.clear(); aiView.clear(); }
+    ~Replay() { delete ai; }
+    int id;
+    uint64_t seed;
+    uint64_t time;
+    Game game;
+    int aiSide;
+    bool started;
+    bool ended;
+    int moves;
+    int winner;
+    int mismatches;
+    Rng rng; //повторяет генератор партии на сервере
+    AiPlayer* ai;
+    Knowledge aiView;
+};
+
+static const char* kindNames[] = { "miss", "hit", "kill", "repeat" };
+
+static void printBoards(const Game& game)
+{
+    printf("    side 0         side 1\n");
+    for(int y=0; y<10; y++)
+    {
+        printf("    ");
+        for(int side=0; side<2; side++)
+        {
+            const Board& b = game.boards[side];
+            for(int x=0; x<10; x++)
+            {
+                int c = x + y*10;
+                char ch = '.';
+                if(bits::test(b.ships, c))
+                    ch = bits::test(b.hits, c) ? 'X' : '#';
+                else if(bits::test(b.misses, c))
+                    ch = 'o';
+                putchar(ch);
+            }
+            printf("     ");
+        }
+        putchar('\n');
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("seaBattle-replay");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sea Battle journal replay");
+    parser.addHelpOption();
+    parser.addPositionalArgument("journal", "Journal directory written by seaBattle-server --journal.");
+    QCommandLineOption matchOption(QStringList() << "m" << "match", "Print the moves and final boards of one match.", "id", "0");
+    parser.addOption(matchOption);
+    parser.process(a);
+    if(parser.positionalArguments().size() != 1)
+    {
+        parser.showHelp(1);
+    }
+    int selected = parser.value(matchOption).toInt();
+
+    JournalReader reader;
+    if(!reader.open(parser.positionalArguments()[0].toStdString()))
+    {
+        qCritical() << "cannot open journal";
+        return 1;
+    }
+    //номера партий начинаются заново при каждом запуске сервера, поэтому партия - это
+    //последняя открытая recMatch с таким номером
+    std::vector<Replay*> matches;
+    std::map<int, Replay*> live;
+    JournalEntry e;
+    uint64_t records = 0, shots = 0;
+    while(reader.next(e))
+    {
+        records++;
+        Replay*& r = live[e.match];
+        if(!r || e.type == recMatch)
+        {
+            r = new Replay(e.match);
+            matches.push_back(r);
+        }
+        bool show = e.match == selected;
+        switch(e.type)
+        {
+        case recMatch:
+            r->seed = e.seed;
+            r->time = e.time;
+            r->rng.setSeed(e.seed);
+            if(show)
+                printf("match %d seed %llu\n", e.match, (unsigned long long)e.seed);
+            break;
+        case recArrange:
+            r->game.boards[e.side].clear();
+            r->game.boards[e.side].ships = e.ships;
+            if(show)
+                printf("arrange side %d\n", e.side);
+            break;
+        case recStart:
+        {
+            //тот же порядок обращений к генератору, что на сервере: компьютер, затем жребий
+            if(e.aiSide >= 0)
+            {
+                r->aiSide = e.aiSide;
+                r->ai = new AiPlayer(r->rng());
+                if(r->ai->arrange() != r->game.boards[e.aiSide].ships)
+                    r->mismatches++;
+            }
+            int first = r->rng.below(2) ? 0 : 1;
+            if(first != e.turn)
+                r->mismatches++;
+            r->game.turn = e.turn;
+            r->started = true;
+            if(show)
+                printf("start, side %d moves first%s\n", e.turn, e.aiSide >= 0 ? ", vs AI" : "");
+            break;
+        }
+        case recShot:
+        {
+            shots++;
+            r->moves++;
+            if(r->game.turn != e.side)
+                r->mismatches++;
+            if(e.side == r->aiSide && r->ai && r->ai->chooseShot(r->aiView) != e.cell)
+                r->mismatches++; //компьютер по тому же зерну выбрал бы другую клетку
+            r->game.turn = e.side;
+            ShotResult shot = r->game.fire(e.cell);
+            if(e.side == r->aiSide)
+                r->aiView.apply(e.cell, shot);
+            if(shot.kind != e.kind)
+                r->mismatches++;
+            if(show)
+                printf("%4d side %d -> %c%d %s\n", r->moves, e.side, 'A' + e.cell % 10, e.cell / 10 + 1,
+                       kindNames[e.kind]);
+            break;
+        }
+        case recEnd:
+            r->ended = true;
+            r->winner = e.winner;
+            if(e.winner >= 0 && !e.forfeit && e.winner != r->game.winner())
+                r->mismatches++;
+            if(show)
+                printf(e.winner >= 0 ? (e.forfeit ? "winner side %d by forfeit\n" : "winner side %d\n") : "aborted\n", e.winner);
+            break;
+        }
+    }
+    if(reader.corrupt())
+        printf("warning: journal ends with a damaged record\n");
+
+    int bad = 0;
+    int found = 0;
+    if(!selected)
+        printf("%8s %20s %6s %6s %6s %10s\n", "match", "seed", "ai", "moves", "winner", "mismatches");
+    for(size_t i=0; i<matches.size(); i++)
+    {
+        Replay* r = matches[i];
+        if(selected)
+        {
+            if(r->id != selected)
+                continue;
+            found++;
+            printBoards(r->game);
+            printf("mismatches %d\n", r->mismatches);
+            bad += r->mismatches;
+            continue;
+        }
+        const char* state = r->ended ? (r->winner >= 0 ? "" : "abort") : (r->started ? "live" : "wait");
+        if(*state)
+            printf("%8d %20llu %6d %6d %6s %10d\n", r->id, (unsigned long long)r->seed, r->aiSide,
+                   r->moves, state, r->mismatches);
+        else
+            printf("%8d %20llu %6d %6d %6d %10d\n", r->id, (unsigned long long)r->seed, r->aiSide,
+                   r->moves, r->winner, r->mismatches);
+        bad += r->mismatches;
+    }
+    if(selected && !found)
+    {
+        qCritical() << "no such match";
+        return 1;
+    }
+    if(!selected)
+    {
+        printf("%llu records, %llu shots, %d matches, %d mismatches\n", (unsigned long long)records,
+               (unsigned long long)shots, (int)matches.size(), bad);
+    }
+    for(size_t i=0; i<matches.size(); i++)
+        delete matches[i];
+    return bad ? 2 : 0;
+}
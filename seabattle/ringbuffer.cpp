@@ -0,0 +1,102 @@
+#include "ringbuffer.h"
+#include <sys/uio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+RingBuffer::RingBuffer(int capacity)
+{
+    _capacity = capacity;
+    _data = new char[capacity];
+    _head = 0;
+    _tail = 0;
+}
+
+RingBuffer::~RingBuffer()
+{
+    delete[] _data;
+}
+
+void RingBuffer::swap(RingBuffer& other)
+{
+    std::swap(_data, other._data);
+    std::swap(_capacity, other._capacity);
+    std::swap(_head, other._head);
+    std::swap(_tail, other._tail);
+}
+
+int RingBuffer::fill(int fd)
+{
+    int free = space();
+    if(free == 0)
+    {
+        errno = ENOBUFS;
+        return -1;
+    }
+    uint32_t mask = _capacity - 1;
+    uint32_t start = _tail & mask;
+    struct iovec iov[2];
+    int cnt = 1;
+    iov[0].iov_base = _data + start;
+    if((int)start + free <= _capacity)
+    {
+        iov[0].iov_len = free;
+    } else {
+        //свободное место разорвано концом массива: читаем в оба куска за один вызов
+        iov[0].iov_len = _capacity - start;
+        iov[1].iov_base = _data;
+        iov[1].iov_len = free - iov[0].iov_len;
+        cnt = 2;
+    }
+    int n;
+    do {
+        n = readv(fd, iov, cnt);
+    } while(n < 0 && errno == EINTR);
+    if(n > 0)
+    {
+        _tail += n;
+    }
+    return n;
+}
+
+void RingBuffer::peek(char* dst, int n, int offset) const
+{
+    uint32_t mask = _capacity - 1;
+    uint32_t start = (_head + offset) & mask;
+    int first = _capacity - start;
+    if(first >= n)
+    {
+        memcpy(dst, _data + start, n);
+    } else {
+        memcpy(dst, _data + start, first);
+        memcpy(dst + first, _data, n - first);
+    }
+}
+
+int RingBuffer::append(const char* src, int n)
+{
+    n = std::min(n, space());
+    uint32_t mask = _capacity - 1;
+    uint32_t start = _tail & mask;
+    int first = _capacity - start;
+    if(first >= n)
+    {
+        memcpy(_data + start, src, n);
+    } else {
+        memcpy(_data + start, src, first);
+        memcpy(_data, src + first, n - first);
+    }
+    _tail += n;
+    return n;
+}
+
+const char* RingBuffer::contiguous(int n, int offset, char* scratch) const
+{
+    uint32_t start = (_head + offset) & (_capacity - 1);
+    if((int)start + n <= _capacity)
+    {
+        return _data + start;
+    }
+    peek(scratch, n, offset);
+    return scratch;
+}
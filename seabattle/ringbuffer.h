@@ -0,0 +1,30 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+#include <stdint.h>
+
+//кольцевой буфер приема: заполняется одним readv прямо из сокета
+class RingBuffer
+{
+public:
+    explicit RingBuffer(int capacity = 4096); //capacity - степень двойки
+    ~RingBuffer();
+    int size() const { return (int)(_tail - _head); } //сколько байт принято и не разобрано
+    int space() const { return _capacity - size(); }
+    int fill(int fd); //прочитать из сокета все, что влезет; как recv: >0, 0 - закрыт, -1 - ошибка
+    void peek(char* dst, int n, int offset = 0) const; //скопировать n байт, не забирая их
+    int append(const char* src, int n); //дописать байты не из сокета, возвращает сколько влезло
+    const char* contiguous(int n, int offset, char* scratch) const; //n байт одним куском (при разрыве - копия в scratch)
+    void consume(int n) { _head += n; }
+    void clear() { _head = _tail = 0; }
+    void swap(RingBuffer& other); //обменяться содержимым без копирования
+
+private:
+    RingBuffer(const RingBuffer&);
+    RingBuffer& operator=(const RingBuffer&);
+    char* _data;
+    int _capacity;
+    uint32_t _head; //позиции растут монотонно, индекс - по маске
+    uint32_t _tail;
+};
+
+#endif // RINGBUFFER_H
@@ -0,0 +1,74 @@
+#ifndef RNG_H
+#define RNG_H
+#include <stdint.h>
+
+//генератор xoshiro256**: быстрый, с маленьким состоянием и полностью воспроизводимый по зерну.
+//У каждой партии, бота и потока свой экземпляр - общего состояния, как у rand(), нет.
+//Подходит для std::shuffle и распределений <random>
+class Rng
+{
+public:
+    typedef uint64_t result_type;
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return ~(uint64_t)0; }
+
+    explicit Rng(uint64_t seed = 1) { setSeed(seed); }
+    void setSeed(uint64_t seed)
+    {
+        //состояние разворачивается из зерна через splitmix64, так что подходит любое зерно, даже 0
+        for(int i=0; i<4; i++)
+        {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            _s[i] = z ^ (z >> 31);
+        }
+    }
+    uint64_t operator()()
+    {
+        uint64_t result = rotl(_s[1] * 5, 7) * 9;
+        uint64_t t = _s[1] << 17;
+        _s[2] ^= _s[0];
+        _s[3] ^= _s[1];
+        _s[1] ^= _s[2];
+        _s[0] ^= _s[3];
+        _s[2] ^= t;
+        _s[3] = rotl(_s[3], 45);
+        return result;
+    }
+    uint32_t below(uint32_t n) //от 0 до n-1 умножением вместо деления (метод Лемира), смещение не больше n/2^32
+    {
+        return (uint32_t)(((uint64_t)(uint32_t)((*this)() >> 32) * n) >> 32);
+    }
+    void jump(); //пропустить 2^128 значений: независимые потоки из одного зерна
+    void state(uint64_t out[4]) const { for(int i=0; i<4; i++) out[i] = _s[i]; } //продолжить последовательность в другом процессе
+    void setState(const uint64_t in[4]) { for(int i=0; i<4; i++) _s[i] = in[i]; }
+
+private:
+    uint64_t _s[4];
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+inline void Rng::jump()
+{
+    static const uint64_t table[4] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                       0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+    uint64_t s[4] = { 0, 0, 0, 0 };
+    for(int i=0; i<4; i++)
+    {
+        for(int b=0; b<64; b++)
+        {
+            if(table[i] & ((uint64_t)1 << b))
+            {
+                for(int j=0; j<4; j++)
+                    s[j] ^= _s[j];
+            }
+            (*this)();
+        }
+    }
+    for(int j=0; j<4; j++)
+        _s[j] = s[j];
+}
+
+#endif // RNG_H
@@ -0,0 +1,34 @@
+# Собирает клиент, выделенный сервер и утилиты в одной папке сборки
+
+TEMPLATE = subdirs
+
+SUBDIRS += client server
+
+client.file = seaBattle.pro
+client.makefile = Makefile.client
+server.file = seaBattle-server.pro
+server.makefile = Makefile.server
+
+SUBDIRS += loadgen
+loadgen.file = seaBattle-loadgen.pro
+loadgen.makefile = Makefile.loadgen
+
+SUBDIRS += bench
+bench.file = seaBattle-bench.pro
+bench.makefile = Makefile.bench
+
+SUBDIRS += sim
+sim.file = seaBattle-sim.pro
+sim.makefile = Makefile.sim
+
+SUBDIRS += replay
+replay.file = seaBattle-replay.pro
+replay.makefile = Makefile.replay
+
+SUBDIRS += query
+query.file = seaBattle-query.pro
+query.makefile = Makefile.query
+
+SUBDIRS += test
+test.file = seaBattle-test.pro
+test.makefile = Makefile.test
@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# Microbenchmarks of the shot-resolution and placement hot paths
+# and of the match snapshot used for warm restart
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = seaBattle-bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += thread
+
+# снимок партий использует реестр сервера, а с ним и остальную серверную часть
+OBJECTS_DIR = .obj-bench
+MOC_DIR = .moc-bench
+
+SOURCES += bench.cpp \
+    solver.cpp \
+    workpool.cpp
+
+HEADERS += solver.h \
+    workpool.h
+
+include(server.pri)
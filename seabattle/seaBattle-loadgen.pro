@@ -0,0 +1,37 @@
+#-------------------------------------------------
+#
+# Load generator: headless bots playing against the server
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = seaBattle-loadgen
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .obj-loadgen
+MOC_DIR = .moc-loadgen
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += loadgen.cpp \
+    bot.cpp \
+    client.cpp \
+    fleet.cpp \
+    bitboard.cpp \
+    histogram.cpp \
+    protocol.cpp \
+    ringbuffer.cpp \
+    outqueue.cpp
+
+HEADERS += bot.h \
+    client.h \
+    fleet.h \
+    bitboard.h \
+    rng.h \
+    histogram.h \
+    protocol.h \
+    ringbuffer.h \
+    outqueue.h
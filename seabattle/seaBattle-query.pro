@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# Match archive: columnar storage and analytical scans
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = seaBattle-query
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .obj-query
+MOC_DIR = .moc-query
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# циклы сканирования рассчитаны на автовекторизацию
+QMAKE_CXXFLAGS_RELEASE += -O3
+
+SOURCES += query.cpp \
+    archive.cpp \
+    journal.cpp \
+    bitboard.cpp
+
+HEADERS += archive.h \
+    journal.h \
+    bitboard.h
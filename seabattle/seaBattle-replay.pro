@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# Journal replay: rebuilds matches from the server journal
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = seaBattle-replay
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .obj-replay
+MOC_DIR = .moc-replay
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += replay.cpp \
+    journal.cpp \
+    game.cpp \
+    aiplayer.cpp \
+    fleet.cpp \
+    bitboard.cpp
+
+HEADERS += journal.h \
+    game.h \
+    aiplayer.h \
+    fleet.h \
+    bitboard.h \
+    rng.h
@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Headless dedicated server: QtCore only, no GUI resources
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = seaBattle-server
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+# своя папка для объектов, чтобы не пересекаться с клиентом в общей сборке
+OBJECTS_DIR = .obj-server
+MOC_DIR = .moc-server
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += servermain.cpp \
+    cluster.cpp
+
+HEADERS += cluster.h
+
+include(server.pri)
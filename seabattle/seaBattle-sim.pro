@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# Tournament simulator: strategies play each other in memory
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = seaBattle-sim
+TEMPLATE = app
+CONFIG += console thread
+CONFIG -= app_bundle
+
+OBJECTS_DIR = .obj-sim
+MOC_DIR = .moc-sim
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += sim.cpp \
+    game.cpp \
+    strategy.cpp \
+    aiplayer.cpp \
+    solver.cpp \
+    workpool.cpp \
+    fleet.cpp \
+    bitboard.cpp
+
+HEADERS += game.h \
+    strategy.h \
+    aiplayer.h \
+    solver.h \
+    workpool.h \
+    fleet.h \
+    bitboard.h \
+    rng.h
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Self-checks of the server code that needs neither
+# the network nor Qt: fleet validation and the frame codec
+#
+#-------------------------------------------------
+
+TARGET = seaBattle-test
+TEMPLATE = app
+# testcase: make check запускает проверки после сборки
+CONFIG += console testcase
+CONFIG -= app_bundle qt
+
+OBJECTS_DIR = .obj-test
+
+SOURCES += tests.cpp \
+    fleet.cpp \
+    bitboard.cpp \
+    protocol.cpp \
+    ringbuffer.cpp
+
+HEADERS += fleet.h \
+    bitboard.h \
+    rng.h \
+    protocol.h \
+    ringbuffer.h
@@ -26,15 +26,13 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += main.cpp\
         mainwindow.cpp \
     mypoint.cpp \
-    client.cpp \
-    server.cpp \
-    servclient.cpp
+    client.cpp
 
 HEADERS  += mainwindow.h \
     mypoint.h \
-    client.h \
-    server.h \
-    servclient.h
+    client.h
+
+include(server.pri)
 
 FORMS    += mainwindow.ui
 
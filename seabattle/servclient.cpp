@@ -1,70 +1,399 @@
 #include "servclient.h"
+#include "fleet.h"
+#include "metrics.h"
+#include "trace.h"
+#include <errno.h>
+#include <string.h>
 
-ServClient::ServClient(int sock, Server *parent): QObject(parent)
+//пределы очереди отправки: выше highWater перестаем читать команды клиента,
+//ниже lowWater снова читаем, выше maxQueue клиент считается зависшим и отключается
+static const int highWater = 64*1024;
+static const int lowWater = 16*1024;
+static const int maxQueue = 1024*1024;
+
+ServClient::ServClient()
 {
-    _sock = sock;
-    _serv = parent;
-    byteAv = 0;
-    for(int i=0; i<100; i++)
+    _sock = -1;
+    _serv = 0;
+    _match = 0;
+    _side = 0;
+    _dirty = false;
+    _waitWrite = false;
+    _paused = false;
+    _hangup = false;
+    _trace = false;
+    _traceSelf = false;
+    _waiter.client = this;
+    memset(_fleet, 0, sizeof(_fleet));
+}
+
+ServClient::~ServClient()
+{
+    if(_sock != -1)
     {
-        nowDamage[i]=0;
+        close(_sock); //сервер остановлен с открытыми соединениями
     }
-    buf[0]=-1;
+}
+
+void ServClient::open(int sock, Server* server)
+{
+    //ячейка могла обслуживать другое соединение: буферы пусты, но память за ними осталась
+    _sock = sock;
+    _serv = server;
+    _match = 0;
+    _side = 0;
+    _dirty = false;
+    _waitWrite = false;
+    _paused = false;
+    _hangup = false;
+    _trace = false;
+    _traceSelf = false;
+    memset(_fleet, 0, sizeof(_fleet));
+    _in.clear();
+    _out.clear();
     int flags = 1;
     ioctl(_sock,FIONBIO,&flags); // опять же, чтобы не зависал I/O
+    _serv->reactor()->add(_sock, this);
+    armDeadline(); //не прислал расстановку вовремя - отключаем
 }
 
-void ServClient::readData(char* data, int byteCount) //считывание данных с сокета
+void ServClient::armDeadline()
 {
-    int bytesRead=0;
-    bytesRead = recv(_sock, data, byteCount, 0); // принимаем сообщение от клиента
-    if(bytesRead <= 0)
+    if(_sock == -1 || (_match && _match->started))
     {
+        _deadline.cancel(); //ход в партии отсчитывает таймер партии
         return;
     }
+    const ServerConfig& config = _serv->config();
+    bool waiting = Matchmaker::isWaiting(&_waiter); //расстановка принята, ждем соперника
+    int seconds = waiting ? config.idleTimeout : config.placementTimeout;
+    if(seconds > 0)
+        _serv->timers()->arm(&_deadline, this, seconds * 1000);
+    else
+        _deadline.cancel();
 }
 
-void ServClient::checkSock() //проверка доступных байтов
+void ServClient::onTimer(Timer*)
 {
-    if(byteAv||ioctl(_sock,FIONREAD,&byteAv)<0)
+    if(_serv->isFrozen())
+    {
+        _serv->timers()->arm(&_deadline, this, 1000); //соединение передается новому процессу, решать ему
+        return;
+    }
+    Metrics::add(ctrReaped);
+    closeSock();
+}
+
+void ServClient::sendFrame(int command, const char* payload, int length)
+{
+    if(_sock == -1)
+        return;
+    uint64_t started = _trace ? Metrics::ticks() : 0;
+    int size = encodeFrame(_out.reserve(frameHeaderSize + length), command, payload, length);
+    _out.commit(size);
+    if(_trace)
+        Trace::record(spanSend, traceMatch(), _sock, started);
+    if(_out.size() > highWater)
+    {
+        _paused = true; //проверка на каждом кадре: при _waitWrite flush очередь не смотрит
+    }
+    if(!_dirty)
+    {
+        _dirty = true;
+        _serv->markDirty(this); //отправим вместе с остальными кадрами этого прохода
+    }
+}
+
+void ServClient::flush()
+{
+    _dirty = false;
+    if(_sock == -1)
+        return;
+    if(_out.size() > maxQueue)
+    {
+        //закрываем здесь, а не в sendFrame: там соединение может быть посреди разбора хода
+        qDebug()<<"client is not reading, disconnect";
+        closeSock();
+        return;
+    }
+    if(_waitWrite)
+        return; //отправит onWritable
+    int queued = _out.size();
+    uint64_t started = _trace ? Metrics::ticks() : 0;
+    int r = _out.flush(_sock);
+    if(_trace)
+        Trace::record(spanFlush, traceMatch(), _sock, started);
+    if(r < 0)
     {
-        if(buf[0]==-1)
+        closeSock();
+        return;
+    }
+    Metrics::add(ctrBytesOut, queued - _out.size());
+    if(r == 0)
+    {
+        //буфер ядра полон: дождемся EPOLLOUT
+        Metrics::add(ctrPartialWrites);
+        _waitWrite = true;
+        _serv->reactor()->modify(_sock, this, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+        return;
+    }
+    if(_paused)
+    {
+        _paused = false; //очередь ушла целиком за один проход, EPOLLOUT ждать не нужно
+        onReadable();
+    }
+}
+
+void ServClient::onWritable()
+{
+    if(_sock == -1 || !_waitWrite)
+        return;
+    int queued = _out.size();
+    uint64_t started = _trace ? Metrics::ticks() : 0;
+    int r = _out.flush(_sock);
+    if(_trace)
+        Trace::record(spanFlush, traceMatch(), _sock, started);
+    if(r < 0)
+    {
+        closeSock();
+        return;
+    }
+    Metrics::add(ctrBytesOut, queued - _out.size());
+    if(r == 0)
+    {
+        Metrics::add(ctrPartialWrites);
+        return; //снова заполнили буфер ядра, ждем следующего EPOLLOUT
+    }
+    _waitWrite = false;
+    _serv->reactor()->modify(_sock, this, EPOLLIN | EPOLLRDHUP | EPOLLET);
+    if(_paused && _out.size() < lowWater)
+    {
+        _paused = false;
+        onReadable(); //дочитываем то, что накопилось, пока стояли
+    }
+}
+
+void ServClient::onReadable() //вычитываем все, что есть в сокете (edge-triggered)
+{
+    while(_sock != -1 && !_paused && !_serv->isFrozen())
+    {
+        int free = _in.space();
+        uint64_t started = _trace ? Metrics::ticks() : 0;
+        int bytesRead = _in.fill(_sock); //один readv на все свободное место буфера
+        if(_trace)
+            Trace::record(spanRecv, traceMatch(), _sock, started);
+        if(bytesRead > 0)
         {
-            readData(buf,1);
-            ioctl(_sock,FIONREAD,&byteAv);
+            Metrics::add(ctrBytesIn, bytesRead);
+            checkSock();
+            if(bytesRead < free && !_hangup)
+            {
+                return; //сокет вычитан до конца, о новых данных сообщит следующее событие
+            }
+            continue;
         }
-        int size;
-        size = (buf[0]==comArrange)?100:1;
-        if(byteAv<size)
+        if(bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
         {
-            ioctl(_sock,FIONREAD,&byteAv);
+            return; //данных больше нет, ждем следующего события
+        }
+        closeSock(); //соединение закрыто клиентом или ошибка
+    }
+}
+
+void ServClient::onHangup()
+{
+    if(_sock == -1)
+        return;
+    _hangup = true; //и для чтения после паузы или заморозки: нового фронта уже не будет
+    onReadable();
+}
+
+void ServClient::checkSock() //разбор всех целых кадров, пришедших за одно пробуждение
+{
+    Frame frame;
+    int r;
+    uint64_t started = Metrics::ticks(); //конец одного кадра - начало следующего, один замер на кадр
+    //у замороженного сервера принятые кадры остаются в буфере и переходят к новому процессу
+    while(_sock != -1 && !_serv->isFrozen() && (r = decodeFrame(_in, frame, _scratch)) != 0)
+    {
+        if(r < 0)
+        {
+            qDebug()<<"protocol error";
+            closeSock();
             return;
         }
-        readData(&buf[1],size);
-        switch(buf[0]){
+        if(_trace)
+            Trace::record(spanDecode, traceMatch(), _sock, started); //от конца прошлого кадра, как и замер метрик
+        switch(frame.command){
         case comDot:
         {
-            int cell = buf[1];
-            _serv->sendShoot(_sock, cell);
+            if(frame.length < 1)
+                break;
+            int cell = frame.payload[0];
+            _serv->sendShoot(this, cell);
         }
             break;
         case comArrange:
         {
-            for(int i=0; i<100; i++)
+            if(frame.length < 100)
+                break;
+            uint64_t validated = _trace ? Metrics::ticks() : 0;
+            char error = validateField(frame.payload); //полю клиента не доверяем
+            if(_trace)
+                Trace::record(spanArrange, traceMatch(), _sock, validated);
+            if(error != fleetOk)
+            {
+                sendFrame(comArrangeError, &error, 1);
+                break;
+            }
+            if(_match)
+            {
+                break; //расстановку во время игры не меняем
+            }
+            _serv->matchmaker()->cancel(&_waiter); //новая расстановка: старый билет больше никто не заберет
+            memcpy(_fleet, frame.payload, sizeof(_fleet));
+            bool vsAi = frame.length > 100 && frame.payload[100] == arrangeVsAi;
+            if(!vsAi)
             {
-                field[i] = buf[i+1];
+                int bucket = frame.length > 101 ? (unsigned char)frame.payload[101] : 0;
+                _serv->findOpponent(this, bucket);
+                break;
             }
-            _serv->doStartGame();
+            if(!_serv->matches()->attachAi(this)) //вместо второго ServClient садится компьютер
+            {
+                char cell = 0;
+                sendFrame(comError, &cell, 1); //свободных партий нет
+                armDeadline(); //из очереди вышли, снова срок расстановки
+                break;
+            }
+            _serv->doStartGame(this);
         }
             break;
+        case comResume:
+            if(frame.length < resumeTokenSize)
+                break;
+            _serv->resumeSession(this, frame.payload); //может отдать сокет потоку партии
+            break;
         default:
             break;
         }
-        buf[0]=-1;
-        ioctl(_sock,FIONREAD,&byteAv);
+        started = Metrics::recordFrame(frame.command, started); //вместе с разбором и ответами в очереди
+    }
+}
+
+void ServClient::closeSock()
+{
+    if(_sock == -1)
+        return;
+    Metrics::add(ctrClosed);
+    _serv->matchmaker()->retire(&_waiter);
+    _serv->leave(this); //место в партии держится или соперник получает победу
+    _serv->reactor()->remove(_sock);
+    close(_sock);
+    _sock = -1;
+    _deadline.cancel(); //leave мог взвести срок расстановки
+    _in.clear();
+    _out.clear();
+    _serv->retire(this); //в пул - в конце прохода, когда на объект больше никто не ссылается
+}
+
+int ServClient::handOff(RingBuffer& in, OutQueue& out)
+{
+    int sock = _sock;
+    _serv->reactor()->remove(_sock);
+    _sock = -1; //дальше соединение ведет другой поток, этот объект больше не трогает сокет
+    _deadline.cancel();
+    _serv->matchmaker()->retire(&_waiter);
+    _in.swap(in);
+    _out.swap(out);
+    _serv->retire(this);
+    return sock;
+}
+
+void ServClient::adopt(RingBuffer& in, OutQueue& out, const char* fleet, bool traced)
+{
+    _in.swap(in);
+    _out.swap(out);
+    memcpy(_fleet, fleet, sizeof(_fleet));
+    setTraced(traced);
+    if(!_out.isEmpty() && !_dirty)
+    {
+        _dirty = true;
+        _serv->markDirty(this);
+    }
+}
+
+void ServClient::resume()
+{
+    checkSock();
+    onReadable(); //о данных, пришедших во время переезда, epoll мог сообщить еще старому потоку
+}
+
+void ServClient::detach()
+{
+    if(_sock != -1)
+        _serv->reactor()->remove(_sock);
+}
+
+void ServClient::reattach()
+{
+    if(_sock != -1)
+        _serv->reactor()->add(_sock, this, _waitWrite ? EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET : EPOLLIN | EPOLLRDHUP | EPOLLET);
+}
+
+void ServClient::save(StateWriter& out, bool queued) const
+{
+    out.putFd(_sock);
+    out.put8(_traceSelf | queued << 1);
+    if(queued)
+    {
+        out.put8(_waiter.bucket);
+        out.putBytes(_fleet, sizeof(_fleet));
     }
+    out.put32(_in.size());
+    _in.peek(out.grow(_in.size()), _in.size());
+    out.put32(_out.size());
+    _out.peek(out.grow(_out.size()));
 }
-char ServClient::getCell(int cell) //получение клетки
+
+bool ServClient::load(StateReader& in, Server* server, bool& queued)
 {
-    return field[cell];
+    int sock = in.getFd();
+    if(sock < 0)
+        return false;
+    open(sock, server);
+    int flags = in.get8();
+    queued = flags & 2;
+    if(queued)
+    {
+        _waiter.bucket = in.get8();
+        in.getBytes(_fleet, sizeof(_fleet));
+    }
+    setTraced(flags & 1);
+    uint32_t size = in.get32();
+    const char* bytes = in.skip(size);
+    if(!bytes || _in.append(bytes, size) != (int)size)
+        return false; //больше буфера приема не бывает: старый процесс читал в такой же
+    size = in.get32();
+    bytes = in.skip(size);
+    if(!bytes)
+        return false;
+    _out.append(bytes, size);
+    if(!_out.isEmpty())
+    {
+        _dirty = true;
+        _serv->markDirty(this);
+    }
+    return true;
+}
+
+void ServClient::setMatch(Match* match, int side)
+{
+    _match = match;
+    _side = side;
+    updateTrace();
+    if(!_match)
+    {
+        armDeadline(); //партия окончена: новый срок на расстановку
+    }
 }
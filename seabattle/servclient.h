@@ -9,32 +9,76 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <termios.h>
-#include <QObject>
-#include <QTimer>
 #include <QDebug>
 #include <string>
-#include "client.h"
+#include "protocol.h"
 #include "server.h"
+#include "reactor.h"
+#include "match.h"
+#include "ringbuffer.h"
+#include "outqueue.h"
+#include "timerwheel.h"
+#include "matchmaker.h"
+#include "pool.h"
+#include "handover.h"
 class Server;
-class ServClient: public QObject
+
+//соединение игрока. Живет в пуле сервера и переиспользуется вместе со своими буферами:
+//после закрытия сервер возвращает его в пул в конце прохода цикла
+class ServClient: public IoHandler, public TimerHandler, public PoolSlot
 {
-    Q_OBJECT
 public:
-    ServClient(int sock,Server* parent = 0);
-    void writeData(char* data);
-    void readData(char* data, int byteCount);
-    char getCell(int cell);
-    char nowDamage[100];
+    ServClient();
+    ~ServClient();
+    void open(int sock, Server* server); //начать обслуживать сокет
+    void sendFrame(int command, const char* payload, int length); //поставить кадр в очередь отправки
+    void flush(); //отправить очередь, вызывается сервером раз за проход цикла
+    void onReadable(); //вызывается epoll, когда пришли данные
+    void onWritable(); //освободилось место в буфере отправки
+    void onHangup(); //клиент закрыл соединение: дочитать сокет до конца и закрыть
+    int sock() const { return _sock; }
+    Server* server() const { return _serv; } //поток-владелец, у ячейки пула не меняется
+    Match* match() const { return _match; }
+    int side() const { return _side; } //номер игрока в партии
+    void setMatch(Match* match, int side);
+    Waiter* waiter() { return &_waiter; }
+    const char* fleet() const { return _fleet; } //последняя принятая расстановка
+    void setTraced(bool on) { _traceSelf = on; updateTrace(); } //трасса этого соединения
+    bool traced() const { return _traceSelf; }
+    void updateTrace() { _trace = _traceSelf || (_match && _match->traced); } //после смены партии или ее флага
+    void armDeadline(); //срок по состоянию: расстановка, ожидание соперника или никакого во время партии
+    void onTimer(Timer* timer); //срок вышел: отключаем
+    int handOff(RingBuffer& in, OutQueue& out); //отдать сокет другому потоку: забрать буферы, вернуть дескриптор
+    void adopt(RingBuffer& in, OutQueue& out, const char* fleet, bool traced); //продолжить соединение, отданное другим потоком
+    void resume(); //разобрать уже принятое и дочитать сокет
+    void closeSock(); //закрыть соединение; место в идущей партии держится для возврата
+    void detach(); //сервер заморожен: сокет вне реактора, данные копятся в ядре
+    void reattach(); //сервер продолжает работу: сокет снова в реакторе
+    //соединение для нового процесса: сокет, буферы и расстановка, если ждет соперника (queued)
+    void save(StateWriter& out, bool queued) const;
+    bool load(StateReader& in, Server* server, bool& queued); //продолжить соединение старого процесса
 
 private:
     int _sock;
-    char buf[100];
-    char field[100];
-    int byteAv;
+    RingBuffer _in; //принятые, но еще не разобранные байты
+    char _scratch[maxFramePayload]; //для кадров, разорванных концом буфера
+    OutQueue _out; //кадры, ждущие отправки
+    bool _dirty; //стоит в списке на отправку у сервера
+    bool _waitWrite; //ждем EPOLLOUT
+    bool _paused; //клиент не забирает данные, перестаем читать его команды
+    bool _hangup; //клиент закрыл соединение: читаем до recv, вернувшего 0, а не до короткого чтения
+    bool _trace; //писать трассу: включена у соединения или у его партии
+    bool _traceSelf;
     Server* _serv;
-
-public slots:
-    void checkSock();
+    Timer _deadline;
+    Waiter _waiter; //место в очереди подбора
+    char _fleet[100]; //проверенная расстановка до начала партии
+    Match* _match;
+    int _side;
+    ServClient(const ServClient&);
+    ServClient& operator=(const ServClient&);
+    uint32_t traceMatch() const { return _match ? _match->id : 0; }
+    void checkSock(); //разбор принятых кадров
 };
 
 #endif // SERVCLIENT_H
@@ -1,17 +1,152 @@
 #include "server.h"
+#include <netinet/tcp.h>
+#include <errno.h>
+#include <random>
+#include <sys/stat.h>
+#include <QHash>
+#include "metrics.h"
+#include "trace.h"
+ServerConfig::ServerConfig()
+{
+    port = 3634;
+    backlog = 128;
+    workers = 1;
+    worker = 0;
+    maxMatches = 0;
+    seed = 0;
+    turnTimeout = 30;
+    placementTimeout = 60;
+    idleTimeout = 300;
+    maxConnections = 0;
+    resumeGrace = 30;
+    listener = -1;
+    metricsListener = -1;
+    snapshotInterval = 10;
+}
 Server::Server()
 {
-    srand(time(0));
-    readyToPlay = false;
+    _notifier = 0;
+    _listener = -1;
+    _traceControl = this;
+    _directory = 0;
+    _matchmaker = 0;
+    _ownMatchmaker = 0;
+    _frozen = false;
+    _snapshotCursor = 0;
+    _snapshotMatches = 0;
+    _snapshotSegment = 0;
+    _snapshotOffset = 0;
+}
+Server::~Server()
+{
+    if(_listener != -1)
+    {
+        close(_listener);
+    }
+    if(_directory && _directory->get(_config.worker) == this)
+    {
+        _directory->set(_config.worker, 0); //возвращающихся игроков сюда больше не отправляют
+    }
+    for(int i=0; i<_held.size(); i++)
+    {
+        HandoverMail* mail = static_cast<HandoverMail*>(_held[i]);
+        close(mail->sock); //передача состоялась, этот процесс завершается
+        delete mail;
+    }
+    delete _ownMatchmaker;
 }
 bool Server::doStartServer(qint16 port) //запуск сервера
 {
+    ServerConfig config;
+    config.port = port;
+    return doStartServer(config);
+}
+bool Server::doStartServer(const ServerConfig& config)
+{
+    _config = config;
+    quint16 port = config.port;
+    bool sharded = config.workers > 1;
+    if(!_matchmaker)
+    {
+        _matchmaker = _ownMatchmaker = new Matchmaker();
+    }
+    //лимит делится между потоками с округлением вверх: партии одного потока другим не видны
+    _matches.setLimit(config.maxMatches > 0 ? (config.maxMatches + config.workers - 1) / config.workers : 0);
+    _matches.setIds(config.worker + 1, config.workers); //номера партий не пересекаются между потоками
+    _sessions.setLimit(config.maxConnections > 0 ? (config.maxConnections + config.workers - 1) / config.workers : 0);
+    std::random_device device;
+    if(!_config.seed)
+    {
+        _config.seed = ((quint64)device() << 32) | device();
+    }
+    _secrets.setSeed(((quint64)device() << 32) | device()); //билет нельзя вывести из зерна сервера в логе
+    _matches.setSeed(_config.seed + config.worker); //Rng разворачивает зерно через splitmix, соседние зерна дают разные последовательности
+    qDebug() << "Server seed" << _config.seed << "worker" << config.worker;
+    if(!config.journalDir.isEmpty())
+    {
+        std::string dir = config.journalDir.toStdString();
+        if(sharded)
+        {
+            mkdir(dir.c_str(), 0755);
+            dir += "/worker-" + std::to_string(config.worker); //у каждого потока свои сегменты
+        }
+        if(!_journal.open(dir))
+        {
+            return false;
+        }
+        _matches.setJournal(&_journal);
+    }
+    if(!_timers.open(&_reactor) || !_mailbox.open(&_reactor, this))
+    {
+        return false;
+    }
+    if((!config.metricsAddress.isEmpty() || config.metricsListener != -1) &&
+       !_metrics.open(config.metricsAddress.toStdString(), &_reactor, &_timers, _traceControl, config.metricsListener))
+    {
+        return false;
+    }
+    if(config.listener != -1)
+    {
+        _listener = config.listener; //сокет старого процесса: соединения из его очереди listen не теряются
+    }
+    else if(!openListener())
+    {
+        return false;
+    }
+    qDebug() << "Server started at" << "127.0.0.1" << ":" << port;
+    _reactor.add(_listener, this, EPOLLIN | EPOLLET);
+    //сокеты обслуживает epoll, а цикл Qt просыпается только когда в нем есть события
+    _notifier = new QSocketNotifier(_reactor.fd(), QSocketNotifier::Read, this);
+    QObject::connect(_notifier,SIGNAL(activated(int)),this,SLOT(checkSock()));
+    if(_directory)
+    {
+        _directory->set(config.worker, this);
+    }
+    if(!config.snapshotDir.isEmpty())
+    {
+        mkdir(config.snapshotDir.toStdString().c_str(), 0755);
+        if(config.listener == -1)
+        {
+            recover(); //при передаче от живого процесса партии придут от него
+        }
+        _timers.arm(&_snapshotTimer, this, config.snapshotInterval * 1000);
+    }
+    return true;
+}
+bool Server::openListener()
+{
+    quint16 port = _config.port;
     _listener = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
     int flags = 1;
     ioctl(_listener,FIONBIO,&flags);
     int yes = 1;
     setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)); //для того, чтобы можно было сразу после выключения сервера
                                                                         //создать его снова на том же адресе
+    if(_config.workers > 1)
+    {
+        //у каждого потока свой сокет на том же порту, ядро раздает соединения между ними по хэшу адресов
+        setsockopt(_listener, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int));
+    }
 
     /* SO_REUSEADDR - Указывает, что правила проверки адресов, передаваемых с помощью вызова bind,
      *  должны позволять повторное использование локального адреса. В случае с сокетами PF_INET это означает,
@@ -33,184 +168,876 @@ bool Server::doStartServer(qint16 port) //запуск сервера
     {
         perror("Error: bind");
         close(_listener);
+        _listener = -1;
+        return false;
     }
-    if (listen(_listener, 10) == -1)
+    if (listen(_listener, _config.backlog) == -1)
     {
         perror("Error: listen");
         qDebug() << "Server not started at" << "127.0.0.1" << ":" << port;
         close(_listener);
+        _listener = -1;
         return false;
     }
-    qDebug() << "Server started at" << "127.0.0.1" << ":" << port;
-    QObject::connect(&_timer,SIGNAL(timeout()),this,SLOT(checkSock()));
-    _timer.start(500);
     return true;
 }
-void Server::checkSock() //проверка новых соединений клиентов
+void Server::checkSock() //разбор готовых событий epoll
+{
+    _reactor.poll(0);
+    flushDirty();
+    _journal.commit(); //все записи прохода фиксируются разом
+    //закрытые за проход соединения - обратно в пул: ни события epoll, ни очередь отправки на них больше не ссылаются
+    for(int i=0; i<_retired.size(); i++)
+    {
+        _sessions.release(_retired[i]);
+    }
+    _retired.clear();
+}
+void Server::flushDirty() //кадры, накопленные за проход, уходят одним writev на клиента
+{
+    for(int i=0; i<_dirty.size(); i++)
+    {
+        _dirty[i]->flush();
+    }
+    _dirty.clear();
+}
+void Server::onReadable() //прием новых соединений клиентов
+{
+    if(_frozen)
+        return; //соединения из очереди listen примет новый процесс
+    //edge-triggered: принимаем все ожидающие соединения, пока не получим EAGAIN
+    for(;;)
+    {
+        uint64_t started = Metrics::ticks();
+        int sock = accept4(_listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(sock < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                Metrics::add(ctrAcceptErrors);
+            }
+            return;
+        }
+        int yes = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int)); //ходы короткие, не ждем склейки пакетов
+        //при полном реестре принимаем, только если есть место, ждущее игрока: это может быть он
+        ServClient* client = _matches.isFull() && !_matches.awayCount() ? 0 : _sessions.acquire();
+        if(!client)
+        {
+            Metrics::add(ctrRejected);
+            close(sock); //свободных партий или мест под соединения нет
+            continue;
+        }
+        client->open(sock, this); //соперника ищем после расстановки
+        Metrics::add(ctrAccepted);
+        Metrics::local().accept.record(Metrics::ticks() - started);
+    }
+}
+void Server::findOpponent(ServClient* client, int bucket)
 {
-    static int k=0;
-    fd_set readfds; // слежение за операциями чтения
-    struct timeval timeout;
-    FD_ZERO(&readfds); //очищение изначального множества
-    FD_SET(_listener, &readfds);
-    timeout.tv_sec = 0; // ждать не более 100 нс
-    timeout.tv_usec = 100;
-    int sel = select(_listener + 1 , &readfds , NULL , NULL , &timeout); //добавление нового клиента
-    if(sel < 0)
+    if(_frozen)
     {
+        //общую очередь не трогаем: соперник с другого потока мог бы уехать к уже записанному серверу
+        client->waiter()->bucket = bucket;
+        _deferred.append(_sessions.handle(client));
         return;
     }
-    if(!(FD_ISSET(_listener, &readfds)))
+    MatchTicket partner;
+    //партий не больше лимита: при полном реестре соперника из очереди не забираем
+    Matchmaker::Result result = _matches.isFull() ? Matchmaker::full : _matchmaker->join(client->waiter(), bucket, partner);
+    if(result == Matchmaker::paired && partner.waiter->client->server() != this)
     {
+        handOver(client, partner, bucket); //партия будет на потоке ждавшего
         return;
     }
-    qDebug()<<"accept";
-    numsock[k] = accept(_listener, NULL, NULL); // принимаем входные подключение и создаем отделный сокет для каждого нового подключившегося клиента
-    clientSock[k] = new ServClient(numsock[k],this);
-    QObject::connect(&_timer,SIGNAL(timeout()),clientSock[k],SLOT(checkSock()));
-    if(_listener < 0)
+    if(result == Matchmaker::paired)
+    {
+        _matches.pair(partner.waiter->client, client); //ждавший ходит за сторону 0
+    }
+    if(result == Matchmaker::full)
     {
-        qDebug()<<"fail";
+        char cell = 0;
+        client->sendFrame(comError, &cell, 1); //свободных партий нет
+        client->armDeadline(); //в очереди не стоит: снова срок расстановки
         return;
-    } else {
-        qDebug()<<"succesfull";
     }
-    k++;
-    if(k==2){
+    if(result == Matchmaker::queued)
+    {
+        client->armDeadline(); //расстановка принята, теперь срок ожидания соперника
         return;
     }
+    doStartGame(client); //у обоих расстановки приняты
+}
+void Server::handOver(ServClient* client, const MatchTicket& partner, int bucket)
+{
+    //соперника трогает только его поток: отдаем туда сокет вместе с непрочитанными и неотправленными байтами
+    HandoverMail* mail = new HandoverMail();
+    mail->partner = partner;
+    mail->bucket = bucket;
+    mail->traced = client->traced();
+    memcpy(mail->fleet, client->fleet(), sizeof(mail->fleet));
+    mail->sock = client->handOff(mail->input, mail->output);
+    Metrics::add(ctrHandovers);
+    partner.waiter->client->server()->mailbox()->post(mail);
 }
-bool Server::doStartGame() // начало игры
+void Server::onMail(Mail* mail)
 {
-    if(!readyToPlay)
+    if(mail->type == mailFreeze || mail->type == mailExport || mail->type == mailThaw)
     {
-        readyToPlay = true; //первый игрок вызовет эту функцию и будет ждать второго игрока
-        return false;
+        ControlMail* control = static_cast<ControlMail*>(mail);
+        if(mail->type == mailFreeze)
+            freeze();
+        else if(mail->type == mailExport)
+            exportState(*control->state);
+        else
+            thaw();
+        control->done.release(); //письмо удалит отправитель
+        return;
+    }
+    if(_frozen && (mail->type == mailHandover || mail->type == mailResume))
+    {
+        _held.append(mail); //разберем при записи состояния или после заморозки
+        return;
+    }
+    deliver(mail);
+}
+void Server::deliver(Mail* mail)
+{
+    if(mail->type == mailHandover)
+    {
+        HandoverMail* handover = static_cast<HandoverMail*>(mail);
+        ServClient* partner = handover->partner.waiter->client;
+        //пока письмо шло, соперник мог отключиться (и его ячейку мог занять другой игрок) или снова встать в очередь
+        bool alive = Matchmaker::isCurrent(handover->partner) && !partner->match();
+        ServClient* client = _sessions.acquire();
+        if(!client)
+        {
+            Metrics::add(ctrClosed); //принято другим потоком, там и посчитано
+            close(handover->sock); //мест под соединения нет
+            if(alive)
+            {
+                findOpponent(partner, partner->waiter()->bucket); //ждавший снова в очереди
+            }
+            delete mail;
+            return;
+        }
+        client->open(handover->sock, this);
+        client->adopt(handover->input, handover->output, handover->fleet, handover->traced);
+        if(alive && _matches.pair(partner, client))
+        {
+            doStartGame(client);
+        } else {
+            findOpponent(client, handover->bucket);
+            if(alive)
+            {
+                findOpponent(partner, partner->waiter()->bucket); //мест нет: ждавший снова в очереди
+            }
+        }
+        client->resume(); //кадры, пришедшие вслед за расстановкой
+    }
+    else if(mail->type == mailResume)
+    {
+        HandoverMail* handover = static_cast<HandoverMail*>(mail);
+        ServClient* client = _sessions.acquire();
+        if(!client)
+        {
+            Metrics::add(ctrClosed);
+            close(handover->sock);
+            delete mail;
+            return;
+        }
+        client->open(handover->sock, this);
+        client->adopt(handover->input, handover->output, handover->fleet, handover->traced);
+        resumeSession(client, handover->token);
+        client->resume();
+    }
+    else if(mail->type == mailTrace)
+    {
+        TraceMail* trace = static_cast<TraceMail*>(mail);
+        if(trace->target == TraceMail::match)
+            traceMatch(trace->id, trace->on);
+        else if(trace->target == TraceMail::connection)
+            traceConnection(trace->id, trace->on);
+        else
+            traceOff();
+    }
+    delete mail;
+}
+bool Server::doStartGame(ServClient* client) // начало игры
+{
+    Match* match = client->match();
+    match->ready[client->side()] = true;
+    if(!match->isFull() || !match->ready[0] || !match->ready[1])
+    {
+        return false; //первый игрок вызовет эту функцию и будет ждать второго игрока
     }
     //игра начнется после готовности второго игрока
-    char data[2];
-    data[0] = comStartGame;
-    int r = rand()%2;
-    data[1] = r;               //"рулетка" между игроками
-    send(numsock[0], data, 2, 0);
-    data[1] = 1-r;
-    send(numsock[1], data, 2, 0);
+    char data[1 + resumeTokenSize];
+    int r = match->rng.below(2);
+    for(int i=0; i<2; i++)
+    {
+        data[0] = (i == 0)?r:1-r;               //"рулетка" между игроками
+        if(match->players[i])
+        {
+            ResumeToken token;
+            token.worker = _config.worker;
+            token.side = i;
+            PoolHandle handle = _matches.handle(match);
+            token.index = handle.index;
+            token.generation = handle.generation;
+            token.secret = match->secrets[i] = _secrets(); //не из генератора партии: повтор по зерну не меняется
+            encodeToken(data + 1, token);
+            //без срока ожидания место не держится, и билет не нужен
+            match->players[i]->sendFrame(comStartGame, data, _config.resumeGrace > 0 ? sizeof(data) : 1);
+        }
+    }
+    match->turn = r?0:1;
+    match->started = true;
+    _journal.start(match->id, match->turn, match->aiSide);
+    for(int i=0; i<2; i++)
+    {
+        if(match->players[i])
+        {
+            match->players[i]->armDeadline(); //в партии сроки расстановки и ожидания не действуют
+        }
+    }
+    armTurn(match);
+    runAi(match); //компьютер может ходить первым
     return true;
 }
-int Server::getEnemyCell(int sock, int cell) //получение поля соперника
+ServClient* Server::getEnemyServClient(ServClient* client)
 {
-    if(sock==numsock[0]) {
-        return clientSock[1]->getCell(cell);
-    } else {
-        return clientSock[0]->getCell(cell);
+    return client->match()->enemyOf(client);
+}
+
+void Server::broadcast(Match* match, int command, const char* payload, int length)
+{
+    for(int i=0; i<2; i++)
+    {
+        if(match->players[i]) //за компьютера кадры не отправляем
+        {
+            match->players[i]->sendFrame(command, payload, length);
+        }
     }
 }
-ServClient* Server::getEnemyServClient(int sock)
+
+void Server::sendShoot(ServClient* client, int cell)
 {
-    if(sock==numsock[0])
+    char data[1];
+    data[0] = cell;
+    Match* match = client->match();
+    //стрелять можно только в своей начавшейся партии, в свой ход и в пределах поля
+    if(!match || !match->started || match->turn != client->side() || cell < 0 || cell >= 100)
     {
-        return clientSock[1];
-    } else {
-        return clientSock[0];
+        Metrics::add(ctrBadShots);
+        client->sendFrame(comError, data, 1);
+        return;
+    }
+    if(resolveShot(match, client->side(), cell))
+    {
+        runAi(match); //после промаха человека стреляет компьютер
     }
 }
 
-int Server::getEnemySocket(int sock)
+bool Server::resolveShot(Match* match, int side, int cell)
 {
-    if(sock==numsock[0])
+    char data[4];
+    data[0] = cell;
+    uint64_t started = match->traced ? Metrics::ticks() : 0;
+    ShotResult shot = match->fire(cell); //стреляет игрок match->turn, то есть side
+    _journal.shot(match->id, side, cell, shot.kind);
+    Metrics::add(ctrMoves);
+    if(side == match->aiSide)
+    {
+        match->aiView.apply(cell, shot);
+    }
+    switch(shot.kind)
+    {
+    case shotMiss:
+        broadcast(match, comVoid, data, 1); //ход уже перешел к сопернику
+        break;
+    case shotHit: //записываем коор-ты клетки в которые стреляли обоим игрокам
+        broadcast(match, comDamage, data, 1);
+        break;
+    case shotKill: //передаем координаты убитого корабля обоим игрокам
+        for(int i=0;i<4;i++)
+        {
+            data[i] = (i<shot.killedCount)?shot.killed[i]:-1; //если рядом клеток нет
+        }
+        broadcast(match, comKill, data, 4);
+        break;
+    case shotRepeat: //в эту клетку уже стреляли
+        if(match->players[side])
+        {
+            match->players[side]->sendFrame(comError, data, 1);
+        }
+        break;
+    }
+    if(match->traced)
     {
-        return numsock[1];
-    } else {
-        return numsock[0];
+        int sock = match->players[side] ? match->players[side]->sock() : -1; //-1 - ходит компьютер
+        Trace::record(spanShot, match->id, sock, started);
     }
+    if(match->finished)
+    {
+        _matches.finish(match); //все корабли потоплены, партия окончена
+        return false;
+    }
+    if(shot.kind != shotRepeat)
+    {
+        armTurn(match); //часы хода идут заново только после выстрела, изменившего поле
+    }
+    return true;
 }
-int Server::checkDamageShips(int x, int y, int sock){
-    ServClient *enemy = getEnemyServClient(sock);
-    if(x<=9 && x>=0 && y<=9 && y>=0 && getEnemyCell(sock,x+y*10)) //клетки справа
+
+bool Server::traceMatch(int id, bool on)
+{
+    Match* match = _matches.find(id);
+    if(!match)
+        return false;
+    match->traced = on;
+    for(int i=0; i<2; i++)
     {
-        if(!(enemy->nowDamage[x+y*10]==1)){
-            return 1; //Если палуба есть, но не подбита
-        } else {
-            return 2; //Если палуба есть и подбита
+        if(match->players[i])
+            match->players[i]->updateTrace();
+    }
+    return true;
+}
+
+bool Server::traceConnection(int sock, bool on)
+{
+    bool found = false;
+    _sessions.forEach([&](ServClient* client) {
+        if(client->sock() == sock)
+        {
+            client->setTraced(on);
+            found = true;
         }
+    });
+    return found;
+}
+
+void Server::traceOff()
+{
+    QList<Match*> matches = _matches.all();
+    for(int i=0; i<matches.size(); i++)
+        matches[i]->traced = false;
+    _sessions.forEach([](ServClient* client) { client->setTraced(false); });
+}
+
+void Server::armTurn(Match* match)
+{
+    if(_config.turnTimeout > 0)
+    {
+        _timers.arm(&match->turnTimer, this, _config.turnTimeout * 1000, _matches.handle(match).pack());
     }
-    return 0; //Если палубы нет
 }
-bool Server::checkDamageCell(int a, int b, int x, int y,int &iKill, int nowKilled[], int sock){
-    for(int i=1;i<=3;i++) {
-        int dmg = checkDamageShips(x+i*a,y+i*b,sock);
-        if(dmg == 2) {
-            nowKilled[iKill] = x+i*a+(y+i*b)*10;//записываем координаты подбитых палуб
-            iKill++;
-        } else {
-            if(dmg==1)
-                return false;
-            break;
+
+void Server::onTimer(Timer* timer)
+{
+    if(_frozen)
+    {
+        _timers.arm(timer, this, 1000, timer->tag); //сработает уже у нового процесса или после заморозки
+        return;
+    }
+    if(timer == &_snapshotTimer)
+    {
+        snapshotStep();
+        return;
+    }
+    Match* match = _matches.get(PoolHandle::unpack(timer->tag));
+    if(!match || !match->started)
+        return;
+    if(timer == &match->turnTimer)
+    {
+        Metrics::add(ctrTurnTimeouts);
+        forfeit(match, 1 - match->turn, gameOverTimeout); //игрок turn не походил вовремя
+        return;
+    }
+    for(int i=0; i<2; i++)
+    {
+        if(timer == &match->graceTimers[i] && match->away[i])
+        {
+            forfeit(match, 1 - i, gameOverOpponentLeft); //не вернулся вовремя
+            return;
         }
     }
-    return true;
 }
 
-bool Server::checkShipsPlace(int x, int y, int sock, int nowKilled[])
+void Server::forfeit(Match* match, int winner, int reason)
 {
-    int iKill=1;
-    bool isKill = true;
-    nowKilled[0] = x+y*10;
-    for(int i =1;i<4;i++)
+    match->turn = winner;
+    match->finished = true;
+    for(int i=0; i<2; i++)
     {
-        nowKilled[i] = -1; //если рядом клеток нет
+        if(match->players[i] && match->players[i]->sock() != -1)
+        {
+            char data[2] = { (char)(i == winner), (char)reason };
+            match->players[i]->sendFrame(comGameOver, data, 2);
+        }
     }
-    //проверяем на наличие палуб и на ранение
-    isKill=checkDamageCell(1, 0, x, y, iKill, nowKilled, sock) &&
-           checkDamageCell(-1, 0, x, y, iKill, nowKilled, sock) &&
-           checkDamageCell(0, 1, x, y, iKill, nowKilled, sock) &&
-           checkDamageCell(0, -1, x, y, iKill, nowKilled, sock);
-    return isKill;
+    _matches.finish(match, true);
 }
 
-void Server::sendShoot(int sock, int cell)
+void Server::leave(ServClient* client)
 {
-    char data[2];
-    int nowKilled[4];
-    ServClient *enemy = getEnemyServClient(sock);
-    int enemySock = getEnemySocket(sock);
-    if(enemy->nowDamage[cell]==0)
+    Match* match = client->match();
+    if(match && match->started && _config.resumeGrace > 0)
+    {
+        suspend(match, client->side()); //игрок может вернуться по билету
+        return;
+    }
+    if(match && match->started)
     {
-        if(getEnemyCell(sock,cell)==0) // проверка получунного поля соперника
+        forfeit(match, 1 - client->side(), gameOverOpponentLeft); //соперник узнает о победе сразу, а не по таймеру
+        return;
+    }
+    _matches.detach(client);
+}
+
+void Server::suspend(Match* match, int side)
+{
+    //партия идет дальше без соединения: кадры ушедшему не отправляются, часы хода не останавливаются,
+    //так что соперник ждет не дольше времени хода
+    _matches.suspend(match, side);
+    _timers.arm(&match->graceTimers[side], this, _config.resumeGrace * 1000, _matches.handle(match).pack());
+    Metrics::add(ctrSuspended);
+    sendOpponent(match, side, true); //иначе оставшийся ждет молча до конца ожидания или времени хода
+}
+
+void Server::sendOpponent(Match* match, int side, bool away)
+{
+    ServClient* other = match->players[1 - side];
+    if(!other || other->sock() == -1)
+        return; //компьютер или соперник тоже не на связи
+    char data[3];
+    data[0] = away;
+    int length = 1;
+    if(away)
+    {
+        int seconds = _timers.remaining(&match->graceTimers[side]) / 1000;
+        data[1] = seconds >> 8;
+        data[2] = seconds;
+        length = 3;
+    }
+    other->sendFrame(comOpponent, data, length);
+}
+
+void Server::resumeSession(ServClient* client, const char* data)
+{
+    ResumeToken token;
+    decodeToken(data, token);
+    if(token.worker != _config.worker)
+    {
+        //соединение пришло на чужой поток (SO_REUSEPORT раздает по адресу, а порт клиента новый): везем его к партии
+        Server* owner = _directory ? _directory->get(token.worker) : 0;
+        if(owner)
         {
-            data[0] = comVoid;
-            data[1] = cell;
-            send(sock, data, 2, 0);
-            send(enemySock, data, 2, 0);
+            HandoverMail* mail = new HandoverMail(mailResume);
+            memcpy(mail->token, data, resumeTokenSize);
+            mail->traced = client->traced();
+            memcpy(mail->fleet, client->fleet(), sizeof(mail->fleet));
+            mail->sock = client->handOff(mail->input, mail->output);
+            Metrics::add(ctrHandovers);
+            owner->mailbox()->post(mail);
+            return;
+        }
+    }
+    PoolHandle handle = { token.index, token.generation };
+    Match* match = token.worker == _config.worker && token.side >= 0 && token.side < 2 ? _matches.get(handle) : 0;
+    if(!match || !match->started || match->secrets[token.side] != token.secret || client->match() || _config.resumeGrace <= 0)
+    {
+        Metrics::add(ctrResumeRejected);
+        char rejected = 0;
+        client->sendFrame(comSnapshot, &rejected, 1); //партия окончена или билет чужой
+        return;
+    }
+    int side = token.side;
+    ServClient* old = match->players[side];
+    if(old)
+    {
+        old->closeSock(); //старое соединение еще не заметило обрыва: место освобождается через suspend
+    }
+    _matchmaker->cancel(client->waiter()); //с новой расстановкой мог успеть встать в очередь
+    _matches.resume(match, side, client);
+    client->armDeadline(); //в партии сроков соединения нет
+    Metrics::add(ctrResumed);
+    sendSnapshot(client, match, side);
+    sendOpponent(match, side, false);
+    if(match->away[1 - side])
+    {
+        sendOpponent(match, 1 - side, true); //после перезапуска сервера соперник мог еще не вернуться
+    }
+}
 
-        } else {
-            //расшифровка cell
-            int x = cell%10; //единица в cell (остаток от деления)
-            int y = cell/10; //десятка в cell
+void Server::sendSnapshot(ServClient* client, Match* match, int side)
+{
+    const Board& mine = match->boards[side];
+    const Board& enemy = match->boards[1 - side];
+    Snapshot snapshot;
+    snapshot.myMove = match->turn == side;
+    snapshot.moves = bits::count(mine.hits | mine.misses) + bits::count(enemy.hits | enemy.misses); //повторы клеток не меняют
+    snapshot.wins = match->kills[side];
+    snapshot.losses = match->kills[1 - side];
+    snapshot.myShips = mine.ships;
+    snapshot.myHits = mine.hits;
+    snapshot.myMisses = mine.misses;
+    snapshot.enemyHits = enemy.hits;
+    snapshot.enemyMisses = enemy.misses;
+    snapshot.enemySunk = enemy.sunk(); //целые корабли соперника не раскрываем
+    char data[snapshotSize];
+    client->sendFrame(comSnapshot, data, encodeSnapshot(data, snapshot));
+}
+
+void Server::retire(ServClient* client)
+{
+    _retired.append(client);
+}
+
+void Server::runAi(Match* match)
+{
+    //решение занимает доли микросекунды, поэтому компьютер ходит сразу, без таймеров
+    while(match->aiSide >= 0 && match->started && match->turn == match->aiSide)
+    {
+        int cell = match->ai->chooseShot(match->aiView);
+        if(cell < 0 || !resolveShot(match, match->aiSide, cell))
+        {
+            return;
+        }
+    }
+}
+
+void Server::freeze()
+{
+    flushDirty(); //ответы, уже поставленные в очередь, отправляет этот процесс
+    _frozen = true;
+    _reactor.remove(_listener);
+    _sessions.forEach([](ServClient* client) { client->detach(); });
+    _journal.commit(); //новый процесс продолжит журнал в следующем сегменте
+}
+
+void Server::thaw()
+{
+    _frozen = false;
+    _reactor.add(_listener, this, EPOLLIN | EPOLLET);
+    _sessions.forEach([](ServClient* client) { client->reattach(); });
+    QVector<Mail*> held;
+    held.swap(_held);
+    for(int i=0; i<held.size(); i++)
+    {
+        deliver(held[i]);
+    }
+    QVector<PoolHandle> deferred;
+    deferred.swap(_deferred);
+    for(int i=0; i<deferred.size(); i++)
+    {
+        ServClient* client = _sessions.get(deferred[i]);
+        if(client && client->sock() != -1 && !client->match())
+        {
+            findOpponent(client, client->waiter()->bucket);
+        }
+    }
+    qDebug() << "handover failed, worker" << _config.worker << "continues";
+}
+
+//формат потока: слушающий сокет, сокет метрик, реестр партий, соединения, партии.
+//Соединения - номером ячейки старого пула, партии ссылаются на игроков по этим номерам
+void Server::exportState(StateWriter& out)
+{
+    //переезды, пришедшие до заморозки соседей: соединения открываются здесь и уходят вместе с остальными
+    QVector<Mail*> held;
+    held.swap(_held);
+    for(int i=0; i<held.size(); i++)
+    {
+        deliver(held[i]);
+    }
+    freeze(); //открытые письмами соединения - тоже из реактора, их ответы - клиентам
+    out.putFd(_listener);
+    out.putFd(_metrics.listener());
+    _matches.save(out);
+    std::vector<bool> deferred(_sessions.capacity());
+    for(int i=0; i<_deferred.size(); i++)
+    {
+        ServClient* client = _sessions.get(_deferred[i]);
+        if(client)
+            deferred[client->poolIndex] = true;
+    }
+    uint32_t count = 0;
+    _sessions.forEach([&](ServClient* client) { count += client->sock() != -1; });
+    out.put32(count);
+    _sessions.forEach([&](ServClient* client) {
+        if(client->sock() == -1)
+            return; //закрыто или отдано за этот проход
+        out.put32(client->poolIndex);
+        client->save(out, Matchmaker::isWaiting(client->waiter()) || deferred[client->poolIndex]);
+    });
+    QList<Match*> matches = _matches.all();
+    out.put32(matches.size());
+    for(int i=0; i<matches.size(); i++)
+    {
+        PoolHandle handle = _matches.handle(matches[i]);
+        out.put32(handle.index);
+        out.put32(handle.generation); //билеты возврата, выданные старым процессом, остаются в силе
+        matches[i]->save(out, _timers);
+    }
+    qDebug() << "worker" << _config.worker << "exported" << count << "sessions and" << matches.size() << "matches";
+}
+
+bool Server::importState(StateReader& in)
+{
+    if(!_matches.load(in))
+        return false;
+    QHash<uint32_t, ServClient*> sessions; //номер ячейки у старого процесса - соединение здесь
+    QVector<ServClient*> clients;
+    QVector<ServClient*> queued;
+    uint32_t count = in.get32();
+    for(uint32_t i=0; i<count && in.ok(); i++)
+    {
+        uint32_t index = in.get32();
+        ServClient* client = _sessions.acquire();
+        bool waiting = false;
+        if(!client || !client->load(in, this, waiting))
+        {
+            qCritical() << "handover: cannot restore connection" << index;
+            return false;
+        }
+        sessions.insert(index, client);
+        clients.append(client);
+        if(waiting)
+            queued.append(client);
+        Metrics::add(ctrAccepted);
+    }
+    uint32_t matchCount = in.get32();
+    for(uint32_t i=0; i<matchCount && in.ok(); i++)
+    {
+        PoolHandle handle;
+        handle.index = in.get32();
+        handle.generation = in.get32();
+        Match* match = in.ok() ? _matches.restore(handle) : 0;
+        uint32_t players[2];
+        int timers[3];
+        if(!match || !match->load(in, players, timers))
+        {
+            qCritical() << "handover: cannot restore match" << handle.index;
+            return false;
+        }
+        for(int side=0; side<2; side++)
+        {
+            ServClient* client = sessions.value(players[side]);
+            if(client)
+            {
+                match->players[side] = client;
+                client->setMatch(match, side);
+            }
+        }
+        //часы идут дальше с того, что оставалось: время передачи игрокам не добавляется
+        if(timers[0] >= 0)
+            _timers.arm(&match->turnTimer, this, timers[0], handle.pack());
+        for(int side=0; side<2; side++)
+        {
+            if(match->away[side] && timers[1 + side] >= 0)
+                _timers.arm(&match->graceTimers[side], this, timers[1 + side], handle.pack());
+        }
+    }
+    _matches.restored();
+    if(!in.ok())
+        return false;
+    for(int i=0; i<clients.size(); i++)
+    {
+        clients[i]->armDeadline(); //сроки расстановки и ожидания - заново, в партии их нет
+    }
+    for(int i=0; i<queued.size(); i++)
+    {
+        findOpponent(queued[i], queued[i]->waiter()->bucket); //общая очередь старого процесса осталась у него
+    }
+    for(int i=0; i<clients.size(); i++)
+    {
+        clients[i]->resume(); //кадры, принятые старым процессом, и пришедшие за время передачи
+    }
+    qDebug() << "worker" << _config.worker << "took over" << clients.size() << "sessions and" << matchCount << "matches";
+    return true;
+}
 
-            //проверяем на наличие палуб и на ранение
+//ячеек пула партий за тик колеса: около 2048*250 байт, доли миллисекунды между проходами цикла
+static const uint32_t snapshotSlice = 2048;
+
+std::string Server::snapshotPath() const
+{
+    return _config.snapshotDir.toStdString() + "/worker-" + std::to_string(_config.worker) + ".snap";
+}
 
-            if(checkShipsPlace(x, y, sock, nowKilled))
+void Server::snapshotStep()
+{
+    if(!_snapshot.isOpen())
+    {
+        if(!_snapshot.begin(snapshotPath()))
+        {
+            _timers.arm(&_snapshotTimer, this, _config.snapshotInterval * 1000);
+            return;
+        }
+        //партии пишутся в разные моменты, поэтому повтор после падения идет с начала снимка:
+        //ходы, уже попавшие в снимок, при повторе пропускаются
+        _snapshotCursor = 0;
+        _snapshotMatches = 0;
+        _snapshotSegment = _journal.isOpen() ? _journal.segment() : 0;
+        _snapshotOffset = _journal.offset();
+    }
+    StateWriter part;
+    uint32_t end = std::min(_snapshotCursor + snapshotSlice, _matches.slotCount());
+    for(; _snapshotCursor < end; _snapshotCursor++)
+    {
+        Match* match = _matches.at(_snapshotCursor);
+        if(!match || !match->started)
+            continue; //без начала партии у игроков нет билетов возврата
+        PoolHandle handle = _matches.handle(match);
+        part.put32(handle.index);
+        part.put32(handle.generation);
+        match->save(part, _timers);
+        _snapshotMatches++;
+    }
+    _snapshot.append(part);
+    if(_snapshot.isOpen() && _snapshotCursor < _matches.slotCount())
+    {
+        _timers.arm(&_snapshotTimer, this, 0); //следующая часть - на следующем тике
+        return;
+    }
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.worker = _config.worker;
+    header.workers = _config.workers;
+    header.matches = _snapshotMatches;
+    header.journalSegment = _snapshotSegment;
+    header.journalOffset = _snapshotOffset;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.time = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    StateWriter registry;
+    _matches.save(registry); //на конец снимка: номера партий, созданных за время записи, уже заняты
+    memcpy(header.registry, registry.data().data(), std::min(registry.data().size(), sizeof(header.registry)));
+    if(_snapshot.commit(header))
+    {
+        Metrics::add(ctrSnapshots);
+    }
+    _timers.arm(&_snapshotTimer, this, _config.snapshotInterval * 1000);
+}
+
+bool Server::recover()
+{
+    SnapshotFile file;
+    std::string path = snapshotPath();
+    if(!file.open(path))
+        return false;
+    const SnapshotHeader& header = file.header();
+    if(header.worker != (uint32_t)_config.worker || header.workers != (uint32_t)_config.workers)
+    {
+        qWarning() << "snapshot" << path.c_str() << "was written by" << header.workers << "workers, ignored";
+        return false;
+    }
+    if(_config.resumeGrace <= 0)
+    {
+        qWarning() << "snapshot ignored: without --resume-grace players cannot come back";
+        return false;
+    }
+    uint64_t started = TimerWheel::clockMs();
+    StateReader registry = file.registry();
+    _matches.load(registry);
+    StateReader in = file.matches();
+    QHash<int, Match*> matches;
+    for(uint32_t i=0; i<header.matches; i++)
+    {
+        PoolHandle handle;
+        handle.index = in.get32();
+        handle.generation = in.get32();
+        Match* match = in.ok() ? _matches.restore(handle) : 0;
+        uint32_t players[2];
+        int timers[3];
+        if(!match || !match->load(in, players, timers))
+        {
+            qCritical() << "snapshot" << path.c_str() << "is damaged after" << i << "matches";
+            if(match)
+                _matches.finish(match);
+            break;
+        }
+        for(int side=0; side<2; side++)
+        {
+            match->away[side] = side != match->aiSide; //соединения закрылись вместе с процессом
+        }
+        matches.insert(match->id, match);
+    }
+    //ходы после начала снимка - из журнала: он фиксируется каждый проход, снимок - раз в несколько секунд
+    int replayed = 0;
+    JournalReader journal;
+    if(header.journalSegment > 0 && _journal.isOpen() &&
+       journal.open(_journal.dir(), header.journalSegment, header.journalOffset))
+    {
+        _matches.setJournal(0); //все это уже записано
+        JournalEntry entry;
+        while(journal.next(entry))
+        {
+            if(entry.type == recMatch)
+            {
+                _matches.skipTo(entry.match);
+                continue;
+            }
+            //партии, начатые после снимка, не вернуть: секретов их билетов нет ни в снимке, ни в журнале
+            Match* match = matches.value(entry.match);
+            if(!match)
+                continue;
+            if(entry.type == recShot && replayShot(match, entry.side, entry.cell))
+            {
+                replayed++;
+            }
+            else if(entry.type == recEnd)
             {
-                char dataKill[5]; //передаем координаты убитого корабля
-                dataKill[0] = comKill;
-                for(int i=0;i<4;i++)
-                {
-                    dataKill[i+1]=nowKilled[i];
-                }
-                send(sock, dataKill, 5, 0); //отправляем координаты
-                send(enemySock, dataKill, 5, 0); //обоим игрокам
-            } else { //записываем коор-ты клетки в которые стреляли обоим игрокам
-                data[0] = comDamage;
-                data[1] = cell;
-                send(sock, data, 2, 0);
-                send(enemySock, data, 2, 0);
+                matches.remove(entry.match);
+                _matches.finish(match, entry.forfeit);
             }
         }
-        enemy->nowDamage[cell] = 1;
-    } else {
-        data[0] = comError;
-        send(sock, data, 2, 0);
+        _matches.setJournal(&_journal);
     }
+    _matches.restored();
+    QList<Match*> live = _matches.all();
+    for(int i=0; i<live.size(); i++)
+    {
+        Match* match = live[i];
+        uint64_t tag = _matches.handle(match).pack();
+        for(int side=0; side<2; side++)
+        {
+            if(match->away[side])
+            {
+                _timers.arm(&match->graceTimers[side], this, _config.resumeGrace * 1000, tag);
+                Metrics::add(ctrSuspended);
+            }
+        }
+        if(_config.turnTimeout > 0)
+        {
+            //ходящему - время вернуться и полный ход
+            _timers.arm(&match->turnTimer, this, (_config.turnTimeout + _config.resumeGrace) * 1000, tag);
+        }
+        runAi(match); //если падение пришлось между ходом человека и ответом компьютера
+    }
+    qDebug() << "recovered" << live.size() << "matches from" << path.c_str() << "(" << file.size() << "bytes ) and"
+             << replayed << "moves from the journal in" << TimerWheel::clockMs() - started << "ms";
+    return true;
+}
 
+bool Server::replayShot(Match* match, int side, int cell)
+{
+    if(match->finished || side != match->turn || cell < 0 || cell >= 100 || match->boards[1 - side].isShot(cell))
+        return false; //выстрел был до снимка или повтор клетки
+    if(side == match->aiSide)
+    {
+        //решение компьютера берет значения из его генератора: повторяем его, чтобы генератор пришел в то же состояние
+        int chosen = match->ai->chooseShot(match->aiView);
+        if(chosen != cell)
+            qWarning() << "match" << match->id << "AI replay diverged at cell" << cell;
+    }
+    ShotResult shot = match->fire(cell);
+    if(side == match->aiSide)
+    {
+        match->aiView.apply(cell, shot);
+    }
+    return true;
 }
@@ -10,36 +10,211 @@
 #include <unistd.h>
 #include <termios.h>
 #include <QObject>
-#include <QTimer>
+#include <QSocketNotifier>
+#include <QVector>
 #include <QDebug>
+#include <QSemaphore>
 #include <string>
+#include <atomic>
 #include "servclient.h"
-#include <ctime>
+#include "reactor.h"
+#include "match.h"
+#include "matchmaker.h"
+#include "journal.h"
+#include "metricsendpoint.h"
+#include "trace.h"
+#include "timerwheel.h"
+#include "mailbox.h"
+#include "pool.h"
+#include "rng.h"
+#include "ringbuffer.h"
+#include "outqueue.h"
+#include "handover.h"
+#include "snapshot.h"
 class ServClient;
-class Server: public QObject
+
+//сообщения между рабочими потоками
+enum MailType { mailHandover, //игрок забрал из очереди ждущего с другого потока и переезжает к нему
+                mailTrace, //включить или выключить трассу на потоке-владельце
+                mailResume, //игрок вернулся после обрыва на чужой поток и переезжает к своей партии
+                mailFreeze, //передача новому процессу: остановить обработку
+                mailExport, //записать состояние потока
+                mailThaw //передача не удалась, продолжить работу
+              };
+
+//переезд соединения на другой поток: к сопернику (mailHandover) или к своей партии (mailResume)
+struct HandoverMail: Mail
+{
+    explicit HandoverMail(int type = mailHandover) : Mail(type), sock(-1), bucket(0), traced(false) {}
+    int sock;
+    MatchTicket partner; //билет забранного из очереди соперника, он живет на потоке-получателе
+    int bucket;
+    bool traced; //трасса соединения
+    char token[resumeTokenSize]; //билет возврата для mailResume
+    char fleet[100];
+    RingBuffer input; //принятые, но еще не разобранные байты
+    OutQueue output; //неотправленные кадры
+};
+
+struct TraceMail: Mail
+{
+    enum Target { match, connection, off };
+    TraceMail(int target, int id, bool on) : Mail(mailTrace), target(target), id(id), on(on) {}
+    int target;
+    int id; //номер партии или сокет
+    bool on;
+};
+
+//управление передачей новому процессу с потока 0. Получатель только отмечает done,
+//письмо удаляет отправитель после ожидания
+struct ControlMail: Mail
+{
+    explicit ControlMail(int type, StateWriter* state = 0) : Mail(type), state(state) {}
+    StateWriter* state; //куда писать для mailExport
+    QSemaphore done;
+};
+
+//параметры запуска сервера
+struct ServerConfig
+{
+    ServerConfig();
+    quint16 port;
+    int backlog; //длина очереди listen
+    int workers; //количество рабочих потоков
+    int worker; //номер этого потока, от 0: по нему выводятся номера партий, зерна и каталог журнала
+    int maxMatches; //ограничение числа партий, 0 - без ограничения
+    quint64 seed; //зерно сервера, из него выводятся зерна партий; 0 - случайное
+    QString journalDir; //каталог журнала партий, пусто - не писать
+    QString metricsAddress; //порт на 127.0.0.1 или Unix-сокет для метрик, пусто - не открывать
+    int turnTimeout; //секунд на ход, по истечении - поражение; 0 - без ограничения
+    int placementTimeout; //секунд на расстановку после подключения или конца партии
+    int idleTimeout; //секунд ожидания соперника с готовой расстановкой
+    int maxConnections; //ограничение числа соединений на поток, 0 - без ограничения
+    int resumeGrace; //секунд держать место игрока, у которого оборвалось соединение; 0 - сразу поражение
+    QString handoverPath; //Unix-сокет, на котором ждать новый процесс, пусто - не ждать
+    QString takeoverPath; //Unix-сокет старого процесса, у которого забрать работу при запуске
+    int listener; //слушающий сокет от старого процесса, -1 - открыть свой
+    int metricsListener; //сокет страницы метрик от старого процесса, -1 - открыть свой
+    QString snapshotDir; //каталог снимков партий для перезапуска после падения, пусто - не писать
+    int snapshotInterval; //секунд между снимками
+};
+
+class Server;
+
+//рабочие потоки по номерам: туда отправляется игрок, вернувшийся в партию через чужой поток.
+//Поток записывает себя при запуске и стирает при остановке, читать можно из любого потока
+class ServerDirectory
+{
+public:
+    ServerDirectory() : _servers(0), _count(0) {}
+    ~ServerDirectory() { delete[] _servers; }
+    void resize(int count) //до запуска потоков
+    {
+        delete[] _servers;
+        _servers = new std::atomic<Server*>[count];
+        _count = count;
+        for(int i=0; i<count; i++)
+            _servers[i].store(0, std::memory_order_relaxed);
+    }
+    Server* get(int worker) const { return worker >= 0 && worker < _count ? _servers[worker].load(std::memory_order_acquire) : 0; }
+    void set(int worker, Server* server) { if(worker >= 0 && worker < _count) _servers[worker].store(server, std::memory_order_release); }
+
+private:
+    std::atomic<Server*>* _servers;
+    int _count;
+    ServerDirectory(const ServerDirectory&);
+    ServerDirectory& operator=(const ServerDirectory&);
+};
+
+//один рабочий поток: свой слушающий сокет (SO_REUSEPORT), реактор, таймеры, партии и журнал.
+//Оба игрока партии всегда на одном потоке, так что выстрелы разрешаются без блокировок
+class Server: public QObject, public IoHandler, public TraceControl, public TimerHandler, public MailHandler
 {
     Q_OBJECT
 public:
     bool doStartServer(qint16 port);
-    bool doStartGame();
-    int getEnemyCell(int sock,int cell);
-    void sendShoot(int sock, int cell);
+    bool doStartServer(const ServerConfig& config);
+    bool doStartGame(ServClient* client);
+    void findOpponent(ServClient* client, int bucket); //в очередь подбора; нашелся соперник - сразу начало партии
+    void sendShoot(ServClient* client, int cell);
     Server();
-
+    ~Server();
+    Reactor* reactor() { return &_reactor; }
+    MatchRegistry* matches() { return &_matches; }
+    Matchmaker* matchmaker() { return _matchmaker; }
+    void setMatchmaker(Matchmaker* matchmaker) { _matchmaker = matchmaker; } //общая очередь потоков, до запуска; без нее - своя
+    Journal* journal() { return &_journal; }
+    TimerWheel* timers() { return &_timers; }
+    Mailbox* mailbox() { return &_mailbox; }
+    void setDirectory(ServerDirectory* directory) { _directory = directory; } //соседние потоки, до запуска
+    void setTraceControl(TraceControl* control) { _traceControl = control; } //кого спрашивает страница метрик, по умолчанию сам сервер
+    const ServerConfig& config() const { return _config; }
+    void markDirty(ServClient* client) { _dirty.append(client); } //у клиента есть неотправленные кадры
+    void onReadable(); //новые соединения на _listener
+    bool traceMatch(int id, bool on);
+    bool traceConnection(int sock, bool on);
+    void traceOff();
+    void onTimer(Timer* timer); //вышло время хода
+    void onMail(Mail* mail); //сообщение от другого рабочего потока
+    void leave(ServClient* client); //игрок отключается: партия, если шла, отдается сопернику
+    void retire(ServClient* client); //соединение закрыто или отдано, вернуть в пул в конце прохода
+    void resumeSession(ServClient* client, const char* token); //comResume: вернуть игрока на его место в партии
+    int sessions() const { return _sessions.size(); }
+    //передача новому процессу: заморозить, записать состояние и отдать его или, если не вышло, продолжить работу.
+    //Замороженный сервер не читает соединения и не принимает новые, переезды игроков и таймеры откладывает
+    void freeze();
+    void thaw();
+    bool isFrozen() const { return _frozen; }
+    void exportState(StateWriter& out); //только у замороженного сервера
+    bool importState(StateReader& in); //после doStartServer с сокетами старого процесса
+    void handedOver() { _metrics.release(); } //новый процесс работает: общего с ним при остановке не удалять
 private:
-    QTimer _timer;
+    Reactor _reactor;
+    QSocketNotifier* _notifier; //будит цикл Qt, когда в epoll есть готовые события
+    MatchRegistry _matches;
+    Matchmaker* _matchmaker; //очередь ожидающих соперника, общая для всех потоков
+    Matchmaker* _ownMatchmaker; //своя, если общую не дали
+    Journal _journal; //запись всех партий для повтора
+    MetricsEndpoint _metrics; //страница метрик для Prometheus
+    TimerWheel _timers; //сроки ходов, расстановок и ожидания
+    Mailbox _mailbox; //переезды игроков и управление трассой от других потоков
+    TraceControl* _traceControl;
+    ServerDirectory* _directory; //0 - поток один
+    Rng _secrets; //секреты билетов возврата: случайное зерно, не связанное с зерном сервера из лога
+    QVector<ServClient*> _dirty; //клиенты, которым нужно отправить очередь
+    Pool<ServClient> _sessions; //соединения игроков
+    QVector<ServClient*> _retired; //закрытые за проход
+    ServerConfig _config;
     struct sockaddr_in stSockAddr;
-    int numsock[2];
-    ServClient* clientSock[2];
     int _listener;
-    bool readyToPlay;
-    ServClient* getEnemyServClient(int sock); //узнать о противнике
-    int getEnemySocket(int sock); //узнать о противнике
-    int checkDamageShips(int x, int y, int sock); //проверить повреждение кораблей
-    bool checkShipsPlace(int x, int y, int sock, int nowKilled[]); //проверить расположение кораблей
-    bool checkDamageCell(int a, int b, int x, int y,int &iKill, int nowKilled[], int sock); //проверить повреждение клетки
+    bool _frozen;
+    QVector<Mail*> _held; //переезды, пришедшие в заморозку
+    QVector<PoolHandle> _deferred; //соединения, которым искать соперника после заморозки
+    SnapshotWriter _snapshot; //снимок, который пишется сейчас
+    Timer _snapshotTimer; //следующая часть снимка или следующий снимок
+    uint32_t _snapshotCursor; //следующая ячейка пула партий
+    uint32_t _snapshotMatches;
+    uint32_t _snapshotSegment; //место в журнале на начало снимка
+    uint64_t _snapshotOffset;
+    std::string snapshotPath() const;
+    void snapshotStep(); //очередная часть снимка, не больше snapshotSlice ячеек за тик
+    bool recover(); //партии из снимка и ходы после него из журнала; игроки возвращаются по билетам
+    bool replayShot(Match* match, int side, int cell); //ход из журнала, false - уже есть в снимке
+    bool openListener(); //свой слушающий сокет на config.port
+    void deliver(Mail* mail); //разбор письма, удаляет его
+    ServClient* getEnemyServClient(ServClient* client); //узнать о противнике
+    void broadcast(Match* match, int command, const char* payload, int length); //кадр обоим живым игрокам
+    bool resolveShot(Match* match, int side, int cell); //выстрел игрока side, false - партия окончена
+    void runAi(Match* match); //ходы компьютера, пока ход его
+    void armTurn(Match* match); //заново отсчитать время хода
+    void forfeit(Match* match, int winner, int reason); //партия окончена не по правилам: comGameOver обоим
+    void handOver(ServClient* client, const MatchTicket& partner, int bucket); //отправить игрока на поток соперника
+    void suspend(Match* match, int side); //соединение игрока оборвалось: держим место resumeGrace секунд
+    void sendSnapshot(ServClient* client, Match* match, int side); //состояние партии вернувшемуся игроку
+    void sendOpponent(Match* match, int side, bool away); //сопернику игрока side: тот ушел или вернулся
 private slots:
-    void checkSock();
+    void checkSock(); //разбор событий epoll
+    void flushDirty(); //отправка накопленных кадров
 };
 
 #endif // SERVER_H
@@ -0,0 +1,49 @@
+# Серверная часть игры: общая для клиента (кнопка NEW GAME) и выделенного сервера
+
+SOURCES += \
+    $$PWD/server.cpp \
+    $$PWD/servclient.cpp \
+    $$PWD/match.cpp \
+    $$PWD/reactor.cpp \
+    $$PWD/bitboard.cpp \
+    $$PWD/protocol.cpp \
+    $$PWD/ringbuffer.cpp \
+    $$PWD/outqueue.cpp \
+    $$PWD/fleet.cpp \
+    $$PWD/game.cpp \
+    $$PWD/journal.cpp \
+    $$PWD/histogram.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/metricsendpoint.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/timerwheel.cpp \
+    $$PWD/matchmaker.cpp \
+    $$PWD/mailbox.cpp \
+    $$PWD/handover.cpp \
+    $$PWD/snapshot.cpp \
+    $$PWD/aiplayer.cpp
+
+HEADERS += \
+    $$PWD/server.h \
+    $$PWD/servclient.h \
+    $$PWD/match.h \
+    $$PWD/reactor.h \
+    $$PWD/protocol.h \
+    $$PWD/bitboard.h \
+    $$PWD/ringbuffer.h \
+    $$PWD/outqueue.h \
+    $$PWD/fleet.h \
+    $$PWD/game.h \
+    $$PWD/journal.h \
+    $$PWD/histogram.h \
+    $$PWD/metrics.h \
+    $$PWD/metricsendpoint.h \
+    $$PWD/trace.h \
+    $$PWD/timerwheel.h \
+    $$PWD/matchmaker.h \
+    $$PWD/mailbox.h \
+    $$PWD/handover.h \
+    $$PWD/snapshot.h \
+    $$PWD/pool.h \
+    $$PWD/aiplayer.h \
+    $$PWD/rng.h
@@ -0,0 +1,90 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include "cluster.h"
+
+//выделенный сервер без графического интерфейса
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("seaBattle-server");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sea Battle dedicated server");
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Port to listen on.", "port", "3634");
+    QCommandLineOption backlogOption("backlog", "Length of the listen queue.", "n", "128");
+    QCommandLineOption workersOption(QStringList() << "w" << "workers", "Number of worker threads.", "n", "1");
+    QCommandLineOption matchesOption("max-matches", "Maximum number of matches, 0 for no limit.", "n", "0");
+    QCommandLineOption seedOption("seed", "Seed for match generators, 0 for random.", "n", "0");
+    QCommandLineOption journalOption("journal", "Directory for the match journal, empty to disable.", "dir", "");
+    QCommandLineOption turnOption("turn-timeout", "Seconds per move before the player loses, 0 for no limit.", "s", "30");
+    QCommandLineOption placementOption("placement-timeout", "Seconds to send a fleet after connecting or after a match, 0 for no limit.", "s", "60");
+    QCommandLineOption idleOption("idle-timeout", "Seconds to wait for an opponent with a placed fleet, 0 for no limit.", "s", "300");
+    QCommandLineOption graceOption("resume-grace", "Seconds to hold the seat of a player who lost the connection mid-match, 0 to forfeit at once.", "s", "30");
+    QCommandLineOption connectionsOption("max-connections", "Maximum number of client connections, 0 for no limit.", "n", "0");
+    QCommandLineOption metricsOption("metrics", "Local port or Unix socket path for Prometheus metrics, empty to disable.", "address", "");
+    QCommandLineOption handoverOption("handover", "Unix socket path where a new server process can take over this one's connections and matches.", "path", "");
+    QCommandLineOption snapshotOption("snapshot", "Directory for periodic match snapshots to recover from after a crash, empty to disable.", "dir", "");
+    QCommandLineOption snapshotIntervalOption("snapshot-interval", "Seconds between match snapshots.", "s", "10");
+    QCommandLineOption takeoverOption("takeover", "Unix socket path of a running server to take over connections and matches from; its number of workers is kept.", "path", "");
+    parser.addOption(portOption);
+    parser.addOption(backlogOption);
+    parser.addOption(workersOption);
+    parser.addOption(matchesOption);
+    parser.addOption(seedOption);
+    parser.addOption(journalOption);
+    parser.addOption(metricsOption);
+    parser.addOption(turnOption);
+    parser.addOption(placementOption);
+    parser.addOption(idleOption);
+    parser.addOption(connectionsOption);
+    parser.addOption(graceOption);
+    parser.addOption(handoverOption);
+    parser.addOption(takeoverOption);
+    parser.addOption(snapshotOption);
+    parser.addOption(snapshotIntervalOption);
+    parser.process(a);
+
+    ServerConfig config;
+    bool ok = true;
+    config.port = parser.value(portOption).toUShort(&ok);
+    if(ok)
+        config.backlog = parser.value(backlogOption).toInt(&ok);
+    if(ok)
+        config.workers = parser.value(workersOption).toInt(&ok);
+    if(ok)
+        config.maxMatches = parser.value(matchesOption).toInt(&ok);
+    if(ok)
+        config.seed = parser.value(seedOption).toULongLong(&ok);
+    if(ok)
+        config.turnTimeout = parser.value(turnOption).toInt(&ok);
+    if(ok)
+        config.placementTimeout = parser.value(placementOption).toInt(&ok);
+    if(ok)
+        config.idleTimeout = parser.value(idleOption).toInt(&ok);
+    if(ok)
+        config.maxConnections = parser.value(connectionsOption).toInt(&ok);
+    if(ok)
+        config.resumeGrace = parser.value(graceOption).toInt(&ok);
+    if(ok)
+        config.snapshotInterval = parser.value(snapshotIntervalOption).toInt(&ok);
+    config.journalDir = parser.value(journalOption);
+    config.metricsAddress = parser.value(metricsOption);
+    config.handoverPath = parser.value(handoverOption);
+    config.takeoverPath = parser.value(takeoverOption);
+    config.snapshotDir = parser.value(snapshotOption);
+    if(!ok || config.backlog <= 0 || config.workers <= 0 || config.maxMatches < 0 ||
+       config.turnTimeout < 0 || config.placementTimeout < 0 || config.idleTimeout < 0 || config.maxConnections < 0 ||
+       config.resumeGrace < 0 || config.snapshotInterval <= 0)
+    {
+        qCritical() << "invalid arguments";
+        return 1;
+    }
+    Cluster cluster; //поток 0 - этот, с циклом a.exec()
+    if(!cluster.start(config))
+    {
+        return 1;
+    }
+    return a.exec();
+}
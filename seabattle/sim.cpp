@@ -0,0 +1,214 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "game.h"
+#include "fleet.h"
+#include "strategy.h"
+
+//симулятор турнира: партии двух стратегий целиком в памяти, без сокетов.
+//Каждый поток играет свою долю партий со своими генераторами, стратегиями и счетчиками
+static const int maxShots = 100;
+
+struct SimStats
+{
+    uint64_t games;
+    uint64_t wins[2];
+    uint64_t moves; //выстрелы обеих сторон
+    uint64_t shotsToWin[2][maxShots + 1]; //распределение числа выстрелов победителя
+    char pad[64]; //счетчики соседних потоков в разных строках кэша
+
+    void clear() { memset(this, 0, sizeof(*this)); }
+    void merge(const SimStats& other)
+    {
+        games += other.games;
+        moves += other.moves;
+        for(int side=0; side<2; side++)
+        {
+            wins[side] += other.wins[side];
+            for(int i=0; i<=maxShots; i++)
+                shotsToWin[side][i] += other.shotsToWin[side][i];
+        }
+    }
+};
+
+struct SimConfig
+{
+    std::string names[2];
+    uint64_t seed;
+    int budgetUs;
+};
+
+static void playShard(int shard, uint64_t games, const SimConfig& config, SimStats* out)
+{
+    SimStats stats;
+    stats.clear();
+    //поток shard берет свой отрезок последовательности: итог зависит только от зерна и числа потоков
+    Rng rng(config.seed);
+    for(int i=0; i<shard; i++)
+        rng.jump();
+    Strategy* players[2];
+    for(int side=0; side<2; side++)
+        players[side] = makeStrategy(config.names[side], rng(), config.budgetUs);
+    Game game;
+    Knowledge view[2];
+    for(uint64_t n=0; n<games; n++)
+    {
+        game.clear();
+        for(int side=0; side<2; side++)
+        {
+            game.boards[side].ships = randomFleet(rng);
+            view[side].clear();
+        }
+        game.turn = n % 2; //первый ход по очереди, чтобы он не влиял на счет
+        int shots[2] = { 0, 0 };
+        while(!game.finished)
+        {
+            int side = game.turn;
+            int cell = players[side]->chooseShot(view[side]);
+            if(cell < 0)
+                break;
+            view[side].apply(cell, game.fire(cell));
+            shots[side]++;
+        }
+        int winner = game.winner();
+        if(winner < 0)
+            continue;
+        stats.games++;
+        stats.wins[winner]++;
+        stats.moves += shots[0] + shots[1];
+        stats.shotsToWin[winner][shots[winner] < maxShots ? shots[winner] : maxShots]++;
+    }
+    for(int side=0; side<2; side++)
+        delete players[side];
+    *out = stats;
+}
+
+//95% доверительный интервал доли по Уилсону
+static void wilson(uint64_t wins, uint64_t games, double& low, double& high)
+{
+    const double z = 1.96;
+    if(!games)
+    {
+        low = high = 0;
+        return;
+    }
+    double n = games, p = wins / n;
+    double denom = 1 + z*z/n;
+    double center = (p + z*z/(2*n)) / denom;
+    double half = z * sqrt(p*(1-p)/n + z*z/(4*n*n)) / denom;
+    low = center - half;
+    high = center + half;
+}
+
+static int percentile(const uint64_t* counts, uint64_t total, double p)
+{
+    uint64_t rank = (uint64_t)ceil(total * p / 100.0), seen = 0;
+    for(int i=0; i<=maxShots; i++)
+    {
+        seen += counts[i];
+        if(seen >= rank && seen)
+            return i;
+    }
+    return maxShots;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("seaBattle-sim");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sea Battle tournament simulator");
+    parser.addHelpOption();
+    QCommandLineOption gamesOption(QStringList() << "n" << "games", "Number of games.", "n", "100000");
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads", "Worker threads, 0 for all cores.", "n", "0");
+    QCommandLineOption firstOption(QStringList() << "a", "First strategy: random, hunt, density, solver.", "name", "density");
+    QCommandLineOption secondOption(QStringList() << "b", "Second strategy.", "name", "hunt");
+    QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+    QCommandLineOption budgetOption("budget", "Solver time per move, us.", "us", "1000");
+    parser.addOption(gamesOption);
+    parser.addOption(threadsOption);
+    parser.addOption(firstOption);
+    parser.addOption(secondOption);
+    parser.addOption(seedOption);
+    parser.addOption(budgetOption);
+    parser.process(a);
+
+    SimConfig config;
+    config.names[0] = parser.value(firstOption).toStdString();
+    config.names[1] = parser.value(secondOption).toStdString();
+    config.seed = parser.value(seedOption).toULongLong();
+    config.budgetUs = parser.value(budgetOption).toInt();
+    qint64 games = parser.value(gamesOption).toLongLong();
+    int threads = parser.value(threadsOption).toInt();
+    if(threads <= 0)
+        threads = std::thread::hardware_concurrency();
+    if(games <= 0 || threads <= 0 || config.budgetUs <= 0)
+    {
+        qCritical() << "invalid arguments";
+        return 1;
+    }
+    for(int side=0; side<2; side++)
+    {
+        Strategy* probe = makeStrategy(config.names[side], 0);
+        if(!probe)
+        {
+            qCritical() << "unknown strategy" << config.names[side].c_str();
+            return 1;
+        }
+        delete probe;
+    }
+
+    std::vector<SimStats> shards(threads);
+    std::vector<std::thread> workers;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    for(int i=0; i<threads; i++)
+    {
+        uint64_t share = games / threads + (i < games % threads ? 1 : 0);
+        workers.push_back(std::thread(playShard, i, share, std::cref(config), &shards[i]));
+    }
+    SimStats total;
+    total.clear();
+    for(int i=0; i<threads; i++)
+    {
+        workers[i].join();
+        total.merge(shards[i]); //общие счетчики собираются только после окончания потоков
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    printf("%llu games in %.2f s on %d threads: %.0f games/s, %.0f shots/s\n", (unsigned long long)total.games,
+           sec, threads, total.games / sec, total.moves / sec);
+    printf("%-4s %-8s %10s %8s %17s %8s %5s %5s %5s\n", "side", "strategy", "wins", "rate", "95% CI", "mean", "p10", "p50", "p90");
+    for(int side=0; side<2; side++)
+    {
+        const uint64_t* counts = total.shotsToWin[side];
+        uint64_t wins = total.wins[side], sum = 0;
+        for(int i=0; i<=maxShots; i++)
+            sum += counts[i] * i;
+        double low, high;
+        wilson(wins, total.games, low, high);
+        printf("%-4s %-8s %10llu %7.2f%% [%6.2f%%, %6.2f%%] %8.2f %5d %5d %5d\n", side ? "b" : "a",
+               config.names[side].c_str(), (unsigned long long)wins,
+               total.games ? 100.0 * wins / total.games : 0, 100 * low, 100 * high,
+               wins ? (double)sum / wins : 0, percentile(counts, wins, 10), percentile(counts, wins, 50),
+               percentile(counts, wins, 90));
+    }
+    printf("shots to win  %10s %10s\n", "a", "b");
+    for(int from=0; from<=maxShots; from+=5)
+    {
+        uint64_t n[2] = { 0, 0 };
+        for(int side=0; side<2; side++)
+            for(int i=from; i<from+5 && i<=maxShots; i++)
+                n[side] += total.shotsToWin[side][i];
+        if(n[0] || n[1])
+            printf("%3d-%-3d       %10llu %10llu\n", from, from + 4, (unsigned long long)n[0], (unsigned long long)n[1]);
+    }
+    return 0;
+}
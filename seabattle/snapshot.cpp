@@ -0,0 +1,168 @@
+#include "snapshot.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+
+static const uint64_t initialSize = 1024*1024;
+
+SnapshotWriter::SnapshotWriter()
+{
+    _fd = -1;
+    _base = 0;
+    _capacity = 0;
+    _used = 0;
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    abort();
+}
+
+bool SnapshotWriter::begin(const std::string& path)
+{
+    abort();
+    _path = path;
+    _temp = path + ".tmp";
+    _fd = ::open(_temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(_fd < 0)
+    {
+        perror("snapshot: open");
+        return false;
+    }
+    if(ftruncate(_fd, initialSize) < 0)
+    {
+        perror("snapshot: ftruncate");
+        abort();
+        return false;
+    }
+    void* base = mmap(0, initialSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if(base == MAP_FAILED)
+    {
+        perror("snapshot: mmap");
+        abort();
+        return false;
+    }
+    _base = (char*)base;
+    _capacity = initialSize;
+    _used = sizeof(SnapshotHeader); //заголовок - при commit, когда известно все
+    return true;
+}
+
+bool SnapshotWriter::reserve(uint64_t n)
+{
+    if(_used + n <= _capacity)
+        return true;
+    uint64_t capacity = _capacity;
+    while(capacity < _used + n)
+        capacity *= 2;
+    if(ftruncate(_fd, capacity) < 0)
+    {
+        perror("snapshot: ftruncate");
+        return false;
+    }
+    void* base = mremap(_base, _capacity, capacity, MREMAP_MAYMOVE);
+    if(base == MAP_FAILED)
+    {
+        perror("snapshot: mremap");
+        return false;
+    }
+    _base = (char*)base;
+    _capacity = capacity;
+    return true;
+}
+
+void SnapshotWriter::append(const StateWriter& part)
+{
+    const std::vector<char>& data = part.data();
+    if(!_base || data.empty())
+        return;
+    if(!reserve(data.size()))
+    {
+        abort(); //места на диске нет: этот снимок пропускаем, прошлый остается
+        return;
+    }
+    memcpy(_base + _used, data.data(), data.size());
+    _used += data.size();
+}
+
+bool SnapshotWriter::commit(SnapshotHeader& header)
+{
+    if(!_base)
+        return false;
+    header.magic = magic;
+    header.version = version;
+    header.size = _used;
+    memcpy(_base, &header, sizeof(header));
+    //страницы сбрасывает ядро: ни msync, ни fsync, цикл не ждет диска
+    munmap(_base, _capacity);
+    _base = 0;
+    bool ok = ftruncate(_fd, _used) == 0;
+    ::close(_fd);
+    _fd = -1;
+    if(!ok || rename(_temp.c_str(), _path.c_str()) < 0)
+    {
+        perror("snapshot: rename");
+        unlink(_temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void SnapshotWriter::abort()
+{
+    if(_base)
+        munmap(_base, _capacity);
+    _base = 0;
+    if(_fd != -1)
+    {
+        ::close(_fd);
+        unlink(_temp.c_str());
+    }
+    _fd = -1;
+    _capacity = 0;
+    _used = 0;
+}
+
+SnapshotFile::SnapshotFile()
+{
+    _base = 0;
+    _size = 0;
+}
+
+SnapshotFile::~SnapshotFile()
+{
+    if(_base)
+        munmap((void*)_base, _size);
+}
+
+bool SnapshotFile::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (uint64_t)st.st_size < sizeof(SnapshotHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    //MAP_POPULATE: файл читается целиком, страницы - одним проходом, а не по ошибке на каждую
+    void* base = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    ::close(fd);
+    if(base == MAP_FAILED)
+        return false;
+    _base = (const char*)base;
+    _size = st.st_size;
+    const SnapshotHeader& h = header();
+    if(h.magic != SnapshotWriter::magic || h.version != SnapshotWriter::version || h.size != _size)
+    {
+        fprintf(stderr, "snapshot: %s is damaged or of another version\n", path.c_str());
+        munmap((void*)_base, _size);
+        _base = 0;
+        _size = 0;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <stdint.h>
+#include <string>
+#include "handover.h"
+
+//снимок партий одного рабочего потока для теплого перезапуска после падения процесса.
+//Формат партий тот же, что при передаче новому процессу (Match::save). Снимок пишется частями
+//между проходами цикла во временный файл, отображенный в память; готовый атомарно заменяет прошлый (rename).
+//fsync нет, как и у журнала: снимок переживает падение процесса, но не машины
+struct SnapshotHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t worker;
+    uint32_t workers; //билеты возврата привязаны к номеру потока: снимок годится только при том же числе потоков
+    uint32_t matches;
+    uint32_t journalSegment; //с этого места журнал содержит все ходы после начала снимка, 0 - журнала нет
+    uint64_t journalOffset;
+    uint64_t size; //байт вместе с заголовком
+    uint64_t time; //конец снимка, мс CLOCK_REALTIME
+    char registry[64]; //номер и зерно следующей партии (MatchRegistry::save)
+};
+
+class SnapshotWriter
+{
+public:
+    static const uint32_t magic = 0x31534253; //"SBS1"
+    static const uint32_t version = 1;
+
+    SnapshotWriter();
+    ~SnapshotWriter(); //недописанный снимок удаляется, прошлый остается
+    bool begin(const std::string& path); //новый снимок во временном файле рядом с path
+    void append(const StateWriter& part); //очередные партии
+    bool commit(SnapshotHeader& header); //дописать заголовок (magic, version, size) и заменить им path
+    void abort();
+    bool isOpen() const { return _base != 0; }
+    uint64_t size() const { return _used; }
+
+private:
+    std::string _path;
+    std::string _temp;
+    int _fd;
+    char* _base;
+    uint64_t _capacity; //размер файла и отображения
+    uint64_t _used;
+    bool reserve(uint64_t n); //место под n байт, при нехватке файл растет вдвое
+    SnapshotWriter(const SnapshotWriter&);
+    SnapshotWriter& operator=(const SnapshotWriter&);
+};
+
+//готовый снимок: отображается в память и читается без копирования
+class SnapshotFile
+{
+public:
+    SnapshotFile();
+    ~SnapshotFile();
+    bool open(const std::string& path); //false - снимка нет или он поврежден
+    const SnapshotHeader& header() const { return *(const SnapshotHeader*)_base; }
+    StateReader registry() const { return StateReader(header().registry, sizeof(header().registry), 0, 0); }
+    StateReader matches() const { return StateReader(_base + sizeof(SnapshotHeader), _size - sizeof(SnapshotHeader), 0, 0); }
+    uint64_t size() const { return _size; }
+
+private:
+    const char* _base;
+    uint64_t _size;
+    SnapshotFile(const SnapshotFile&);
+    SnapshotFile& operator=(const SnapshotFile&);
+};
+
+#endif // SNAPSHOT_H
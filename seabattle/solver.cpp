@@ -0,0 +1,343 @@
+#include "solver.h"
+#include <chrono>
+#include <string.h>
+
+const double Solver::exactLimit = 1e6;
+
+namespace {
+
+struct Placement
+{
+    Bits ship;
+    Bits halo; //корабль вместе с соседними клетками
+};
+
+//все положения кораблей каждой длины и те из них, что накрывают заданную клетку
+struct Tables
+{
+    std::vector<Placement> byLength[5];
+    std::vector<Placement> covering[5][100];
+    Tables()
+    {
+        for(int length=1; length<=4; length++)
+        {
+            for(int vertical=0; vertical<2; vertical++)
+            {
+                if(length == 1 && vertical)
+                    break; //однопалубный в обе стороны одинаков
+                for(int y=0; y<10; y++)
+                {
+                    for(int x=0; x<10; x++)
+                    {
+                        if((vertical ? y : x) + length > 10)
+                            continue;
+                        Placement p;
+                        p.ship = bits::ship(x, y, length, vertical);
+                        p.halo = bits::around(p.ship);
+                        byLength[length].push_back(p);
+                        for(Bits b = p.ship; b; b &= b - 1)
+                            covering[length][bits::lowest(b)].push_back(p);
+                    }
+                }
+            }
+        }
+    }
+};
+
+const Tables& tables()
+{
+    static Tables t;
+    return t;
+}
+
+//неизменная часть задачи: что известно о поле
+struct Position
+{
+    Bits free; //здесь корабль стоять может: не промах и не рядом с потопленным
+    Bits hits; //попадания, каждое должен накрыть какой-то из оставшихся кораблей
+    int remaining[5];
+};
+
+//положение не задевает промахи, уже поставленные корабли и чужие попадания
+inline bool legal(const Placement& p, const Position& pos, Bits blocked)
+{
+    return !(p.ship & ~pos.free) && !(p.ship & blocked) && !(p.halo & ~p.ship & pos.hits);
+}
+
+inline void count(Bits ships, double weight, double* tally)
+{
+    for(; ships; ships &= ships - 1)
+        tally[bits::lowest(ships)] += weight;
+}
+
+//частичная расстановка при переборе
+struct State
+{
+    int remaining[5];
+    Bits blocked; //поставленные корабли с соседними клетками
+    Bits ships;
+    int lastLength; //для кораблей одной длины положения перебираются по возрастанию,
+    int lastIndex;  //чтобы одна расстановка не встретилась несколько раз
+};
+
+//дочерние состояния: сначала накрываем младшее еще не накрытое попадание кораблем любой длины,
+//потом ставим оставшиеся корабли от длинных к коротким
+template<class F> void children(const Position& pos, const State& s, F visit)
+{
+    const Tables& t = tables();
+    Bits open = pos.hits & ~s.ships;
+    if(open)
+    {
+        int h = bits::lowest(open);
+        for(int length=1; length<=4; length++)
+        {
+            if(!s.remaining[length])
+                continue;
+            const std::vector<Placement>& list = t.covering[length][h];
+            for(size_t i=0; i<list.size(); i++)
+            {
+                if(!legal(list[i], pos, s.blocked))
+                    continue;
+                State next = s;
+                next.remaining[length]--;
+                next.blocked |= list[i].halo;
+                next.ships |= list[i].ship;
+                visit(next);
+            }
+        }
+        return;
+    }
+    int length = 4;
+    while(length > 0 && !s.remaining[length])
+        length--;
+    if(!length)
+        return;
+    const std::vector<Placement>& list = t.byLength[length];
+    int start = (s.lastLength == length) ? s.lastIndex + 1 : 0;
+    for(int i=start; i<(int)list.size(); i++)
+    {
+        if(!legal(list[i], pos, s.blocked))
+            continue;
+        State next = s;
+        next.remaining[length]--;
+        next.blocked |= list[i].halo;
+        next.ships |= list[i].ship;
+        next.lastLength = length;
+        next.lastIndex = i;
+        visit(next);
+    }
+}
+
+inline bool complete(const Position& pos, const State& s)
+{
+    for(int length=1; length<=4; length++)
+        if(s.remaining[length])
+            return false;
+    return !(pos.hits & ~s.ships);
+}
+
+//точный подсчет: каждая допустимая расстановка с весом 1
+void enumerate(const Position& pos, const State& s, double* tally, double& total, uint64_t& samples)
+{
+    if(complete(pos, s))
+    {
+        count(s.ships, 1, tally);
+        total += 1;
+        samples++;
+        return;
+    }
+    children(pos, s, [&](const State& next) { enumerate(pos, next, tally, total, samples); });
+}
+
+//одна случайная расстановка тем же порядком ходов, что и перебор.
+//Вероятность получить расстановку - произведение 1/n по шагам, поэтому вес n1*n2*... делает выборку
+//несмещенной оценкой равномерного распределения по всем допустимым расстановкам
+double sample(const Position& pos, Rng& rng, Bits& ships)
+{
+    const Tables& t = tables();
+    static const int factorial[5] = { 1, 1, 2, 6, 24 };
+    State s;
+    memcpy(s.remaining, pos.remaining, sizeof(s.remaining));
+    s.blocked = s.ships = 0;
+    double weight = 1;
+    const Placement* options[200];
+    int lengths[200];
+    Bits open;
+    while((open = pos.hits & ~s.ships) != 0)
+    {
+        int h = bits::lowest(open);
+        int n = 0;
+        for(int length=1; length<=4; length++)
+        {
+            if(!s.remaining[length])
+                continue;
+            const std::vector<Placement>& list = t.covering[length][h];
+            for(size_t i=0; i<list.size(); i++)
+            {
+                if(legal(list[i], pos, s.blocked))
+                {
+                    options[n] = &list[i];
+                    lengths[n++] = length;
+                }
+            }
+        }
+        if(!n)
+            return 0; //попадание накрыть нечем - тупик
+        int r = rng.below(n);
+        weight *= n;
+        s.remaining[lengths[r]]--;
+        s.blocked |= options[r]->halo;
+        s.ships |= options[r]->ship;
+    }
+    for(int length=4; length>=1; length--)
+    {
+        //корабли одной длины ставятся в любом порядке: одна расстановка получается c! путями
+        weight /= factorial[s.remaining[length]];
+        const std::vector<Placement>& list = t.byLength[length];
+        for(; s.remaining[length]; s.remaining[length]--)
+        {
+            int n = 0;
+            for(size_t i=0; i<list.size(); i++)
+            {
+                if(legal(list[i], pos, s.blocked))
+                    options[n++] = &list[i];
+            }
+            if(!n)
+                return 0;
+            const Placement* p = options[rng.below(n)];
+            weight *= n;
+            s.blocked |= p->halo;
+            s.ships |= p->ship;
+        }
+    }
+    ships = s.ships;
+    return weight;
+}
+
+//сверху оценивает число расстановок: положения каждой длины без учета взаимных помех
+double estimate(const Position& pos)
+{
+    const Tables& t = tables();
+    double bound = 1;
+    for(int length=1; length<=4; length++)
+    {
+        int n = 0;
+        for(size_t i=0; i<t.byLength[length].size(); i++)
+            n += legal(t.byLength[length][i], pos, 0);
+        for(int j=0; j<pos.remaining[length]; j++)
+            bound *= (double)(n - j) / (j + 1); //C(n, c)
+    }
+    return bound;
+}
+
+}
+
+void Solver::Tally::clear()
+{
+    memset(weight, 0, sizeof(weight));
+    total = 0;
+    samples = 0;
+}
+
+Solver::Solver(WorkPool* pool, uint64_t seed)
+{
+    _pool = pool;
+    //у каждого потока свой генератор: выборка идет без общих данных и блокировок.
+    //Потоки - непересекающиеся отрезки одной последовательности, прыжком на 2^128
+    Rng rng(seed);
+    for(int i=0; i<pool->size(); i++)
+    {
+        _rng.push_back(rng);
+        rng.jump();
+    }
+    _tally.resize(pool->size());
+}
+
+SolverResult Solver::solve(const Knowledge& k, int budgetUs)
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point started = Clock::now();
+    Clock::time_point deadline = started + std::chrono::microseconds(budgetUs);
+    Position pos;
+    pos.free = bits::all & ~k.misses & ~k.sunk;
+    pos.hits = k.hits;
+    memcpy(pos.remaining, k.remaining, sizeof(pos.remaining));
+    for(size_t i=0; i<_tally.size(); i++)
+        _tally[i].clear();
+
+    SolverResult result;
+    result.exact = estimate(pos) <= exactLimit;
+    if(result.exact)
+    {
+        //точный перебор: поддеревья первого хода - отдельные задачи, крупные крадут свободные потоки
+        State root;
+        memcpy(root.remaining, pos.remaining, sizeof(root.remaining));
+        root.blocked = root.ships = 0;
+        root.lastLength = root.lastIndex = 0;
+        if(complete(pos, root))
+        {
+            enumerate(pos, root, _tally[0].weight, _tally[0].total, _tally[0].samples);
+        }
+        children(pos, root, [&](const State& next) {
+            _pool->submit([this, &pos, next](int worker) {
+                Tally& t = _tally[worker];
+                enumerate(pos, next, t.weight, t.total, t.samples);
+            });
+        });
+    } else {
+        for(int w=0; w<_pool->size(); w++)
+        {
+            _pool->submit([this, &pos, deadline](int worker) {
+                Tally& t = _tally[worker];
+                Rng& rng = _rng[worker];
+                do
+                {
+                    for(int i=0; i<64; i++) //часы смотрим раз на пачку
+                    {
+                        Bits ships = 0;
+                        double weight = sample(pos, rng, ships);
+                        t.samples++;
+                        if(weight > 0)
+                        {
+                            count(ships, weight, t.weight);
+                            t.total += weight;
+                        }
+                    }
+                } while(Clock::now() < deadline);
+            }, w);
+        }
+    }
+    _pool->wait();
+
+    Tally sum;
+    sum.clear();
+    for(size_t i=0; i<_tally.size(); i++)
+    {
+        for(int c=0; c<100; c++)
+            sum.weight[c] += _tally[i].weight[c];
+        sum.total += _tally[i].total;
+        sum.samples += _tally[i].samples;
+    }
+    result.samples = sum.samples;
+    result.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    Bits candidates = bits::all & ~k.shot();
+    result.cell = -1;
+    double best = -1;
+    for(int c=0; c<100; c++)
+    {
+        result.probability[c] = sum.total > 0 ? sum.weight[c] / sum.total : 0;
+        if(bits::test(candidates, c) && result.probability[c] > best)
+        {
+            best = result.probability[c];
+            result.cell = c;
+        }
+    }
+    if(sum.total <= 0 && candidates)
+    {
+        //ни одной согласованной расстановки не нашлось - стреляем по карте плотности
+        Density d;
+        AiPlayer::density(k, d);
+        result.cell = bits::lowest(d.maxCells(candidates));
+    }
+    return result;
+}
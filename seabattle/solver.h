@@ -0,0 +1,45 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+#include <stdint.h>
+#include "rng.h"
+#include <vector>
+#include "aiplayer.h"
+#include "workpool.h"
+
+//итог анализа позиции
+struct SolverResult
+{
+    int cell; //лучший выстрел, -1 - стрелять некуда
+    double probability[100]; //доля расстановок, в которых в клетке стоит корабль
+    uint64_t samples; //просмотренные расстановки (для точного подсчета - все допустимые)
+    bool exact; //расстановки пересчитаны полностью, а не выборкой
+    double seconds;
+    double samplesPerSecond() const { return seconds > 0 ? samples / seconds : 0; }
+};
+
+//решатель: перебирает расстановки флота, согласные со всеми известными выстрелами,
+//и выбирает клетку, где корабль стоит чаще всего.
+//Если расстановок немного - считает их точно, иначе делает выборку Монте-Карло до конца бюджета времени.
+//Работа делится на задачи пула, у каждого потока свой генератор и свои счетчики.
+class Solver
+{
+public:
+    explicit Solver(WorkPool* pool, uint64_t seed = 1);
+    SolverResult solve(const Knowledge& k, int budgetUs);
+    static const double exactLimit; //верхняя оценка числа расстановок, до которой считаем точно
+
+private:
+    struct Tally //счетчики одного потока
+    {
+        double weight[100]; //суммарный вес расстановок с кораблем в клетке
+        double total;
+        uint64_t samples;
+        char pad[64]; //соседние потоки не делят строку кэша
+        void clear();
+    };
+    WorkPool* _pool;
+    std::vector<Rng> _rng;
+    std::vector<Tally> _tally;
+};
+
+#endif // SOLVER_H
@@ -0,0 +1,72 @@
+#include "strategy.h"
+#include "solver.h"
+
+namespace {
+
+int randomCell(Bits candidates, Rng& rng)
+{
+    if(!candidates)
+        return -1;
+    int n = rng.below(bits::count(candidates));
+    for(int i=0; i<n; i++)
+        candidates &= candidates - 1;
+    return bits::lowest(candidates);
+}
+
+class RandomStrategy: public Strategy
+{
+public:
+    explicit RandomStrategy(uint64_t seed): _rng(seed) {}
+    int chooseShot(const Knowledge& k) { return randomCell(bits::all & ~k.shot(), _rng); }
+private:
+    Rng _rng;
+};
+
+class HuntStrategy: public Strategy
+{
+public:
+    explicit HuntStrategy(uint64_t seed): _rng(seed) {}
+    int chooseShot(const Knowledge& k)
+    {
+        Bits candidates = bits::all & ~k.shot();
+        Bits target = bits::neighbours(k.hits) & candidates; //добиваем раненый корабль
+        return randomCell(target ? target : candidates, _rng);
+    }
+private:
+    Rng _rng;
+};
+
+class DensityStrategy: public Strategy
+{
+public:
+    explicit DensityStrategy(uint64_t seed): _ai(seed) {}
+    int chooseShot(const Knowledge& k) { return _ai.chooseShot(k); }
+private:
+    AiPlayer _ai;
+};
+
+class SolverStrategy: public Strategy
+{
+public:
+    SolverStrategy(uint64_t seed, int budgetUs): _pool(1), _solver(&_pool, seed), _budget(budgetUs) {}
+    int chooseShot(const Knowledge& k) { return _solver.solve(k, _budget).cell; }
+private:
+    WorkPool _pool; //симулятор сам занимает все ядра, решателю - один поток
+    Solver _solver;
+    int _budget;
+};
+
+}
+
+Strategy* makeStrategy(const std::string& name, uint64_t seed, int budgetUs)
+{
+    if(name == "random")
+        return new RandomStrategy(seed);
+    if(name == "hunt")
+        return new HuntStrategy(seed);
+    if(name == "density")
+        return new DensityStrategy(seed);
+    if(name == "solver")
+        return new SolverStrategy(seed, budgetUs);
+    return 0;
+}
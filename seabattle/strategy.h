@@ -0,0 +1,18 @@
+#ifndef STRATEGY_H
+#define STRATEGY_H
+#include <string>
+#include "aiplayer.h"
+
+//стрелок для симулятора: по тому, что известно о поле соперника, выбирает клетку
+class Strategy
+{
+public:
+    virtual ~Strategy() {}
+    virtual int chooseShot(const Knowledge& k) = 0; //-1 - стрелять некуда
+};
+
+//random - случайная клетка; hunt - случайная, пока нет попаданий, затем соседи раненого корабля;
+//density - AiPlayer; solver - Solver в одном потоке с бюджетом budgetUs на ход
+Strategy* makeStrategy(const std::string& name, uint64_t seed, int budgetUs = 1000); //0 - неизвестное имя
+
+#endif // STRATEGY_H
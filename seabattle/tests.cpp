@@ -0,0 +1,500 @@
+//самопроверка кода сервера, которому не нужны сеть и Qt: проверка расстановки и разбор кадров.
+//Возвращает 0, если все проверки прошли; make check запускает ее после сборки
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "fleet.h"
+#include "rng.h"
+#include "protocol.h"
+#include "ringbuffer.h"
+
+static int checks = 0;
+static int failures = 0;
+
+//как assert, но прогон идет дальше: за один запуск видны все провалы
+#define CHECK(cond) check((cond), #cond, __LINE__)
+static void check(bool ok, const char* what, int line)
+{
+    checks++;
+    if(!ok)
+    {
+        failures++;
+        fprintf(stderr, "tests.cpp:%d: FAILED %s\n", line, what);
+    }
+}
+
+//поле картинкой: 10 строк по 10 символов, X - палуба, . - пусто
+static void parseField(const char* picture, char field[100])
+{
+    for(int i=0; i<100; i++)
+        field[i] = picture[i] == 'X';
+}
+
+static void transpose(char field[100])
+{
+    for(int y=0; y<10; y++)
+        for(int x=y+1; x<10; x++)
+        {
+            char t = field[x+y*10];
+            field[x+y*10] = field[y+x*10];
+            field[y+x*10] = t;
+        }
+}
+
+static void rotate(char field[100]) //на 180 градусов: корабли уходят в правый нижний угол
+{
+    for(int i=0; i<50; i++)
+    {
+        char t = field[i];
+        field[i] = field[99-i];
+        field[99-i] = t;
+    }
+}
+
+//правильная расстановка вплотную к краям: 1x4, 2x3, 3x2, 4x1
+static const char* validField =
+        "XXXX.XXX.."
+        ".........."
+        "XXX.XX.XX."
+        ".........."
+        "XX.X.X.X.X"
+        ".........."
+        ".........."
+        ".........."
+        ".........."
+        "..........";
+
+//проверка расстановки так, как ее поставили в задаче: компоненты связности по сторонам и углам,
+//каждая - прямая линия не длиннее 4 клеток, и их длины дают состав флота.
+//Битовые маски validateFleet должны принимать ровно те же поля
+static bool referenceValid(const char field[100])
+{
+    int label[100];
+    int counts[5] = { 0, 0, 0, 0, 0 };
+    for(int i=0; i<100; i++)
+    {
+        if(field[i] != 0 && field[i] != 1)
+            return false;
+        label[i] = 0;
+    }
+    int components = 0;
+    for(int start=0; start<100; start++)
+    {
+        if(!field[start] || label[start])
+            continue;
+        components++;
+        int stack[100];
+        int top = 0;
+        int size = 0;
+        int minX = 9, maxX = 0, minY = 9, maxY = 0;
+        stack[top++] = start;
+        label[start] = components;
+        while(top)
+        {
+            int c = stack[--top];
+            int x = c % 10, y = c / 10;
+            size++;
+            minX = x < minX ? x : minX;
+            maxX = x > maxX ? x : maxX;
+            minY = y < minY ? y : minY;
+            maxY = y > maxY ? y : maxY;
+            for(int dy=-1; dy<=1; dy++)
+                for(int dx=-1; dx<=1; dx++)
+                {
+                    int nx = x + dx, ny = y + dy;
+                    if(nx < 0 || nx > 9 || ny < 0 || ny > 9)
+                        continue;
+                    int n = nx + ny*10;
+                    if(field[n] && !label[n])
+                    {
+                        label[n] = components;
+                        stack[top++] = n;
+                    }
+                }
+        }
+        //компонента по углам в одну строку или столбец - сплошной отрезок
+        if(minX != maxX && minY != maxY)
+            return false;
+        if(size > 4)
+            return false;
+        counts[size]++;
+    }
+    return counts[4] == 1 && counts[3] == 2 && counts[2] == 3 && counts[1] == 4;
+}
+
+static void testValidFleets()
+{
+    char field[100];
+    parseField(validField, field);
+    CHECK(validateField(field) == fleetOk);
+    transpose(field); //те же корабли вертикально
+    CHECK(validateField(field) == fleetOk);
+    rotate(field);
+    CHECK(validateField(field) == fleetOk);
+    Rng rng(20170517);
+    int accepted = 0;
+    for(int i=0; i<10000; i++)
+    {
+        Bits ships = randomFleet(rng);
+        fleetToField(ships, field);
+        accepted += validateFleet(ships) == fleetOk && validateField(field) == fleetOk;
+    }
+    CHECK(accepted == 10000);
+}
+
+static void testComposition()
+{
+    char field[100];
+    memset(field, 0, sizeof(field));
+    CHECK(validateField(field) == fleetBadComposition); //пустое поле
+    parseField(validField, field);
+    field[49] = 0; //без одного однопалубного
+    CHECK(validateField(field) == fleetBadComposition);
+    //20 палуб, но пять двухпалубных и ни одного однопалубного
+    parseField("XXXX.XXX.."
+               ".........."
+               "XXX.XX.XX."
+               ".........."
+               "XX.XX...XX"
+               ".........."
+               ".........."
+               ".........."
+               ".........."
+               "..........", field);
+    CHECK(validateField(field) == fleetBadComposition);
+    //второй четырехпалубный вместо четырех однопалубных
+    parseField("XXXX.XXX.."
+               ".........."
+               "XXX.XX.XX."
+               ".........."
+               "XX.XXXX..."
+               ".........."
+               ".........."
+               ".........."
+               ".........."
+               "..........", field);
+    CHECK(validateField(field) == fleetBadComposition);
+}
+
+static void testTouching()
+{
+    char field[100];
+    //однопалубный касается углом двухпалубного
+    parseField("XXXX.XXX.."
+               ".........."
+               "XXX.XX.XX."
+               ".........X"
+               "XX.X.X.X.."
+               ".........."
+               ".........."
+               ".........."
+               ".........."
+               "..........", field);
+    CHECK(validateField(field) == fleetTouching);
+    //два однопалубных касаются углами друг друга
+    parseField("XXXX.XXX.."
+               ".........."
+               "XXX.XX.XX."
+               ".........."
+               "XX.X.X...."
+               "......X..."
+               ".......X.."
+               ".........."
+               ".........."
+               "..........", field);
+    CHECK(validateField(field) == fleetTouching);
+    //касание сторонами склеивает корабли в одну фигуру: буква Т не прямая
+    parseField("XXXX.XXX.."
+               "..X......."
+               "XXX.XX.XX."
+               ".........."
+               "XX.X.X.X.."
+               ".........."
+               ".........."
+               ".........."
+               ".........."
+               "..........", field);
+    CHECK(validateField(field) == fleetBadShape);
+    CHECK(!referenceValid(field));
+    //однопалубный между четырехпалубным и трехпалубным: отрезок из 8 клеток
+    parseField("XXXXXXXX.."
+               ".........."
+               "XXX.XX.XX."
+               ".........."
+               "XX.X.X.X.."
+               ".........."
+               ".........."
+               ".........."
+               ".........."
+               "..........", field);
+    CHECK(validateField(field) == fleetBadShape);
+}
+
+static void testShape()
+{
+    char field[100];
+    //трехпалубный уголком
+    parseField("XXXX......"
+               ".........."
+               "XXX.XX.XX."
+               ".........."
+               "XX.X.X.X.X"
+               ".........."
+               ".........."
+               "XX........"
+               ".X........"
+               "..........", field);
+    CHECK(validateField(field) == fleetBadShape);
+    //пятипалубный вместо четырехпалубного и однопалубного
+    parseField("XXXXX.XXX."
+               ".........."
+               "XXX.XX.XX."
+               ".........."
+               "XX.X.X.X.."
+               ".........."
+               ".........."
+               ".........."
+               ".........."
+               "..........", field);
+    CHECK(validateField(field) == fleetBadShape);
+    //квадрат 2x2
+    parseField("XXXX......"
+               ".........."
+               "XXX.XX.XX."
+               ".........."
+               "XX.X.X.X.."
+               ".........."
+               "XX........"
+               "XX........"
+               ".........."
+               "..........", field);
+    CHECK(validateField(field) == fleetBadShape);
+}
+
+static void testBadCells()
+{
+    char field[100];
+    const char bad[] = { 2, -1, '1', (char)0x81 };
+    for(unsigned i=0; i<sizeof(bad); i++)
+    {
+        parseField(validField, field);
+        field[99] = bad[i]; //в пустой клетке
+        CHECK(validateField(field) == fleetBadCell);
+        parseField(validField, field);
+        field[0] = bad[i]; //вместо палубы
+        CHECK(validateField(field) == fleetBadCell);
+    }
+}
+
+//битовые маски против обхода компонент на испорченных правильных расстановках
+static void testAgainstReference()
+{
+    Rng rng(7);
+    char field[100];
+    int mismatches = 0, rejected = 0;
+    const int rounds = 200000;
+    for(int i=0; i<rounds; i++)
+    {
+        fleetToField(randomFleet(rng), field);
+        //переносим 1-3 палубы в случайные пустые клетки: палуб по-прежнему 20
+        int moves = 1 + rng.below(3);
+        for(int m=0; m<moves; m++)
+        {
+            int from, to;
+            do from = rng.below(100); while(!field[from]);
+            do to = rng.below(100); while(field[to]);
+            field[from] = 0;
+            field[to] = 1;
+        }
+        bool expected = referenceValid(field);
+        rejected += !expected;
+        if((validateField(field) == fleetOk) != expected)
+        {
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(rejected > rounds / 2); //порча в основном дает неправильные поля, проверены обе ветви
+    CHECK(rejected < rounds);
+}
+
+//кадры приходят в буфер через fill из канала, как из сокета: тот же readv в один или два куска
+struct Pipe
+{
+    int fd[2];
+    Pipe() { if(pipe(fd)) fd[0] = fd[1] = -1; }
+    ~Pipe() { close(fd[0]); close(fd[1]); }
+    void write(const char* data, int n) { CHECK(::write(fd[1], data, n) == n); }
+};
+
+static void fillPayload(char* payload, int length, int seed)
+{
+    for(int i=0; i<length; i++)
+        payload[i] = (char)(i * 7 + seed);
+}
+
+//кадр разобран целиком: команда, длина и данные совпадают с отправленными
+static bool sameFrame(const Frame& frame, int command, const char* payload, int length)
+{
+    return frame.command == command && frame.length == length && memcmp(frame.payload, payload, length) == 0;
+}
+
+static void testPartialFrames()
+{
+    Pipe pipe;
+    RingBuffer in;
+    char scratch[maxFramePayload];
+    char payload[300];
+    fillPayload(payload, sizeof(payload), 1);
+    char frame[frameHeaderSize + 300];
+    int size = encodeFrame(frame, comArrange, payload, sizeof(payload));
+    Frame decoded;
+    //заголовок, разорванный между чтениями
+    pipe.write(frame, 2);
+    CHECK(in.fill(pipe.fd[0]) == 2);
+    CHECK(decodeFrame(in, decoded, scratch) == 0);
+    //заголовок целиком, данные частично
+    pipe.write(frame + 2, 102);
+    CHECK(in.fill(pipe.fd[0]) == 102);
+    CHECK(decodeFrame(in, decoded, scratch) == 0);
+    CHECK(in.size() == 104); //неполный кадр остается в буфере
+    pipe.write(frame + 104, size - 104);
+    CHECK(in.fill(pipe.fd[0]) == size - 104);
+    CHECK(decodeFrame(in, decoded, scratch) == 1);
+    CHECK(sameFrame(decoded, comArrange, payload, sizeof(payload)));
+    CHECK(in.size() == 0);
+    //по байту
+    for(int i=0; i<size; i++)
+    {
+        pipe.write(frame + i, 1);
+        in.fill(pipe.fd[0]);
+        int r = decodeFrame(in, decoded, scratch);
+        CHECK(r == (i == size - 1 ? 1 : 0));
+    }
+    CHECK(sameFrame(decoded, comArrange, payload, sizeof(payload)));
+}
+
+static void testPipelinedFrames()
+{
+    Pipe pipe;
+    RingBuffer in;
+    char scratch[maxFramePayload];
+    const int lengths[] = { 0, 1, 100, maxFramePayload, 3 };
+    const int count = sizeof(lengths) / sizeof(lengths[0]);
+    char payloads[count][maxFramePayload];
+    char wire[count * (frameHeaderSize + maxFramePayload)];
+    int size = 0;
+    for(int i=0; i<count; i++)
+    {
+        fillPayload(payloads[i], lengths[i], i);
+        size += encodeFrame(wire + size, comDot + i, payloads[i], lengths[i]);
+    }
+    pipe.write(wire, size);
+    CHECK(in.fill(pipe.fd[0]) == size); //все кадры одним чтением
+    Frame decoded;
+    for(int i=0; i<count; i++)
+    {
+        CHECK(decodeFrame(in, decoded, scratch) == 1);
+        CHECK(sameFrame(decoded, comDot + i, payloads[i], lengths[i]));
+    }
+    CHECK(decodeFrame(in, decoded, scratch) == 0);
+    CHECK(in.size() == 0);
+}
+
+static void testWrapAround()
+{
+    //маленький буфер: кадр начинается с каждого смещения, так что конец массива
+    //разрывает и заголовок, и данные, и свободное место для readv
+    const int capacity = 64;
+    char scratch[maxFramePayload];
+    char payload[40];
+    fillPayload(payload, sizeof(payload), 5);
+    char frame[frameHeaderSize + 40];
+    int size = encodeFrame(frame, comKill, payload, sizeof(payload));
+    char filler[capacity];
+    memset(filler, 0, sizeof(filler));
+    int good = 0;
+    for(int offset=0; offset<capacity; offset++)
+    {
+        Pipe pipe;
+        RingBuffer in(capacity);
+        in.append(filler, offset);
+        in.consume(offset); //буфер пуст, но начало сдвинуто на offset
+        pipe.write(frame, size);
+        bool filled = in.fill(pipe.fd[0]) == size;
+        Frame decoded;
+        if(filled && decodeFrame(in, decoded, scratch) == 1 && sameFrame(decoded, comKill, payload, sizeof(payload)) && in.size() == 0)
+        {
+            good++;
+        }
+    }
+    CHECK(good == capacity);
+    //два кадра подряд через конец массива
+    RingBuffer in(capacity);
+    in.append(filler, 50);
+    in.consume(50);
+    char two[2 * (frameHeaderSize + 10)];
+    int twoSize = encodeFrame(two, comVoid, payload, 10);
+    twoSize += encodeFrame(two + twoSize, comDamage, payload + 10, 10);
+    CHECK(in.append(two, twoSize) == twoSize);
+    Frame decoded;
+    CHECK(decodeFrame(in, decoded, scratch) == 1 && sameFrame(decoded, comVoid, payload, 10));
+    CHECK(decodeFrame(in, decoded, scratch) == 1 && sameFrame(decoded, comDamage, payload + 10, 10));
+}
+
+static void testBadHeaders()
+{
+    RingBuffer in;
+    char scratch[maxFramePayload];
+    Frame decoded;
+    //длина больше maxFramePayload: ошибка сразу по заголовку, данных не ждем
+    unsigned char oversized[frameHeaderSize] = { protocolVersion, comDot, (maxFramePayload + 1) >> 8, (maxFramePayload + 1) & 0xff };
+    in.append((const char*)oversized, frameHeaderSize);
+    CHECK(decodeFrame(in, decoded, scratch) == -1);
+    in.clear();
+    unsigned char largest[frameHeaderSize] = { protocolVersion, comDot, 0xff, 0xff };
+    in.append((const char*)largest, frameHeaderSize);
+    CHECK(decodeFrame(in, decoded, scratch) == -1);
+    //ровно maxFramePayload - допустимый кадр
+    in.clear();
+    char payload[maxFramePayload];
+    fillPayload(payload, maxFramePayload, 9);
+    char frame[frameHeaderSize + maxFramePayload];
+    int size = encodeFrame(frame, comSnapshot, payload, maxFramePayload);
+    in.append(frame, frameHeaderSize);
+    CHECK(decodeFrame(in, decoded, scratch) == 0);
+    in.append(frame + frameHeaderSize, size - frameHeaderSize);
+    CHECK(decodeFrame(in, decoded, scratch) == 1 && sameFrame(decoded, comSnapshot, payload, maxFramePayload));
+    //чужая версия протокола, даже если заголовок еще без данных
+    const char versions[] = { 0, protocolVersion + 1, (char)0xff };
+    for(unsigned i=0; i<sizeof(versions); i++)
+    {
+        in.clear();
+        char bad[frameHeaderSize + 1];
+        encodeFrame(bad, comDot, "\x05", 1);
+        bad[0] = versions[i];
+        in.append(bad, sizeof(bad));
+        CHECK(decodeFrame(in, decoded, scratch) == -1);
+    }
+    //неполный заголовок еще не проверяется
+    in.clear();
+    char version = 2;
+    in.append(&version, 1);
+    CHECK(decodeFrame(in, decoded, scratch) == 0);
+}
+
+int main()
+{
+    testValidFleets();
+    testComposition();
+    testTouching();
+    testShape();
+    testBadCells();
+    testAgainstReference();
+    testPartialFrames();
+    testPipelinedFrames();
+    testWrapAround();
+    testBadHeaders();
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,243 @@
+#include "timerwheel.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdio.h>
+
+static void unlinkTimer(Timer* timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = 0;
+}
+
+static void linkTimer(Timer* head, Timer* timer) //в конец кольцевого списка head
+{
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+void Timer::cancel()
+{
+    if(wheel)
+        wheel->remove(this);
+}
+
+TimerWheel::TimerWheel(int tickMs)
+{
+    _tickMs = tickMs;
+    _tick = clockMs() / _tickMs;
+    _count = 0;
+    _fd = -1;
+    _wakeTick = 0;
+    for(int l=0; l<levels; l++)
+        for(int s=0; s<slotCount; s++)
+            _slots[l][s].next = _slots[l][s].prev = &_slots[l][s];
+}
+
+TimerWheel::~TimerWheel()
+{
+    //взведенные таймеры владельцев просто забываем: их деструкторы не должны трогать колесо
+    for(int l=0; l<levels; l++)
+    {
+        for(int s=0; s<slotCount; s++)
+        {
+            Timer* head = &_slots[l][s];
+            while(head->next != head)
+            {
+                Timer* t = head->next;
+                unlinkTimer(t);
+                t->wheel = 0;
+            }
+        }
+    }
+    if(_fd != -1)
+        close(_fd);
+}
+
+uint64_t TimerWheel::clockMs()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+uint64_t TimerWheel::currentTick() const
+{
+    uint64_t tick = clockMs() / _tickMs;
+    return tick > _tick ? tick : _tick; //колесо крутят и вызовы advance с временем впереди часов
+}
+
+int TimerWheel::remaining(const Timer* timer) const
+{
+    if(timer->wheel != this)
+        return -1;
+    uint64_t tick = currentTick();
+    return timer->expires > tick ? (int)((timer->expires - tick) * _tickMs) : 0;
+}
+
+bool TimerWheel::open(Reactor* reactor)
+{
+    _fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(_fd == -1)
+    {
+        perror("timerfd_create");
+        return false;
+    }
+    if(!reactor->add(_fd, this, EPOLLIN | EPOLLET))
+        return false;
+    reschedule();
+    return true;
+}
+
+//ближайший тик, на котором колесу есть что делать: непустая ячейка уровня 0 или раскладка
+//непустой ячейки старшего уровня. Между ними advance только перебирает пустые ячейки
+uint64_t TimerWheel::nextTick() const
+{
+    uint64_t next = 0;
+    for(int s=1; s<=slotCount; s++)
+    {
+        uint64_t tick = _tick + s;
+        const Timer* head = &_slots[0][tick & (slotCount - 1)];
+        if(head->next != head)
+        {
+            next = tick;
+            break;
+        }
+    }
+    for(int l=1; l<levels; l++)
+    {
+        int shift = slotBits * l;
+        uint64_t tick = ((_tick >> shift) + 1) << shift; //ближайшая раскладка уровня l
+        for(int s=0; s<slotCount && (next == 0 || tick < next); s++, tick += (uint64_t)1 << shift)
+        {
+            const Timer* head = &_slots[l][(tick >> shift) & (slotCount - 1)];
+            if(head->next != head)
+            {
+                next = tick;
+                break;
+            }
+        }
+    }
+    return next;
+}
+
+void TimerWheel::wakeAt(uint64_t tick)
+{
+    //однократно и по абсолютному времени: отставание обработки не сдвигает срок
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 0;
+    uint64_t ms = tick * _tickMs;
+    spec.it_value.tv_sec = ms / 1000;
+    spec.it_value.tv_nsec = (ms % 1000) * 1000000L; //0 вместе с tv_sec == 0 снимает timerfd
+    timerfd_settime(_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+    _wakeTick = tick;
+}
+
+void TimerWheel::reschedule()
+{
+    if(_fd == -1)
+        return;
+    uint64_t next = _count > 0 ? nextTick() : 0; //пустое колесо не будит сервер
+    if(next != _wakeTick)
+        wakeAt(next);
+}
+
+void TimerWheel::arm(Timer* timer, TimerHandler* handler, uint64_t delayMs, uint64_t tag)
+{
+    if(timer->wheel)
+        remove(timer);
+    uint64_t now = currentTick(); //срок - от часов: между пробуждениями _tick отстает
+    if(_count == 0)
+        _tick = now; //колесо стояло: догоняем часы без перебора тиков
+    uint64_t ticks = (delayMs + _tickMs - 1) / _tickMs;
+    timer->expires = now + (ticks ? ticks : 1);
+    timer->handler = handler;
+    timer->tag = tag;
+    timer->wheel = this;
+    uint64_t tick = place(timer);
+    _count++;
+    if(_fd != -1 && (_wakeTick == 0 || tick < _wakeTick))
+        wakeAt(tick); //снятие таймера timerfd не трогает: лишнее пробуждение лишь пересчитает срок
+}
+
+void TimerWheel::remove(Timer* timer)
+{
+    unlinkTimer(timer);
+    timer->wheel = 0;
+    _count--;
+}
+
+uint64_t TimerWheel::place(Timer* timer)
+{
+    uint64_t delta = timer->expires > _tick ? timer->expires - _tick : 0;
+    int level = 0;
+    while(level < levels - 1 && delta >= (uint64_t)1 << (slotBits * (level + 1)))
+        level++;
+    uint64_t at = timer->expires;
+    if(level == levels - 1 && delta >= (uint64_t)1 << (slotBits * levels))
+        at = _tick + ((uint64_t)1 << (slotBits * levels)) - 1; //дальше 497 дней при тике 10 мс - срабатывает раньше
+    int shift = slotBits * level;
+    linkTimer(&_slots[level][(at >> shift) & (slotCount - 1)], timer);
+    return at >> shift << shift;
+}
+
+void TimerWheel::cascade(int level)
+{
+    Timer* head = &_slots[level][(_tick >> (slotBits * level)) & (slotCount - 1)];
+    while(head->next != head)
+    {
+        Timer* t = head->next;
+        unlinkTimer(t);
+        place(t); //опускается на уровень ниже, до ячейки своего тика
+    }
+}
+
+void TimerWheel::advance(uint64_t nowMs)
+{
+    uint64_t target = nowMs / _tickMs;
+    while(_tick < target)
+    {
+        if(_count == 0)
+        {
+            _tick = target; //нечего срабатывать
+            break;
+        }
+        _tick++;
+        for(int l=levels-1; l>0; l--)
+        {
+            if((_tick & (((uint64_t)1 << (slotBits * l)) - 1)) == 0)
+                cascade(l); //сначала старшие: их таймеры могут попасть в ячейку младшего, которую раскладываем следом
+        }
+        Timer* head = &_slots[0][_tick & (slotCount - 1)];
+        if(head->next == head)
+            continue;
+        //забираем ячейку целиком: обработчик может отменить или взвести любые таймеры, включая соседей по ней
+        Timer due;
+        due.next = head->next;
+        due.prev = head->prev;
+        due.next->prev = &due;
+        due.prev->next = &due;
+        head->next = head->prev = head;
+        while(due.next != &due)
+        {
+            Timer* t = due.next;
+            unlinkTimer(t);
+            t->wheel = 0;
+            _count--;
+            t->handler->onTimer(t);
+        }
+    }
+}
+
+void TimerWheel::onReadable()
+{
+    uint64_t expirations;
+    while(read(_fd, &expirations, sizeof(expirations)) > 0)
+        ; //сколько тиков прошло, узнаем по часам
+    advance(clockMs());
+    reschedule();
+}
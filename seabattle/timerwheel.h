@@ -0,0 +1,79 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+#include <stdint.h>
+#include "reactor.h"
+
+struct Timer;
+
+//кому сообщить о сработавшем таймере
+class TimerHandler
+{
+public:
+    virtual ~TimerHandler() {}
+    virtual void onTimer(Timer* timer) = 0;
+};
+
+class TimerWheel;
+
+//таймер встраивается в объект-владелец: взвод и отмена не выделяют память
+struct Timer
+{
+    Timer() : next(0), prev(0), expires(0), handler(0), tag(0), wheel(0) {}
+    ~Timer() { cancel(); }
+    bool isArmed() const { return wheel != 0; }
+    void cancel();
+
+    Timer* next; //соседи по ячейке колеса
+    Timer* prev;
+    uint64_t expires; //номер тика срабатывания
+    TimerHandler* handler;
+    uint64_t tag; //данные владельца, например ссылка на партию в пуле
+    TimerWheel* wheel; //в каком колесе взведен, 0 - не взведен
+
+private:
+    Timer(const Timer&);
+    Timer& operator=(const Timer&);
+};
+
+//иерархическое колесо таймеров: 4 уровня по 256 ячеек. Уровень 0 - ближайшие 256 тиков,
+//каждый следующий в 256 раз грубее; при обороте младшего уровня ячейка старшего раскладывается вниз.
+//Взвод и отмена - O(1). Колесо крутит timerfd в реакторе сервера: он взводится однократно на ближайший
+//тик, где что-то сработает или опустится с верхнего уровня, а не будит сервер каждые 10 мс
+class TimerWheel: public IoHandler
+{
+public:
+    static const int slotBits = 8;
+    static const int slotCount = 1 << slotBits;
+    static const int levels = 4;
+
+    explicit TimerWheel(int tickMs = 10);
+    ~TimerWheel();
+    bool open(Reactor* reactor); //timerfd в реактор; без этого колесо крутят вызовы advance
+    void arm(Timer* timer, TimerHandler* handler, uint64_t delayMs, uint64_t tag = 0); //перевзводит, если уже взведен
+    void remove(Timer* timer);
+    void advance(uint64_t nowMs); //сработать все таймеры до nowMs включительно
+    uint64_t now() const { return _tick * _tickMs; } //время последнего обработанного тика, мс; отстает от часов, пока колесо спит
+    int count() const { return _count; }
+    int remaining(const Timer* timer) const; //мс до срабатывания, -1 - не взведен в этом колесе
+    void onReadable(); //тик timerfd
+
+    static uint64_t clockMs(); //CLOCK_MONOTONIC
+
+private:
+    int _tickMs;
+    uint64_t _tick; //текущий тик
+    int _count;
+    int _fd; //timerfd, -1 - нет
+    uint64_t _wakeTick; //на какой тик взведен timerfd, 0 - не взведен
+    Timer _slots[levels][slotCount]; //головы кольцевых списков
+    uint64_t place(Timer* timer); //возвращает тик, на котором таймер сработает или опустится на уровень ниже
+    void cascade(int level);
+    uint64_t currentTick() const; //тик по часам, но не раньше _tick
+    uint64_t nextTick() const;
+    void wakeAt(uint64_t tick);
+    void reschedule();
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+};
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,83 @@
+#include "trace.h"
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+thread_local Trace::Ring* Trace::_local = 0;
+std::atomic<Trace::Ring*> Trace::_rings(0);
+std::atomic<int> Trace::_threads(0);
+
+namespace {
+
+const char* spanNames[spanCount] = { "recv", "decode", "arrange", "shot", "send", "flush" };
+
+}
+
+Trace::Ring& Trace::attach()
+{
+    //кольцо выделяется при первом событии потока, то есть только если трасса когда-то включалась
+    Ring* ring = new Ring();
+    ring->thread = ++_threads;
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+    ring->next = _rings.load(std::memory_order_relaxed);
+    while(!_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed))
+        ;
+    _local = ring;
+    return *ring;
+}
+
+void Trace::clear()
+{
+    for(Ring* ring = _rings.load(std::memory_order_acquire); ring; ring = ring->next)
+        ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+std::string Trace::dumpJson()
+{
+    struct Copied
+    {
+        TraceEvent event;
+        int thread;
+    };
+    std::vector<Copied> all;
+    for(Ring* ring = _rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        //владелец пишет дальше, пока мы читаем: копируем, затем отбрасываем то, что он мог успеть затереть
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t from = head > (uint64_t)ringSize ? head - ringSize : 0;
+        from = std::max(from, ring->tail.load(std::memory_order_relaxed));
+        size_t first = all.size();
+        for(uint64_t i=from; i<head; i++)
+        {
+            Copied c;
+            c.event = ring->events[i & (ringSize - 1)];
+            c.thread = ring->thread;
+            all.push_back(c);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = ring->head.load(std::memory_order_relaxed);
+        //владелец может быть посреди записи события now: его ячейка держит событие now - ringSize
+        uint64_t safe = now >= (uint64_t)ringSize ? now - ringSize + 1 : 0;
+        if(safe > from)
+            all.erase(all.begin() + first, all.begin() + first + std::min<uint64_t>(safe - from, all.size() - first));
+    }
+    uint64_t origin = ~(uint64_t)0;
+    for(size_t i=0; i<all.size(); i++)
+        origin = std::min(origin, all[i].event.start);
+    double us = Metrics::secondsPerTick() * 1e6;
+
+    std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char line[256];
+    for(size_t i=0; i<all.size(); i++)
+    {
+        const TraceEvent& e = all[i].event;
+        int n = snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                         "\"pid\":1,\"tid\":%d,\"args\":{\"match\":%u,\"conn\":%d}}", i ? "," : "",
+                         e.span < spanCount ? spanNames[e.span] : "?", e.match ? "match" : "conn",
+                         (e.start - origin) * us, (e.end - e.start) * us, all[i].thread, e.match, e.conn);
+        out.append(line, n);
+    }
+    out += "\n]}\n";
+    return out;
+}
@@ -0,0 +1,80 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include "metrics.h"
+
+//участки, которые пишутся в трассу
+enum TraceSpan { spanRecv, //readv из сокета
+                 spanDecode, //разбор кадра
+                 spanArrange, //проверка расстановки
+                 spanShot, //разрешение выстрела и рассылка результата
+                 spanSend, //кадр в очередь отправки
+                 spanFlush, //writev очереди
+                 spanCount
+               };
+
+struct TraceEvent
+{
+    uint64_t start, end; //тики Metrics::ticks()
+    uint32_t match; //0 - вне партии
+    int32_t conn; //сокет клиента, -1 - нет
+    uint32_t span;
+    uint32_t pad;
+};
+
+//включение трассы во время работы, реализует сервер
+class TraceControl
+{
+public:
+    virtual ~TraceControl() {}
+    virtual bool traceMatch(int id, bool on) = 0; //false - нет такой партии
+    virtual bool traceConnection(int sock, bool on) = 0; //false - нет такого соединения
+    virtual void traceOff() = 0; //выключить у всех
+};
+
+//трасса отдельных партий и соединений. Выключенная трасса стоит одну проверку флага
+//трассируемости у клиента или партии: флаг лежит рядом с остальными полями и почти всегда false.
+//События пишутся в кольцо своего потока без блокировок, старые затираются
+class Trace
+{
+public:
+    static const int ringSize = 1 << 16; //событий на поток
+
+    static void record(int span, uint32_t match, int conn, uint64_t start)
+    {
+        Ring& ring = local();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        TraceEvent& e = ring.events[head & (ringSize - 1)];
+        e.start = start;
+        e.end = Metrics::ticks();
+        e.match = match;
+        e.conn = conn;
+        e.span = span;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+    static std::string dumpJson(); //формат Chrome trace / Perfetto
+    static void clear(); //забыть записанное (кольца остаются)
+
+private:
+    struct Ring
+    {
+        Ring* next;
+        int thread;
+        std::atomic<uint64_t> head; //сколько событий записано всего
+        std::atomic<uint64_t> tail; //события до tail забыты через clear
+        TraceEvent events[ringSize];
+    };
+    static thread_local Ring* _local;
+    static std::atomic<Ring*> _rings; //кольца всех потоков, писавших трассу
+    static std::atomic<int> _threads;
+    static Ring& local()
+    {
+        Ring* ring = _local;
+        return ring ? *ring : attach();
+    }
+    static Ring& attach();
+};
+
+#endif // TRACE_H
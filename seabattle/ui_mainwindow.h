@@ -36,6 +36,7 @@ public:
     QWidget *Placing;
     QGraphicsView *placingBackVIew;
     QPushButton *startButton;
+    QPushButton *aiButton;
     QWidget *Game;
     QGraphicsView *fieldBackView;
     QLineEdit *lineEdit_2;
@@ -99,6 +100,9 @@ public:
         startButton = new QPushButton(Placing);
         startButton->setObjectName(QStringLiteral("startButton"));
         startButton->setGeometry(QRect(50, 300, 181, 71));
+        aiButton = new QPushButton(Placing);
+        aiButton->setObjectName(QStringLiteral("aiButton"));
+        aiButton->setGeometry(QRect(240, 300, 101, 71));
         stackedWidget->addWidget(Placing);
         Game = new QWidget();
         Game->setObjectName(QStringLiteral("Game"));
@@ -131,6 +135,7 @@ public:
         New_game->setText(QApplication::translate("MainWindow", "NEW GAME", Q_NULLPTR));
         Connect->setText(QApplication::translate("MainWindow", "CONNECT", Q_NULLPTR));
         startButton->setText(QApplication::translate("MainWindow", "START", Q_NULLPTR));
+        aiButton->setText(QApplication::translate("MainWindow", "VS AI", Q_NULLPTR));
     } // retranslateUi
 
 };
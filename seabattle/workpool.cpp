@@ -0,0 +1,96 @@
+#include "workpool.h"
+
+WorkPool::WorkPool(int threads): _queued(0), _pending(0), _next(0), _stop(false)
+{
+    if(threads <= 0)
+        threads = std::thread::hardware_concurrency();
+    if(threads <= 0)
+        threads = 1;
+    for(int i=0; i<threads; i++)
+        _workers.push_back(new Worker);
+    for(int i=0; i<threads; i++)
+        _workers[i]->thread = std::thread(&WorkPool::run, this, i);
+}
+
+WorkPool::~WorkPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(_sleepLock);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for(size_t i=0; i<_workers.size(); i++)
+    {
+        _workers[i]->thread.join();
+        delete _workers[i];
+    }
+}
+
+void WorkPool::submit(const Task& task, int worker)
+{
+    if(worker < 0 || worker >= size())
+        worker = _next++ % size();
+    _pending++;
+    {
+        std::lock_guard<std::mutex> guard(_workers[worker]->lock);
+        _workers[worker]->tasks.push_back(task);
+    }
+    {
+        //счетчик меняется под замком сна, иначе поток может проверить его и уснуть, пропустив сигнал
+        std::lock_guard<std::mutex> guard(_sleepLock);
+        _queued++;
+    }
+    _wake.notify_one();
+}
+
+void WorkPool::wait()
+{
+    std::unique_lock<std::mutex> guard(_sleepLock);
+    _done.wait(guard, [this]() { return _pending == 0; });
+}
+
+bool WorkPool::take(int worker, Task& task)
+{
+    int n = size();
+    for(int i=0; i<n; i++)
+    {
+        Worker* w = _workers[(worker + i) % n];
+        std::lock_guard<std::mutex> guard(w->lock);
+        if(w->tasks.empty())
+            continue;
+        if(i == 0)
+        {
+            task = w->tasks.back(); //своя последняя задача - ее данные еще в кэше
+            w->tasks.pop_back();
+        } else {
+            task = w->tasks.front(); //чужая самая старая - обычно самая крупная
+            w->tasks.pop_front();
+        }
+        _queued--;
+        return true;
+    }
+    return false;
+}
+
+void WorkPool::run(int worker)
+{
+    Task task;
+    for(;;)
+    {
+        if(take(worker, task))
+        {
+            task(worker);
+            task = Task();
+            if(--_pending == 0)
+            {
+                std::lock_guard<std::mutex> guard(_sleepLock);
+                _done.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(_sleepLock);
+        _wake.wait(guard, [this]() { return _queued > 0 || _stop; });
+        if(_stop && _queued == 0)
+            return;
+    }
+}
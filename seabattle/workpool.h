@@ -0,0 +1,43 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//пул потоков с кражей работы: у каждого потока своя очередь, свои задачи берутся с конца,
+//а простаивающий поток забирает задачи из начала чужой очереди
+class WorkPool
+{
+public:
+    typedef std::function<void(int worker)> Task; //worker - номер потока, для данных потока без блокировок
+
+    explicit WorkPool(int threads = 0); //0 - по числу ядер
+    ~WorkPool();
+    int size() const { return (int)_workers.size(); }
+    void submit(const Task& task, int worker = -1); //worker < 0 - очереди по кругу; из задачи - свой номер
+    void wait(); //дождаться выполнения всех поставленных задач
+
+private:
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+    std::vector<Worker*> _workers;
+    std::atomic<int> _queued; //задачи в очередях
+    std::atomic<int> _pending; //поставленные, но еще не выполненные задачи
+    std::atomic<unsigned> _next; //очередь для задач извне пула
+    std::mutex _sleepLock;
+    std::condition_variable _wake; //появились задачи или пул останавливается
+    std::condition_variable _done; //все задачи выполнены
+    bool _stop;
+    bool take(int worker, Task& task); //своя задача или украденная
+    void run(int worker);
+};
+
+#endif // WORKPOOL_H